@@ -19,6 +19,7 @@
 #include <chrono> // C++11
 #include "spiSensors/MPU9250.h"
 #include "logger.h"
+#include "durability.h"
 
 using json = nlohmann::json;
 using namespace std;
@@ -72,7 +73,7 @@ private:
 	static const int MAG_AXIS_SIGN_FOR_ACCEL_AXIS[3];
 	static const char TIMESTAMP_FMT[];
 public:
-	void init(json options, Logger * lgr);
+	void init(json options, Logger * lgr, Durability * dur);
 	Attitude estimateAttitude();
 	
 };
@@ -12,8 +12,11 @@
 
 #include <sstream>
 #include <map>
+#include <vector>
 #include <sys/time.h>
 #include <chrono> // C++11
+#include <mutex>
+#include "frameTracer.h"
 using namespace std;
 using namespace chrono;
 
@@ -23,16 +26,30 @@ class Benchmarker {
 private:
 	string name;
 	steady_clock::duration totalDuration;
+	steady_clock::duration iterationDuration; // Accumulated so far in the current iteration
+	steady_clock::duration lastDuration; // Of the most recently concluded iteration
 	int numTimesRun;
-	int numItemsProcessed;
+	long long numItemsProcessed;
+	bool timed; // False for benchmarkers that only count events
 	steady_clock::time_point startTime;
+	// Durations of every concluded iteration, if keepSamples is set
+	vector<steady_clock::duration> samples;
+	static bool keepSamples;
+	// Guards the totals, which stage threads add to while the processing
+	// stage summarizes them.  start() and startTime belong to whichever
+	// thread is timing, one at a time.
+	mutable mutex lock;
+	void concludeLocked();
 
 public:
 	Benchmarker(string _name = "") :
 		name(_name),
 		totalDuration(seconds(0)),
+		iterationDuration(seconds(0)),
+		lastDuration(seconds(0)),
 		numTimesRun(0),
-		numItemsProcessed(0)
+		numItemsProcessed(0),
+		timed(false)
 	{;}
 	virtual ~Benchmarker() {;}
 
@@ -49,16 +66,35 @@ public:
 	// Use this when paused - it indicates the end of an iteration, without marking
 	// the end time.
 	void conclude();
+	// An event occurred.  Use this instead of start() and end() for
+	// benchmarkers that only count things, like dropped frames.
+	void count(int items_processed = 0);
+	// An iteration of processing, timed elsewhere, has concluded.
+	void add(steady_clock::duration elapsed, int items_processed = 0);
+	// Forget every iteration so far, eg. warm-up runs
+	void reset();
 	// Get the total time spent in processing, divided by the number of iterations ran.
 	steady_clock::duration getAvgTime() const;
 	// Get the total time spent in processing, divided by the number of iterations ran.
 	double getAvgMs() const;
+	// Get the time spent in the most recently concluded iteration.
+	steady_clock::duration getLastTime() const { lock_guard<mutex> lk(lock); return lastDuration; }
+	// Only before any thread uses this benchmarker
 	void setName(string name) { this->name = name; }
 	string getName() const { return name; }
 	double getAvgItemsProcessed() const { 
+		lock_guard<mutex> lk(lock);
 		return numTimesRun > 0 ? numItemsProcessed / numTimesRun : 0; 
 	}
-	int getIterations() const { return numTimesRun; }
+	long long getItemsProcessed() const { lock_guard<mutex> lk(lock); return numItemsProcessed; }
+	int getIterations() const { lock_guard<mutex> lk(lock); return numTimesRun; }
+	bool isTimed() const { lock_guard<mutex> lk(lock); return timed; }
+	
+	// Keep every iteration's duration, for percentiles.  Off by default,
+	// since it grows without bound; meant for benchmark runs.
+	static void setKeepSamples(bool keep) { keepSamples = keep; }
+	// Duration below which pct percent of iterations fell.  0 if no samples were kept.
+	double getPercentileMs(double pct) const;
 };
 
 #endif // __PCG_BENCHMARKER_H__
@@ -0,0 +1,111 @@
+/*
+	boundedQueue.h
+
+	Fixed-capacity, thread-safe FIFO used to hand work between the stages
+	of the frame pipeline.
+*/
+
+#ifndef __PCG_BOUNDEDQUEUE_H__
+#define __PCG_BOUNDEDQUEUE_H__
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+using namespace std;
+
+template <typename T>
+class BoundedQueue {
+private:
+	deque<T> items;
+	size_t capacity;
+	bool closed = false;
+	mutable mutex lock;
+	condition_variable notEmpty;
+	condition_variable notFull;
+
+public:
+	BoundedQueue(size_t _capacity = 1) :
+		capacity(_capacity > 0 ? _capacity : 1)
+	{ ; }
+
+	// Only call this before any producer or consumer has started.
+	void setCapacity(size_t _capacity) { capacity = _capacity > 0 ? _capacity : 1; }
+	size_t getCapacity() const { return capacity; }
+
+	// Blocks while the queue is full.
+	// Returns false if the queue has been closed; the item is discarded.
+	bool push(T item) {
+		unique_lock<mutex> lk(lock);
+		notFull.wait(lk, [this]{ return closed || items.size() < capacity; });
+		if(closed) { return false; }
+		items.push_back(std::move(item));
+		lk.unlock();
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// Never blocks.  Returns false, discarding the item, if the queue is
+	// full or has been closed.
+	bool tryPush(T item) {
+		{
+			lock_guard<mutex> lk(lock);
+			if(closed || items.size() >= capacity) { return false; }
+			items.push_back(std::move(item));
+		}
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// Never blocks.  If the queue is full, the oldest item is discarded to
+	// make room, and dropped is set.  With a capacity of one, this makes the
+	// queue a "latest wins" mailbox.
+	// Returns false if the queue has been closed; the item is discarded.
+	bool pushDroppingOldest(T item, bool &dropped) {
+		T discarded;
+		dropped = false;
+		{
+			lock_guard<mutex> lk(lock);
+			if(closed) { return false; }
+			if(items.size() >= capacity) {
+				// Hang onto it so it's destroyed outside the lock
+				discarded = std::move(items.front());
+				items.pop_front();
+				dropped = true;
+			}
+			items.push_back(std::move(item));
+		}
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// Blocks while the queue is empty.
+	// Returns false once the queue has been closed and fully drained.
+	bool pop(T &item) {
+		unique_lock<mutex> lk(lock);
+		notEmpty.wait(lk, [this]{ return closed || !items.empty(); });
+		if(items.empty()) { return false; }
+		item = std::move(items.front());
+		items.pop_front();
+		lk.unlock();
+		notFull.notify_one();
+		return true;
+	}
+
+	// Rejects further pushes and wakes everyone up.  Consumers still
+	// receive whatever was queued before the close.
+	void close() {
+		{
+			lock_guard<mutex> lk(lock);
+			closed = true;
+		}
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+
+	size_t size() const {
+		lock_guard<mutex> lk(lock);
+		return items.size();
+	}
+};
+
+#endif // __PCG_BOUNDEDQUEUE_H__
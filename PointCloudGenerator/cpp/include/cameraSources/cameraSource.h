@@ -0,0 +1,54 @@
+/*
+	cameraSource.h
+
+	Where stereo frames come from.  ImageAcquisition drives every source
+	the same way: trigger() starts a frame, retrieve() collects it.  It
+	assigns frame IDs and timestamps, and does the flipping and recording
+	itself, so sources only have to produce images.
+*/
+
+#ifndef __PCG_CAMERASOURCE_H__
+#define __PCG_CAMERASOURCE_H__
+
+#include <chrono> // C++11
+
+#include "json.hpp"
+#include "logger.h"
+#include "framePool.h"
+#include "imageDataSet.h"
+using json = nlohmann::json;
+using namespace std;
+
+class CameraSource {
+public:
+	virtual ~CameraSource() {;}
+
+	// options is the whole imageAcquisition section.  Live sources should
+	// put their images in pool, so they can be handed down the pipeline
+	// without a copy.  Throws on bad configuration.
+	virtual void init(json options, Logger * lgr, FramePool * pool) = 0;
+	virtual void start() = 0;
+	virtual void stop() = 0;
+
+	// Starts exposing or fetching the next frame
+	virtual void trigger(unsigned long frame_id) = 0;
+	// Fills in the images and their validity for the frame last triggered.
+	// Waits for them if need be, but not forever.
+	virtual void retrieve(ImageDataSet &data) = 0;
+
+	// Recorded sources only
+	virtual bool isPlayback() const { return false; }
+	virtual bool isComplete() const { return false; }
+	// Time between this frame and the previous one, when recorded
+	virtual chrono::system_clock::duration getFrameDelay() const { return chrono::system_clock::duration(0); }
+	// Carries on from the last frame recorded at or before t.  True for success.
+	virtual bool seek(chrono::time_point<chrono::system_clock> t) { return false; }
+
+	// True if side's images (0 for left, 1 for right) come already
+	// flipped, as recordings may be, and if so flip_code is as for cv::flip
+	virtual bool isImageFlipped(int side, int &flip_code) const { return false; }
+	// False if the images mustn't be modified in place
+	virtual bool areImagesWritable() const { return true; }
+};
+
+#endif // __PCG_CAMERASOURCE_H__
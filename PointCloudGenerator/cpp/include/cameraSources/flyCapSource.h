@@ -0,0 +1,125 @@
+/*
+	flyCapSource.h
+
+	Frames from a pair of software-triggered Point Grey cameras, through
+	the FlyCapture2 SDK.
+*/
+
+#ifndef __PCG_FLYCAPSOURCE_H__
+#define __PCG_FLYCAPSOURCE_H__
+
+#include <FlyCapture2.h>
+#include <stdio.h>
+#include <list>
+#include <utility>
+#include <chrono> // C++11
+#include <mutex>
+
+#include <opencv2/core/core.hpp>
+
+#include "cameraSource.h"
+#include "benchmarker.h"
+#include "latencyHistogram.h"
+#include "reactor.h"
+
+using namespace FlyCapture2;
+
+// The callback and the acquisition thread share these.  image, slot,
+// frameId and armedFrameId are only touched under lock.
+struct CameraCallbackItems {
+	cv::Mat image;   // Set by the callback.  Lives in slot.
+	FramePool::Slot slot; // Set by the callback.  Empty if the pool was out of slots.
+	FramePool * pool; // Used by the callback
+	int eventFd;     // Signalled by the callback once image is set
+	Logger * logger; // Used by the callback
+	char side[6];    // "left " or "right".  Used by callback.
+	const char * traceName; // Used by callback.
+	unsigned long frameId; // Set when triggering.  Used by callback.
+	unsigned long armedFrameId; // Set when triggering; taken by the first callback after.
+	chrono::steady_clock::time_point triggerTime; // Set when triggering.  Used by callback.
+	chrono::steady_clock::time_point arrivalTime; // Set by the callback, before it signals
+	mutex lock;
+};
+
+class FlyCapSource : public CameraSource {
+private:
+	BusManager mgr;
+	Camera camL, camR;
+	CameraInfo camInfoL, camInfoR;
+	bool camLConnected = false, camRConnected = false;
+	list<const Benchmarker *> * bms;
+	Benchmarker bmCamControl;
+	Benchmarker bmLatencyL, bmLatencyR;
+	Benchmarker bmSkew;
+	Benchmarker bmTimeoutsL, bmTimeoutsR;
+	Logger * logger = NULL;
+
+	// Point Grey camera serial numbers
+	unsigned int leftVisibleCamSn;
+	unsigned int rightVisibleCamSn;
+
+	// used for automatic control of camera properties
+	bool autoGainControlEnabled = false;
+	list<PropertyType> autoControlledProps;
+
+	// The callbacks come in on the driver's threads and signal an eventfd,
+	// which we wait on with a timeout, so that a camera that never
+	// delivers can't hang us.
+	Reactor cameraEvents;
+	chrono::milliseconds cameraTimeout;
+	bool imageArrivedL = false, imageArrivedR = false;
+	CameraCallbackItems cbItemsL = {cv::Mat(), FramePool::Slot(), NULL, -1, NULL, "left ", "Left camera trigger to callback",  FrameTracer::NO_FRAME, FrameTracer::NO_FRAME, chrono::steady_clock::time_point(), chrono::steady_clock::time_point()};
+	CameraCallbackItems cbItemsR = {cv::Mat(), FramePool::Slot(), NULL, -1, NULL, "right", "Right camera trigger to callback", FrameTracer::NO_FRAME, FrameTracer::NO_FRAME, chrono::steady_clock::time_point(), chrono::steady_clock::time_point()};
+
+	// Trigger to callback for each camera, and how much sooner the left
+	// image arrived than the right.  Logged whenever the cameras stop.
+	LatencyHistogram histLatencyL, histLatencyR;
+	LatencyHistogram histSkew;
+	void recordArrivals();
+
+	// True for success
+	bool initPtGreyCam (unsigned int sn, list<pair<string, double>> cam_props,
+		Camera &cam, CameraInfo &camInfo);
+	void startPtGreyCam(Camera &cam, CameraCallbackItems* cbItems);
+	void stopPtGreyCam (Camera &cam);
+	// Copies the image out of the driver's buffer into a frame pool slot
+	static cv::Mat cvMatFromFlyCap2Image(FlyCapture2::Image *img, FramePool * pool, FramePool::Slot &slot);
+	static void flyCapImgEvent(Image * pImage, const void * pCallbackData);
+	static void armCallback(CameraCallbackItems &items, unsigned long frame_id);
+	static void takeImage(CameraCallbackItems &items, cv::Mat &image, FramePool::Slot &slot);
+	PropertyType propTypeFromString(string p);
+	string propTypeToString(PropertyType  p);
+	string copyAutoGainLeftToRight();
+	void waitForCallbacks();
+
+public:
+	FlyCapSource(list<const Benchmarker *> * _bms) :
+		mgr(),
+		bms(_bms),
+		bmCamControl("API interactions with cameras"),
+		bmLatencyL ("Left camera trigger to frame"),
+		bmLatencyR ("Right camera trigger to frame"),
+		bmSkew     ("Stereo frame arrival skew"),
+		bmTimeoutsL("Left camera timeouts"),
+		bmTimeoutsR("Right camera timeouts"),
+		cameraTimeout(1000),
+		histLatencyL("Left camera trigger to frame"),
+		histLatencyR("Right camera trigger to frame"),
+		histSkew    ("Stereo frame arrival skew, right after left")
+	{
+		bms->push_back(&bmCamControl);
+		bms->push_back(&bmLatencyL );
+		bms->push_back(&bmLatencyR );
+		bms->push_back(&bmSkew     );
+		bms->push_back(&bmTimeoutsL);
+		bms->push_back(&bmTimeoutsR);
+	}
+
+	void init(json options, Logger * lgr, FramePool * pool);
+	void start();
+	void stop();
+	void trigger(unsigned long frame_id);
+	void retrieve(ImageDataSet &data);
+};
+
+#endif // __PCG_FLYCAPSOURCE_H__
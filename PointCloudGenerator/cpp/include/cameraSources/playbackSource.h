@@ -0,0 +1,106 @@
+/*
+	playbackSource.h
+
+	Frames from an earlier recording, either a single-file stereo
+	recording or TIFFs listed in a tab-separated index file.
+*/
+
+#ifndef __PCG_PLAYBACKSOURCE_H__
+#define __PCG_PLAYBACKSOURCE_H__
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <list>
+#include <deque>
+#include <memory>
+#include <chrono> // C++11
+
+#include <opencv2/core/core.hpp>
+
+#include "cameraSource.h"
+#include "benchmarker.h"
+#include "stereoRecording.h"
+#include "taskPool.h"
+
+// One line of a TIFF recording's index, and its images once decoded
+class TiffPlaybackFrame {
+public:
+	chrono::time_point<chrono::system_clock> frameTime;
+	bool lastFrame = false;
+	string pathL, pathR, pathIR;
+	ImageDataSet images; // Filled in on the decode pool
+	TaskPool::TaskGroup decoded;
+};
+
+class PlaybackSource : public CameraSource {
+private:
+	list<const Benchmarker *> * bms;
+	Benchmarker bmTiffDecodeWait;
+	Logger * logger = NULL;
+
+	chrono::time_point<chrono::system_clock> readTimeFromTabSepInput(istream &input);
+	bool playedFirstFrame = false;
+	string folderName;
+	string timestampPattern;
+	ifstream playIndexFile;
+	// Single-file recordings are played instead of the TIFFs, if present
+	string containerFilename;
+	StereoRecordingReader playReader; // Mapped, so played frames are never copied
+	size_t playFrame = 0;
+	chrono::milliseconds playbackStartOffset; // From the start of the recording
+	void rewind();
+	// TIFF recordings are decoded a few frames ahead, on a pool of their
+	// own, so playback doesn't wait on libtiff.  The pool is declared
+	// after the frames it decodes into, so it stops first.
+	size_t tiffReadAheadDepth = 0;
+	bool tiffIndexExhausted = false;
+	deque<unique_ptr<TiffPlaybackFrame>> tiffReadAhead;
+	TaskPool decodePool;
+	void queueTiffDecodes();
+	void decodeTiff(const string &path, const char * side, cv::Mat &img, bool &valid);
+	void readImagesFromTiffs(ImageDataSet &data);
+	void readImagesFromContainer(ImageDataSet &data);
+	chrono::time_point<chrono::system_clock> lastFrameTime;
+	bool playbackComplete = false;
+	chrono::system_clock::duration interframeDelay;
+	// How the frames in the recording being played were stored, left and
+	// right.  Recordings from before recording_info.json existed were
+	// always flipped, as configured.
+	bool recordingFlipped[2] = {false, false};
+	int recordingFlipCode[2] = {0, 0};
+
+public:
+	// Written alongside each recording, to say how its frames are stored
+	static const string REC_INFO_FILENAME;
+
+	PlaybackSource(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmTiffDecodeWait("Waiting on TIFF decode"),
+		playbackStartOffset(0),
+		decodePool(_bms, "TIFF decode pool"),
+		interframeDelay(0)
+	{
+		bms->push_back(&bmTiffDecodeWait);
+	}
+
+	void init(json options, Logger * lgr, FramePool * pool);
+	void start();
+	void stop() {;}
+	void trigger(unsigned long frame_id) {;}
+	void retrieve(ImageDataSet &data);
+
+	bool isPlayback() const { return true; }
+	bool isComplete() const { return playbackComplete; }
+	chrono::system_clock::duration getFrameDelay() const { return interframeDelay; }
+	// Single-file recordings only
+	bool seek(chrono::time_point<chrono::system_clock> t);
+	bool isImageFlipped(int side, int &flip_code) const {
+		flip_code = recordingFlipCode[side];
+		return recordingFlipped[side];
+	}
+	// Mapped recordings are read-only
+	bool areImagesWritable() const { return !playReader.isMapped(); }
+};
+
+#endif // __PCG_PLAYBACKSOURCE_H__
@@ -0,0 +1,60 @@
+/*
+	syntheticScene.h
+
+	A scene of textured planes and boxes, rendered straight into rectified
+	left and right images, along with the exact depth at every left pixel.
+
+	Coordinates are those of the left rectified camera, in metres: x to the
+	right, y down, z along the optical axis.  The right camera sits at
+	x = baseline.  Texture is a function of position in space, so both
+	cameras see the same surface detail.
+*/
+
+#ifndef __PCG_SYNTHETICSCENE_H__
+#define __PCG_SYNTHETICSCENE_H__
+
+#include <stdio.h>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "json.hpp"
+#include "stereoCal.h"
+using json = nlohmann::json;
+using namespace std;
+
+class SyntheticScene {
+private:
+	struct Vec3 {
+		double x, y, z;
+	};
+	struct Plane {
+		Vec3 point, normal;
+	};
+	struct Box { // Axis-aligned
+		Vec3 min, max;
+	};
+	vector<Plane> planes;
+	vector<Box> boxes;
+	double textureCellM; // Side of the cubes texture is drawn from
+	double nearM;        // Surfaces closer than this aren't seen
+
+	static Vec3 vecFromJson(const json &j);
+	// Distance along the ray to the nearest surface, with dir.z == 1 so
+	// that's also depth.  0 if nothing is hit.
+	double intersect(const Vec3 &origin, const Vec3 &dir) const;
+	unsigned char shade(const Vec3 &p) const;
+	// One camera's view.  depth may be NULL.
+	void renderView(double f, double cx, double cy, double origin_x, cv::Mat &img, cv::Mat * depth) const;
+
+public:
+	SyntheticScene() : textureCellM(0.1), nearM(0.1) {;}
+
+	// Reads the planes, boxes and texture scale.  Throws on bad configuration.
+	void init(json options);
+	// Renders both views at the calibration's resolution and rectified
+	// projections.  depth is CV_32FC1, in metres, for the left view.
+	void render(StereoCal &cal, cv::Mat &left, cv::Mat &right, cv::Mat &depth) const;
+};
+
+#endif // __PCG_SYNTHETICSCENE_H__
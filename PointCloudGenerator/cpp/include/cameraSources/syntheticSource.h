@@ -0,0 +1,47 @@
+/*
+	syntheticSource.h
+
+	Rendered frames, for running the whole pipeline without cameras.  The
+	scene is rendered once, rectified, at the resolution of the stereo
+	calibration, and every frame carries its exact depth, so results can
+	be scored against the truth.
+*/
+
+#ifndef __PCG_SYNTHETICSOURCE_H__
+#define __PCG_SYNTHETICSOURCE_H__
+
+#include <stdio.h>
+#include <chrono> // C++11
+
+#include <opencv2/core/core.hpp>
+
+#include "cameraSource.h"
+#include "syntheticScene.h"
+
+class SyntheticSource : public CameraSource {
+private:
+	Logger * logger = NULL;
+	FramePool * framePool = NULL;
+
+	SyntheticScene scene;
+	cv::Mat sceneL, sceneR, sceneDepth; // Rendered once, in init()
+	double noiseStdDev;          // Sensor noise added to every frame, in grey levels
+	chrono::milliseconds latency; // Between trigger and images, like a camera's exposure and readout
+	chrono::steady_clock::time_point triggerTime;
+
+	// Copies a view into a frame pool slot, adding noise
+	cv::Mat render(const cv::Mat &view, FramePool::Slot &slot);
+
+public:
+	SyntheticSource() : noiseStdDev(0), latency(0) {;}
+
+	// Also needs stereoCalFile, which PcgMain copies in from the
+	// processing section
+	void init(json options, Logger * lgr, FramePool * pool);
+	void start() {;}
+	void stop() {;}
+	void trigger(unsigned long frame_id);
+	void retrieve(ImageDataSet &data);
+};
+
+#endif // __PCG_SYNTHETICSOURCE_H__
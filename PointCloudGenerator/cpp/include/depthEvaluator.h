@@ -0,0 +1,71 @@
+/*
+	depthEvaluator.h
+
+	Scores stereo point clouds against the ground-truth depth that comes
+	with rendered frames, and reports throughput against accuracy for
+	each algorithm profile.
+
+	Points are taken to be in the stereo frame the algorithms emit, in
+	metres: X along the optical axis, Y to the right, Z down.  Each is
+	projected back into the left rectified image and compared with the
+	true depth at that pixel.
+*/
+
+#ifndef __PCG_DEPTHEVALUATOR_H__
+#define __PCG_DEPTHEVALUATOR_H__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono> // C++11
+
+#include <opencv2/core/core.hpp>
+
+#include <message_formats.h>
+#include "json.hpp"
+#include "imageDataSet.h"
+using json = nlohmann::json;
+using namespace std;
+
+class DepthEvaluator {
+private:
+	// Everything gathered for one algorithm profile
+	class ProfileResult {
+	public:
+		string name;
+		string algName;
+		unsigned long frames = 0;
+		unsigned long clouds = 0;
+		unsigned long points = 0;
+		unsigned long pointsWithoutTruth = 0; // Off the image, or where nothing was rendered
+		chrono::steady_clock::duration processingTime = chrono::steady_clock::duration(0);
+		vector<float> absErrors; // Metres, one per scored point
+		vector<float> relErrors; // Fraction of the true depth
+	};
+	vector<ProfileResult> results;
+
+	// Left rectified projection
+	double focalLenPx = 0;
+	double cx = 0, cy = 0;
+	// Points off by more than this fraction of their true depth are outliers
+	double outlierRelError = 0.1;
+
+	static double percentile(vector<float> values, double pct);
+
+public:
+	// Reads outlierRelError.  projection is the left rectified projection
+	// matrix from the stereo calibration.
+	void init(json options, cv::Mat projection);
+
+	// Following frames are counted against this profile
+	void beginProfile(string name, string alg_name);
+	// cloud may be NULL, if the algorithm produced none.  Frames without
+	// ground truth only count towards throughput.
+	void addFrame(const ImageDataSet &data, PointCloudDataMessage * cloud,
+		chrono::steady_clock::duration processing_time);
+
+	// One line per profile
+	string report() const;
+};
+
+#endif // __PCG_DEPTHEVALUATOR_H__
@@ -0,0 +1,83 @@
+/*
+	durability.h
+
+	Flushes the files written by PCG to storage from a background thread.
+	Only files registered here are flushed, rather than every dirty buffer
+	on the system, and nobody in the frame loop ever waits on it.
+*/
+
+#ifndef __PCG_DURABILITY_H__
+#define __PCG_DURABILITY_H__
+
+#include <stdio.h>
+#include <string>
+#include <list>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono> // C++11
+
+#include "json.hpp"
+#include "logger.h"
+#include "benchmarker.h"
+using json = nlohmann::json;
+using namespace std;
+
+class Durability {
+private:
+	// A file that stays open and grows, like the log or an index file
+	class AppendedFile {
+	public:
+		string path;
+		int fd;
+		off_t syncedBytes;
+	};
+
+	list<const Benchmarker *> * bms;
+	Benchmarker bmFlush;
+	Logger * logger = NULL;
+
+	// Configuration
+	chrono::milliseconds flushInterval;
+	size_t flushThresholdBytes = 0;
+
+	// Guarded by lock
+	mutex lock;
+	condition_variable wake;
+	list<AppendedFile> appendedFiles;
+	list<string> newFiles;
+	size_t pendingBytes = 0;
+	bool stopping = false;
+
+	thread flushThread;
+
+	void flushLoop();
+	// Returns the number of bytes flushed
+	size_t flushAll(int &num_files);
+
+public:
+	Durability(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmFlush("Flushing files to storage"),
+		flushInterval(1000)
+	{
+		bms->push_back(&bmFlush);
+	}
+	~Durability() { stop(); }
+
+	void init(json options, Logger * lgr);
+	// Starts the background thread.  Called by init().
+	void start();
+	// Flushes everything one last time, then stops the background thread.
+	void stop();
+
+	// Register a file that will keep being appended to.  It's re-flushed
+	// whenever it has grown.
+	void trackAppendedFile(string path);
+	// Register a file that has been completely written and closed.
+	// It's flushed once, along with its directory entry.
+	void trackNewFile(string path);
+};
+
+#endif // __PCG_DURABILITY_H__
@@ -0,0 +1,74 @@
+/*
+	framePool.h
+
+	Preallocated, page-aligned slots for camera images.  The camera
+	callback copies each image out of the driver's buffer into a slot,
+	once, and the slot then travels with the frame until every stage is
+	done with it.
+*/
+
+#ifndef __PCG_FRAMEPOOL_H__
+#define __PCG_FRAMEPOOL_H__
+
+#include <stdio.h>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <stdlib.h>
+
+#include "json.hpp"
+#include "logger.h"
+#include "benchmarker.h"
+using json = nlohmann::json;
+using namespace std;
+
+class FramePool {
+public:
+	// Returns its slot to the pool once every copy is gone.  Empty if the
+	// pool had nothing to give.
+	typedef shared_ptr<unsigned char> Slot;
+
+private:
+	list<const Benchmarker *> * bms;
+	Benchmarker bmStarved;
+	Benchmarker bmOccupancy;
+	Logger * logger = NULL;
+
+	// The memory and its free list.  Every slot handed out holds a
+	// reference, so a slot still out when the pool goes, or is
+	// re-initialised, keeps its memory and goes back to the old list.
+	class Storage {
+	public:
+		unsigned char * mem = NULL;
+		vector<unsigned char *> freeSlots;
+		mutex lock;
+		~Storage() { free(mem); }
+	};
+	shared_ptr<Storage> storage;
+	size_t slotBytes = 0;
+	size_t numSlots = 0;
+	size_t highWaterMark = 0; // Most slots ever in use at once
+
+public:
+	FramePool(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmStarved  ("Camera frame pool starved"),
+		bmOccupancy("Camera frame slots in use")
+	{
+		bms->push_back(&bmStarved  );
+		bms->push_back(&bmOccupancy);
+	}
+
+	// Reads numSlots and slotBytes.  Throws if the memory can't be had.
+	void init(json options, Logger * lgr);
+
+	// Safe to call from driver callbacks.  Never blocks; returns an empty
+	// Slot if every slot is in use, or bytes is more than a slot holds.
+	Slot claim(size_t bytes);
+
+	size_t getSlotBytes() const { return slotBytes; }
+	size_t getHighWaterMark() const { return highWaterMark; }
+};
+
+#endif // __PCG_FRAMEPOOL_H__
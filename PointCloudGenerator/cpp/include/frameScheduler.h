@@ -0,0 +1,72 @@
+/*
+	frameScheduler.h
+
+	Paces the frame loop against absolute deadlines, for frame rate caps
+	and for playback at the recorded cadence.
+*/
+
+#ifndef __PCG_FRAMESCHEDULER_H__
+#define __PCG_FRAMESCHEDULER_H__
+
+#include <stdio.h>
+#include <list>
+#include <thread>
+#include <atomic>
+#include <chrono> // C++11
+
+#include "json.hpp"
+#include "logger.h"
+#include "benchmarker.h"
+using json = nlohmann::json;
+using namespace std;
+
+class FrameScheduler {
+private:
+	list<const Benchmarker *> * bms;
+	Benchmarker bmSleeping;
+	Benchmarker bmMissedDeadlines;
+	Logger * logger;
+
+	// Configuration
+	double maxFps = 0; // 0 for no cap
+	double playbackSpeed = 1.0; // Multiple of the recorded rate; 0 for as fast as possible
+
+	// Deadline of the most recent frame.  The next deadline is measured from
+	// this, not from when we got around to asking, so time spent working on
+	// a frame comes out of the following sleep.
+	chrono::steady_clock::time_point lastDeadline;
+	bool haveDeadline = false;
+	// Set by reset() from any thread; the deadline itself is only touched
+	// by the thread calling waitForNextFrame().
+	atomic<bool> resetRequested{false};
+
+	chrono::steady_clock::duration getFramePeriod(chrono::system_clock::duration recorded_delay);
+
+public:
+	FrameScheduler(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmSleeping       ("Sleeping until frame deadline"),
+		bmMissedDeadlines("Missed frame deadlines")
+	{
+		bms->push_back(&bmSleeping       );
+		bms->push_back(&bmMissedDeadlines);
+	}
+
+	void init(json options, Logger * lgr);
+
+	// Forget the previous deadline, eg. after being disabled for a while.
+	// Safe from any thread: takes effect at the next waitForNextFrame().
+	void reset() { resetRequested = true; }
+
+	// True if waitForNextFrame() may sleep, given whether we're playing back.
+	bool isPacing(bool playback);
+
+	// Sleeps until the next frame is due.  recorded_delay is the time between
+	// the previous frame and the next one in a recording; pass zero for live
+	// cameras.
+	void waitForNextFrame(bool playback, chrono::system_clock::duration recorded_delay);
+
+	int getMissedDeadlines() const { return bmMissedDeadlines.getIterations(); }
+};
+
+#endif // __PCG_FRAMESCHEDULER_H__
@@ -0,0 +1,93 @@
+/*
+	frameTracer.h
+
+	Records timed spans, tagged with the ID of the frame they worked on,
+	into a fixed-size in-memory ring.  The ring can be written out as
+	Chrome trace_event JSON (open it in chrome://tracing or Perfetto) to see
+	where an individual frame's time went.
+
+	Every Benchmarker reports its spans here, so anything that's
+	benchmarked is also traced.  Each thread says which frame it is
+	working on with setCurrentFrame().
+*/
+
+#ifndef __PCG_FRAMETRACER_H__
+#define __PCG_FRAMETRACER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono> // C++11
+
+#include "json.hpp"
+using json = nlohmann::json;
+using namespace std;
+
+class FrameTracer {
+public:
+	// Frame ID for work that doesn't belong to a camera frame
+	static const unsigned long NO_FRAME = 0;
+
+private:
+	// Longer span names are cut short
+	static const size_t MAX_NAME_CHARS = 64;
+
+	class SpanData {
+	public:
+		char name[MAX_NAME_CHARS]; // A copy, so callers' strings needn't outlive the span
+		unsigned long frameId;
+		unsigned int threadNum;
+		chrono::steady_clock::time_point start;
+		chrono::steady_clock::time_point end;
+	};
+	// A ring slot, guarded as a seqlock: seq is odd while a writer fills
+	// in data, and moves on by two each time it's written.  Readers copy
+	// data and keep the copy only if seq was even and unchanged across it.
+	class Span {
+	public:
+		atomic<unsigned long> seq{0};
+		SpanData data = SpanData(); // Empty name, so skipped by dump() until used
+	};
+
+	static bool enabled;
+	static vector<Span> ring;
+	static atomic<unsigned long> nextSlot;
+	static atomic<unsigned int> nextThreadNum;
+	static string outputPath;
+	static chrono::steady_clock::time_point epoch;
+
+	static mutex threadNamesLock;
+	static vector<pair<unsigned int, string>> threadNames;
+
+	static unsigned int getThreadNum();
+
+public:
+	// Not thread-safe; call before any thread records.
+	static void init(json options);
+	static bool isEnabled() { return enabled; }
+
+	// Name this thread in the trace viewer
+	static void setThreadName(string name);
+	// Subsequent spans from this thread are attributed to this frame
+	static void setCurrentFrame(unsigned long frame_id);
+	static unsigned long getCurrentFrame();
+
+	// Record a span against the current frame of this thread.  The name is
+	// copied, up to MAX_NAME_CHARS - 1 characters.
+	static void record(const char * name, chrono::steady_clock::time_point start,
+		chrono::steady_clock::time_point end);
+	// Record a span against a specific frame
+	static void record(unsigned long frame_id, const char * name,
+		chrono::steady_clock::time_point start, chrono::steady_clock::time_point end);
+
+	// Writes the spans currently in the ring to the output file, oldest first.
+	// Spans recorded while this runs may or may not be included, and a
+	// span being written as it's read is left out.
+	// Returns the path written, or "" if nothing was written.
+	static string dump();
+};
+
+#endif // __PCG_FRAMETRACER_H__
@@ -9,16 +9,16 @@
 #ifndef __PCG_IMAQ_H__
 #define __PCG_IMAQ_H__
 
-#include <FlyCapture2.h>
 #include <stdio.h>
 #include <iostream>
+#include <fstream>
 #include <list>
 #include <utility>
 #include <thread>
 // #include <sys/time.h>
 #include <chrono> // C++11
+#include <memory>
 #include <sys/stat.h>
-#include <semaphore.h>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -26,102 +26,74 @@
 
 #include "logger.h"
 #include "benchmarker.h"
-
-using namespace FlyCapture2;
-
-// Used like a struct, holds one frame of input data from camera-like sensors.
-class ImageDataSet {
-public:
-	chrono::time_point<chrono::system_clock> acquisitionTime;
-	cv::Mat imgVisibleL, imgVisibleR;
-	bool imgVisibleLValid, imgVisibleRValid; // true for each succesfully acquired image
-	cv::Mat imgInfrared;
-	bool imgInfraredValid;
-
-	unsigned long getTimeAcquiredS();
-	unsigned long getTimeAcquiredMs(); // milliseconds within the second
-	
-	unsigned long getDurationSinceAcquiredMs(); // milliseconds between acquisition and now
-};
-
-struct CameraCallbackItems {
-	cv::Mat image;   // Set by the callback
-	sem_t * pSem;    // Used by the callback
-	Logger * logger; // Used by the callback
-	char side[6];    // "left " or "right".  Used by callback.
-};
+#include "durability.h"
+#include "frameTracer.h"
+#include "framePool.h"
+#include "stereoRecording.h"
+#include "imageDataSet.h"
+#include "ingestWindow.h"
+#include "cameraSources/cameraSource.h"
 
 class ImageAcquisition {
 private:
 	static const string REC_EXT;
-	BusManager mgr;
-	Camera camL, camR;
-	CameraInfo camInfoL, camInfoR;
 	bool running;
-	bool camLConnected, camRConnected;
 	list<const Benchmarker *> * bms;
-	Benchmarker bmCamControl;
 	Benchmarker bmFlipImageCpu;
 	Benchmarker bmSaveImages  ;
+	Benchmarker bmIngest      ;
+	FramePool framePool;
 	Logger * logger;
-	
-	// True for success
-	bool initPtGreyCam (unsigned int sn, list<pair<string, double>> cam_props, 
-		Camera &cam, CameraInfo &camInfo);
-	void startPtGreyCam(Camera &cam, CameraCallbackItems* cbItems);
-	void stopPtGreyCam (Camera &cam);
-	static cv::Mat cvMatFromFlyCap2Image(FlyCapture2::Image *img);
-	void saveImages(ImageDataSet data);
-	PropertyType propTypeFromString(string p);
-	string propTypeToString(PropertyType  p);
-	
-	// Point Grey camera serial numbers
-	unsigned int leftVisibleCamSn;
-	unsigned int rightVisibleCamSn;
-	
-	// used for automatic control of camera properties
-	bool autoGainControlEnabled = false;
-	list<PropertyType> autoControlledProps;
+	Durability * durability;
+	// Where frames come from.  Chosen by mode and cameraSource in init(),
+	// and declared after the pool its images may live in, so it goes first.
+	unique_ptr<CameraSource> source;
 
 	// Record and playback features
-	chrono::time_point<chrono::system_clock> readTimeFromTabSepInput(istream &input);
-	bool playedFirstFrame = false;
 	bool recordEnabled = false;
 	bool playbackEnabled = false;
 	string folderName;
 	string timestampPattern;
-	string filenamePattern;
 	ofstream recIndexFile;
-	ifstream playIndexFile;
-	chrono::time_point<chrono::system_clock> lastFrameTime;
-	bool playbackComplete = false;
-	chrono::system_clock::duration interframeDelay;
+	// Single-file recordings, used instead of the TIFFs and their index file
+	bool recordToContainer = false;
+	string containerFilename;
+	StereoRecordingWriter recWriter; // Opened at the first frame, once its size is known
+	void saveImagesToContainer(const ImageDataSet &data);
 	bool flipImgL, flipImgR; // To flip or not
 	int imgFlipCodeL, imgFlipCodeR; // Argument to cv::flip: 0 flips around x axis, 1 around y, -1 around both
-	string autoGainControlValues = "";
+	// If set, images are left as the sensor sees them, and the rectification
+	// maps do the flipping instead.
+	bool foldFlips = false;
+	// Flips each image from however the source delivers it to however
+	// processing wants it
+	void orientImages(ImageDataSet &data);
+	void orientImage(cv::Mat &img, int side, bool flip, int flip_code, bool in_place);
+	// Crop and binning for processing.  Recordings keep full frames.
+	IngestWindow ingestWindow;
+	void ingestImage(cv::Mat &img, FramePool::Slot &slot, bool flipped, int flip_code);
 	chrono::time_point<chrono::system_clock> lastAcquisitionTime;
-	
-	// Used in image acquisition callback
-	sem_t imageWaitL, imageWaitR;
-	struct timespec imageWaitTimeout = {1, 0};
-	CameraCallbackItems cbItemsL = {cv::Mat(), NULL, NULL, "left "};
-	CameraCallbackItems cbItemsR = {cv::Mat(), NULL, NULL, "right"};
+	unsigned long lastFrameId = FrameTracer::NO_FRAME;
 
 public:
 	ImageAcquisition(list<const Benchmarker *> * _bms) :
-		mgr(),
+		running(false),
 		bms(_bms),
-		bmCamControl  ("API interactions with cameras"),
 		bmFlipImageCpu("Flipping images"),
 		bmSaveImages  ("Saving images"),
+		bmIngest      ("Cropping and binning images"),
+		framePool(_bms),
 		recIndexFile()
 	{
-		bms->push_back(&bmCamControl  );
 		bms->push_back(&bmFlipImageCpu);
 		bms->push_back(&bmSaveImages  );
+		bms->push_back(&bmIngest      );
 	}
 
-	void init(json options, Logger * lgr);
+	void init(json options, Logger * lgr, Durability * dur);
+	// The crop comes from the calibration, fitted to its rectification
+	// maps.  Set before start().
+	void setIngestWindow(const IngestWindow &window) { ingestWindow = window; }
 	
 	// Control operation
 	void start();
@@ -130,12 +102,22 @@ public:
 	
 	// Query state
 	bool isPlaybackEnabled() { return playbackEnabled; }
-	bool isPlaybackComplete() { return playbackComplete; }
-	chrono::system_clock::duration getFrameDelay() { return interframeDelay; }
+	bool isRecordEnabled() { return recordEnabled; }
+	bool isPlaybackComplete() { return source->isComplete(); }
+	chrono::system_clock::duration getFrameDelay() { return source->getFrameDelay(); }
+	// Carries on playing from the last frame recorded at or before t.
+	// Single-file recordings only.  True for success.
+	bool seekPlayback(chrono::time_point<chrono::system_clock> t) { return source->seek(t); }
 	
 	ImageDataSet acquireImages();
-
-	static void flyCapImgEvent(Image * pImage, const void * pCallbackData);
+	// Crops and bins a set of acquired images as configured, leaving them
+	// as the rectification maps expect.  Call after the full frames have
+	// gone to the recorder.
+	void ingest(ImageDataSet &data);
+	// Writes a set of acquired images to the recording directory.
+	// Called from the image recorder's thread, so that storage stalls
+	// don't hold up acquisition.
+	void saveImages(ImageDataSet data);
 
 	virtual void beginAcquisition();
 };
@@ -0,0 +1,47 @@
+/*
+	imageDataSet.h
+	
+	One frame of input from the camera-like sensors.  Moved out of
+	imageAcquisition.h, so camera sources can use it on their own.
+*/
+
+#ifndef __PCG_IMAGEDATASET_H__
+#define __PCG_IMAGEDATASET_H__
+
+#include <string>
+#include <chrono> // C++11
+
+#include <opencv2/core/core.hpp>
+
+#include "frameTracer.h"
+#include "framePool.h"
+using namespace std;
+
+// Used like a struct, holds one frame of input data from camera-like sensors.
+class ImageDataSet {
+public:
+	unsigned long frameId = FrameTracer::NO_FRAME; // Assigned when the frame is triggered
+	chrono::time_point<chrono::system_clock> acquisitionTime;
+	cv::Mat imgVisibleL, imgVisibleR;
+	bool imgVisibleLValid, imgVisibleRValid; // true for each succesfully acquired image
+	// Frame pool slots the live images live in.  The Mats above don't own
+	// that memory, so they mustn't outlive this object.
+	FramePool::Slot slotVisibleL, slotVisibleR;
+	cv::Mat imgInfrared;
+	bool imgInfraredValid;
+	string autoGainValues; // Camera settings copied left to right for this frame, if any
+	// Set when the images are already rectified, as rendered ones are.
+	// Algorithms then use them as they are, rather than remapping them.
+	bool isRectified = false;
+	// Depth in metres along the optical axis at each pixel of the left
+	// rectified image, 0 where nothing was hit.  Empty unless the source
+	// knows it.  Shared between frames, so never modify it.
+	cv::Mat depthTruth;
+
+	unsigned long getTimeAcquiredS();
+	unsigned long getTimeAcquiredMs(); // milliseconds within the second
+	
+	unsigned long getDurationSinceAcquiredMs(); // milliseconds between acquisition and now
+};
+
+#endif // __PCG_IMAGEDATASET_H__
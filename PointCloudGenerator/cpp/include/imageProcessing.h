@@ -14,6 +14,9 @@
 #include <sys/time.h>
 #include <chrono> // C++11
 #include <list>
+#include <vector>
+#include <memory>
+#include <atomic>
 
 #include <opencv2/opencv.hpp>
 
@@ -23,9 +26,13 @@
 #include "imageAcquisition.h"
 #include "stereoCal.h"
 #include "benchmarker.h"
+#include "taskPool.h"
 // All stereo processing algorithms supported must be listed here
 #include "ptCloudGenAlgs/dummyAlg.h"
 #include "ptCloudGenAlgs/gpuFastWithBinnedKps.h"
+#include "ptCloudGenAlgs/cpuFastWithBinnedKps.h"
+#include "ptCloudGenAlgs/cpuCensusSgm.h"
+#include "ptCloudGenAlgs/cpuFastPostUndistort.h"
 using namespace cv;
 using json = nlohmann::json;
 using namespace std;
@@ -38,30 +45,69 @@ private:
 	StereoCal cal_data;
 	bool enableGpu;
 	Benchmarker bmImgTotal;
+	TaskPool taskPool;
 	
-	StereoPtCloudGenAlg * alg = NULL;
+	// An algorithm, and the options it was initialized with.  Every profile
+	// is built and warmed up by init(), so switching between them is cheap.
+	class AlgorithmProfile {
+	public:
+		string name;
+		string algName;
+		StereoPtCloudGenAlg * alg = NULL;
+		// The algorithm's own, named after the profile, so two profiles
+		// of the same algorithm report separately
+		list<const Benchmarker *> bms;
+	};
+	vector<unique_ptr<AlgorithmProfile>> profiles; // At fixed addresses
+	size_t activeProfile = 0;
+	atomic<int> requestedProfile; // -1 when no switch is pending
+	
+	StereoPtCloudGenAlg * alg = NULL; // That of the active profile
+	
+	StereoPtCloudGenAlg * createAlgorithm(string alg_name, list<const Benchmarker *> * alg_bms);
+	// Creates and initializes the profile's algorithm, and registers its
+	// benchmarkers under the profile's name
+	void loadProfile(AlgorithmProfile &profile, json options);
+	// Runs one blank frame through, so buffers and GPU state are allocated
+	// before the first real frame arrives.  The profile's benchmarkers
+	// then start afresh, so the warm-up doesn't count.
+	void warmUp(AlgorithmProfile &profile);
+	// Recursively overwrites values in base with those in overrides
+	static void mergeOptions(json &base, const json &overrides);
 	
 public:
 	ImageProcessing(list<const Benchmarker *> * _bms) : 
 		bms(_bms),
-		bmImgTotal("Total image processing")
+		bmImgTotal("Total image processing"),
+		taskPool(_bms),
+		requestedProfile(-1)
 	{
 		bms->push_back(&bmImgTotal);
 	}
 	
 	~ImageProcessing() {
-		if(alg != NULL) {
-			delete alg;
+		for(auto &profile : profiles) {
+			delete profile->alg;
 		}
+		taskPool.stop();
 	}
-	void init(json options, Logger * lgr);
+	void init(json options, Logger * lgr, MsgBufferPool * msg_pool);
 	void processImages(ImageDataSet imgData);
+	// Switches to the given algorithm profile at the start of the next frame.
+	// Safe to call from any thread.  Returns false if there's no such profile.
+	bool selectProfile(unsigned int profile_idx);
+	size_t getNumProfiles() { return profiles.size(); }
+	string getProfileName(size_t profile_idx) { return profiles[profile_idx]->name; }
+	string getProfileAlgName(size_t profile_idx) { return profiles[profile_idx]->algName; }
+	StereoCal & getStereoCal() { return cal_data; }
 	bool areCvWindowsOpen();
 	
 	// It's more efficient for this class to generate the message.
-	// This class will be responsible for delet[]ion; the caller should not delete[].
+	// This class keeps ownership; the pointer is good until the next frame.
 	PointCloudDataMessage * getPointCloud();
 	bool isPointCloudAvailable();
+	// Hands the point cloud over in a pooled buffer.  See StereoPtCloudGenAlg::takePointCloud().
+	MsgBufferPool::Buffer takePointCloud();
 };
 
 #endif // __PCG_PROC_H__
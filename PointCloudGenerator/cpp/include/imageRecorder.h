@@ -0,0 +1,82 @@
+/*
+	imageRecorder.h
+
+	Writes recorded frames to storage on a thread of its own, so that a
+	slow card stalls the recorder and not the cameras.  Frames are queued
+	by value; the images inside share their pixels with the pipeline.
+*/
+
+#ifndef __PCG_IMAGERECORDER_H__
+#define __PCG_IMAGERECORDER_H__
+
+#include <list>
+#include <thread>
+#include <functional>
+
+#include "json.hpp"
+#include "logger.h"
+#include "benchmarker.h"
+#include "boundedQueue.h"
+#include "imageAcquisition.h"
+using json = nlohmann::json;
+using namespace std;
+
+class ImageRecorder {
+public:
+	typedef function<void(const ImageDataSet &)> Writer;
+
+	// What to do with a new frame when the queue is full
+	enum OverflowPolicy {
+		BLOCK,       // Hold up acquisition until there's room
+		DROP_OLDEST, // Discard the oldest queued frame
+		EVERY_NTH    // Keep only every Nth frame until the queue has drained
+	};
+
+private:
+	list<const Benchmarker *> * bms;
+	Benchmarker bmQueueDepth;
+	Benchmarker bmDropped;
+	Benchmarker bmWrite;
+	Benchmarker bmBandwidth;
+	Logger * logger = NULL;
+
+	BoundedQueue<ImageDataSet> queue;
+	OverflowPolicy policy = BLOCK;
+	unsigned int everyN = 1;
+	bool thinning = false;       // Set once the queue fills, under EVERY_NTH
+	unsigned int sinceKept = 0;  // Frames offered since the last one kept, while thinning
+	Writer writer;
+	thread writerThread;
+
+	void run();
+	void dropped();
+
+public:
+	ImageRecorder(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmQueueDepth("Image recording queue depth"),
+		bmDropped   ("Recorded frames dropped"),
+		bmWrite     ("Writing recorded images (KiB)"),
+		bmBandwidth ("Image recording bandwidth (KiB/s)")
+	{
+		bms->push_back(&bmQueueDepth);
+		bms->push_back(&bmDropped   );
+		bms->push_back(&bmWrite     );
+		bms->push_back(&bmBandwidth );
+	}
+	~ImageRecorder() { stop(); }
+
+	// Reads queueDepth, overflowPolicy and recordEveryN
+	void init(json options, Logger * lgr);
+
+	// Starts the writer thread, which hands each frame to write
+	void start(Writer write);
+	// Writes out whatever is still queued, then stops the writer thread
+	void stop();
+
+	// Called once per acquired frame.  Only blocks under BLOCK, or when
+	// keeping a frame under EVERY_NTH.
+	void submit(const ImageDataSet &data);
+};
+
+#endif // __PCG_IMAGERECORDER_H__
@@ -0,0 +1,70 @@
+/*
+	ingestWindow.h
+
+	The part of each camera image that's processed, and how far it's
+	binned.  Images are cropped and binned as they enter the pipeline, and
+	the rectification maps are built to take those smaller images straight
+	to a smaller rectified image, so no later stage sees a full frame.
+
+	The region of interest is in full-resolution rectified coordinates.
+	The raw crop is fitted to the rectification maps: it takes in every
+	pixel the maps sample for the region, plus what interpolation reads
+	around them.  StereoCal fits it, and ImageAcquisition is handed
+	StereoCal's window, so they always agree.
+*/
+
+#ifndef __PCG_INGESTWINDOW_H__
+#define __PCG_INGESTWINDOW_H__
+
+#include <stdio.h>
+
+#include <opencv2/core/core.hpp>
+
+#include "json.hpp"
+using json = nlohmann::json;
+using namespace std;
+
+class IngestWindow {
+private:
+	// Input pixels kept around the samples, for bilinear interpolation's
+	// far neighbour and for rounding to bins
+	static const int INTERP_MARGIN = 2;
+
+	cv::Rect roi; // Empty for the whole frame
+	int binning = 1;
+	cv::Rect inputRect; // Upright, full resolution.  Empty until fitted.
+
+	// Shrinks r's size to a whole number of bins
+	cv::Rect trimToBins(cv::Rect r) const;
+	cv::Size binned(const cv::Rect &r) const { return cv::Size(r.width / binning, r.height / binning); }
+
+public:
+	// Reads roi, as [x, y, width, height], and binning.  A zero width or
+	// height takes the whole frame.  Throws on bad configuration.
+	void init(json options);
+
+	bool isFullFrame() const { return roi.area() == 0 && binning == 1; }
+	int getBinning() const { return binning; }
+
+	// The region of interest in an upright, full-resolution rectified
+	// image of full_size, trimmed to fit and to a whole number of bins
+	cv::Rect getRoi(cv::Size full_size) const;
+	cv::Size getOutputSize(cv::Size full_size) const { return binned(getRoi(full_size)); }
+
+	// Grows the input rect to take in everything a pair of full-resolution
+	// maps for the region of interest samples, in an upright raw image of
+	// full_size.  Called for each camera, so both share one input size.
+	void fitInputToMaps(cv::Size full_size, const cv::Mat &map_x, const cv::Mat &map_y);
+
+	// The region cropped from a raw image of full_size: the whole frame
+	// until fitted.  If the image hasn't been flipped upright yet, flipped
+	// is set and flip_code is as for cv::flip.
+	cv::Rect getInputRect(cv::Size full_size, bool flipped = false, int flip_code = 0) const;
+	cv::Size getInputSize(cv::Size full_size) const { return binned(getInputRect(full_size)); }
+
+	// Crops in to rect, then averages each block of binning x binning
+	// pixels.  Uses out's memory if it's already the right size.
+	void apply(const cv::Mat &in, const cv::Rect &rect, cv::Mat &out) const;
+};
+
+#endif // __PCG_INGESTWINDOW_H__
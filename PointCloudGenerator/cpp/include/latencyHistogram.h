@@ -0,0 +1,50 @@
+/*
+	latencyHistogram.h
+
+	Fixed-width buckets of durations, for latencies that need more than an
+	average but have to be gathered for as long as we run.  Memory is set
+	at construction, unlike Benchmarker's samples.  Durations may be
+	negative, for skews.
+
+	Not thread-safe; add() from one thread.
+*/
+
+#ifndef __PCG_LATENCYHISTOGRAM_H__
+#define __PCG_LATENCYHISTOGRAM_H__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono> // C++11
+using namespace std;
+
+class LatencyHistogram {
+private:
+	string name;
+	chrono::microseconds minUs, bucketUs;
+	vector<unsigned long> buckets;
+	unsigned long underflows = 0, overflows = 0;
+	unsigned long total = 0;
+
+public:
+	LatencyHistogram(string _name = "") :
+		name(_name),
+		minUs(0),
+		bucketUs(1)
+	{;}
+
+	// Covers [min_us, max_us).  Anything outside lands in an under- or
+	// overflow count.  Clears any samples.
+	void init(long min_us, long max_us, long bucket_us);
+	void add(chrono::steady_clock::duration d);
+	void clear();
+
+	unsigned long getCount() const { return total; }
+	// Upper edge of the bucket in which pct percent of samples fell, in
+	// ms.  Saturates at the histogram's edges.
+	double getPercentileMs(double pct) const;
+	// Name, percentiles, then one line per non-empty bucket
+	string toString() const;
+};
+
+#endif // __PCG_LATENCYHISTOGRAM_H__
@@ -15,6 +15,7 @@
 #include <fstream>
 #include <chrono> // C++11
 #include <ctime> // Bits that C++11 is missing
+#include <mutex>
 #include "json.hpp"
 using json = nlohmann::json;
 using namespace std;
@@ -36,6 +37,9 @@ private:
 
 	string getTimeString();
 	string timestampPattern = "";
+	string logFilePath = ""; // Empty unless logging to a file
+	// Stages, task pool workers and the flusher all log, so one line at a time
+	mutex lock;
 	void log(string message);
 	
 public:
@@ -45,6 +49,7 @@ public:
 	void logWarning (string message);
 	void logInfo    (string message);
 	void logDebug   (string message);
+	string getFilePath() { return logFilePath; }
 };
 
 
@@ -23,6 +23,8 @@
 
 #include <message_formats.h>
 #include "logger.h"
+#include "benchmarker.h"
+#include "msgBufferPool.h"
 #include "json.hpp"
 using json = nlohmann::json;
 
@@ -49,16 +51,31 @@ private:
 	uint16_t cmdRespSourcePort; // when we transmit command responses, it comes from this port.
 
 	Logger * logger;
+	// Received messages are handed out in these
+	MsgBufferPool recvPool;
 	
 	void initListen();
 	void initSend();
+	// Moves past the message of msg_len bytes at the start of the buffer
+	void consumeMessage(size_t msg_len);
 public:
+	Messaging(list<const Benchmarker *> * _bms) :
+		recvPool(_bms, "Received message")
+	{ ; }
 
 	static void test();
 	void init(json options, Logger * lgr);
 	void setBlockingListen(bool block);
+	int getListenSocket() { return sockInbound; } // For waiting on with a Reactor
 	void sendMessage(const Msg * msg);
-	Msg * checkForMessage(); // Returns null if no message is waiting.  If not null, caller is responsible for delete[]ing the returned object.
+	// Returns an empty buffer if no message is waiting.  The buffer goes back
+	// to the pool when the caller lets go of it.
+	MsgBufferPool::Buffer checkForMessage();
+	// The next whole message still in the receive buffer, or NULL.  For
+	// when checkForMessage() had no pool buffer to copy it into: handle it
+	// where it is, then discardPendingMessage().
+	const Msg * peekPendingMessage() const;
+	void discardPendingMessage();
 };
 
 
@@ -0,0 +1,78 @@
+/*
+	msgBufferPool.h
+
+	Fixed-capacity pool of message buffers, allocated once at startup.
+	Buffers are handed out as unique_ptrs which give themselves back to the
+	pool when destroyed, so messages can be built, queued, sent and
+	released without touching the heap.
+*/
+
+#ifndef __PCG_MSGBUFFERPOOL_H__
+#define __PCG_MSGBUFFERPOOL_H__
+
+#include <stdio.h>
+#include <string.h>
+#include <list>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+#include <message_formats.h>
+#include "json.hpp"
+#include "logger.h"
+#include "benchmarker.h"
+using json = nlohmann::json;
+using namespace std;
+
+class MsgBufferPool {
+public:
+	class Releaser {
+	public:
+		MsgBufferPool * pool = NULL;
+		void operator()(char * buf) const { if(pool != NULL) { pool->release(buf); } }
+	};
+	// Empty if the pool had nothing to give
+	typedef unique_ptr<char, Releaser> Buffer;
+
+private:
+	list<const Benchmarker *> * bms;
+	Benchmarker bmExhausted;
+	Logger * logger = NULL;
+
+	vector<char> storage;
+	vector<char *> freeBuffers;
+	size_t bufferBytes = 0;
+	size_t numBuffers = 0;
+	size_t lowWaterMark = 0; // Fewest buffers ever free at once
+	bool doubleBuffer = false;
+	mutex lock;
+
+	void release(char * buf);
+
+public:
+	MsgBufferPool(list<const Benchmarker *> * _bms, string name) :
+		bms(_bms),
+		bmExhausted(name + " buffer pool exhausted")
+	{
+		bms->push_back(&bmExhausted);
+	}
+
+	// Reads numBuffers, bufferBytes and doubleBuffer
+	void init(json options, Logger * lgr);
+	void init(size_t num_buffers, size_t buffer_bytes, bool double_buffer, Logger * lgr);
+
+	// Returns an empty Buffer if every buffer is in use, or if bytes is
+	// more than a buffer holds.  Never blocks.
+	Buffer acquire(size_t bytes);
+	// Acquires a buffer and copies the whole message into it
+	Buffer copyOf(const Msg * msg);
+
+	// If set, producers hand off the buffer they filled and start the next
+	// message in a fresh one, rather than having it copied out.
+	bool isDoubleBuffered() const { return doubleBuffer; }
+	size_t getBufferBytes() const { return bufferBytes; }
+	size_t getNumBuffers() const { return numBuffers; }
+	size_t getLowWaterMark() const { return lowWaterMark; }
+};
+
+#endif // __PCG_MSGBUFFERPOOL_H__
@@ -9,16 +9,29 @@
 #ifndef __PCG_H__
 #define __PCG_H__
 
-#include <unistd.h> // for sync()
 #include <list>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <condition_variable>
 
 #include "imageAcquisition.h"
 #include "imageProcessing.h"
 #include "messaging.h"
 #include "logger.h"
 #include "attitudeTracker.h"
+#include "durability.h"
+#include "frameScheduler.h"
+#include "frameTracer.h"
 #include "lidarReader.h"
 #include "dummyPointCloud.h"
+#include "boundedQueue.h"
+#include "reactor.h"
+#include "msgBufferPool.h"
+#include "imageRecorder.h"
+#include "depthEvaluator.h"
 
 using namespace std;
 
@@ -26,6 +39,26 @@ typedef struct affine3d_tag {
 	double t[3][4];
 } affine3d;
 
+// One unit of work flowing through the frame pipeline.  Stereo frames are
+// created by the acquisition stage; LIDAR frames enter at the output stage.
+class PipelineFrame {
+public:
+	ImageDataSet images;
+	PointCloudSource source = PointCloudSource::INVALID;
+	chrono::time_point<chrono::system_clock> acquisitionTime;
+	PointCloudMetadataMessage metadata; // Filled in by the output stage
+	
+	// The cloud's buffer goes back to its pool along with the frame
+	void setCloud(MsgBufferPool::Buffer cloud) {
+		cloudBuffer = std::move(cloud);
+	}
+	PointCloudDataMessage * getCloud() {
+		return (PointCloudDataMessage*)cloudBuffer.get();
+	}
+private:
+	MsgBufferPool::Buffer cloudBuffer;
+};
+
 class PcgMain {
 private:
 	static const char * DEFAULT_CONFIG_FILENAME;
@@ -33,16 +66,57 @@ private:
 	// Submodule objects
 	list<const Benchmarker *> allBms;
 	Logger logger;
+	// Point cloud messages.  Declared early, so it outlives every frame
+	// and algorithm holding one of its buffers.
+	MsgBufferPool cloudPool;
+	Durability durability;
+	FrameScheduler frameScheduler;
 	Messaging messaging;
 	ImageAcquisition img_acquisition;
+	// Declared after img_acquisition, so it finishes writing before that goes
+	ImageRecorder imageRecorder;
 	ImageProcessing img_processing;
 	AttitudeTracker attitude_tracker;
 	LidarReader lidar;
-	Benchmarker bmOneFrame;
+	Benchmarker bmControlLoop;
 	Benchmarker bmImageAcq;
+	Benchmarker bmProcStage;
+	Benchmarker bmOutputStage;
+	Benchmarker bmRecordStage;
+	Benchmarker bmDroppedFrames;
+	Benchmarker bmDroppedLidar;
+	Benchmarker bmSending;
 	Benchmarker bmPcXform;
 	Benchmarker bmSaveFiles;
-	Benchmarker bmSyncFs;
+	
+	// Pipeline stages and the queues between them.
+	// acquisition -> processing -> output (transform & send) -> recording
+	// Recorded images leave from acquisition, for imageRecorder.
+	BoundedQueue<shared_ptr<PipelineFrame>> processingQueue;
+	BoundedQueue<shared_ptr<PipelineFrame>> outputQueue;
+	BoundedQueue<shared_ptr<PipelineFrame>> recordingQueue;
+	list<thread> stageThreads;
+	atomic<bool> pipelineRunning;
+	atomic<bool> playbackFinished;
+	// Held while cameras are started or stopped, so that enable() and
+	// disable() on the control thread never race the acquisition stage.
+	// Reading a frame can take up to the camera timeout, so the stage
+	// drops it meanwhile and sets acquiring instead; disable() waits for
+	// that to clear before stopping the cameras.
+	mutex acquisitionMutex;
+	condition_variable acquisitionCv;
+	bool acquisitionTriggered = false;
+	bool acquiring = false;
+	
+	// The control thread sleeps in here until a command arrives or the
+	// control timer fires.
+	Reactor reactor;
+	int controlTimerFd = -1; // Armed only while enabled
+	chrono::steady_clock::time_point lastTraceDump;
+	// Periodic and on-disable trace dumps are written from here, so a
+	// large trace doesn't hold up the control thread
+	thread traceDumpThread;
+	atomic<bool> traceDumpBusy{false};
 
 	// Items controlled by the configuration file
 	bool pcgEnabled; 
@@ -56,9 +130,31 @@ private:
 	string recDataPath;
 	string recOutputPcPath;
 	string recOutputPcTsPattern;
+	size_t pipelineQueueDepth = 2;
+	bool latestFrameWins = true; // Processing always takes the freshest frame, dropping stale ones
+	chrono::milliseconds controlLoopPeriod;
+	chrono::seconds traceDumpInterval;
+	
+	// Benchmark mode: headless, as-fast-as-possible playback of a recording
+	bool benchMode = false;
+	string benchRecordingPath;
+	// Evaluation mode: benchmark mode on rendered frames, scored against
+	// their true depth, once per algorithm profile
+	bool evalMode = false;
+	unsigned int evalFramesPerProfile = 0;
+	DepthEvaluator evaluator;
 	
 	// Private methods
 	void handleNewMessages();
+	void handleMessage(const Msg * rxd_msg);
+	void controlTick();
+	void handleLidar();
+	void startPipeline();
+	void stopPipeline();
+	void acquisitionStage();
+	void processingStage();
+	void outputStage();
+	void recordingStage();
 	void affineTransformPointCloud(PointCloudDataMessage * pc, affine3d transform);
 	void init(char * config_fn);
 	void enable();
@@ -66,25 +162,50 @@ private:
 	affine3d makeXform(double pitchDownRad, double downwardOffsetCm = 0, double forwardOffsetCm = 0, double rightwardOffsetCm = 0);
 	void saveOutputPcToFile(PointCloudMetadataMessage *md, PointCloudDataMessage * pc);
 	void summarizeBenchmarksToLog();
+	void dumpTrace();
+	void dumpTraceInBackground();
+	void writeTrace();
+	void printBenchReport(chrono::steady_clock::duration elapsed);
 	
 public:
 	int main(char * config_fn);
+	int bench(char * recording_path, char * config_fn);
+	int evaluate(char * config_fn);
 	PcgMain() : 
 		allBms(),
+		cloudPool      (&allBms, "Point cloud"),
+		durability     (&allBms),
+		frameScheduler (&allBms),
+		messaging      (&allBms),
 		img_acquisition(&allBms),
+		imageRecorder  (&allBms),
 		img_processing (&allBms),
 		lidar          (&allBms),
-		bmOneFrame ("Frame total"),
-		bmImageAcq ("Image acquisition"),
-		bmPcXform  ("Point cloud rotation"),
-		bmSaveFiles("Saving point cloud to disk"),
-		bmSyncFs   ("Synchronizing filesystem")
+		bmControlLoop("Control loop"),
+		bmImageAcq   ("Image acquisition stage"),
+		bmProcStage  ("Stereo processing stage"),
+		bmOutputStage("Transform and send stage"),
+		bmRecordStage("Recording stage"),
+		bmDroppedFrames("Stale frames dropped before processing"),
+		bmDroppedLidar ("LIDAR clouds dropped before output"),
+		bmSending    ("Sending point cloud"),
+		bmPcXform    ("Point cloud rotation"),
+		bmSaveFiles  ("Saving point cloud to disk"),
+		pipelineRunning(false),
+		playbackFinished(false),
+		controlLoopPeriod(10),
+		traceDumpInterval(0)
 	{
-		allBms.push_back(&bmOneFrame );
-		allBms.push_back(&bmImageAcq );
-		allBms.push_back(&bmPcXform  );
-		allBms.push_back(&bmSaveFiles);
-		allBms.push_back(&bmSyncFs   );
+		allBms.push_back(&bmControlLoop);
+		allBms.push_back(&bmImageAcq   );
+		allBms.push_back(&bmProcStage  );
+		allBms.push_back(&bmOutputStage);
+		allBms.push_back(&bmRecordStage);
+		allBms.push_back(&bmDroppedFrames);
+		allBms.push_back(&bmDroppedLidar );
+		allBms.push_back(&bmSending    );
+		allBms.push_back(&bmPcXform    );
+		allBms.push_back(&bmSaveFiles  );
 	}
 };
 
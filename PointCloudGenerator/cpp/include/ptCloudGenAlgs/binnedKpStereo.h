@@ -0,0 +1,124 @@
+/*
+	binnedKpStereo.h
+
+	The keypoint work shared by the CPU FAST-and-ORB algorithms.  FAST
+	keypoints are found in horizontal bands (bins) of each image, the
+	strongest kept in each bin and described with ORB, and each left
+	keypoint is matched against the right keypoints in its epipolar
+	window.  Matches that pass the ratio test and have enough disparity
+	become points.
+
+	Between describing and matching, an algorithm may move keypoints, eg.
+	from raw to rectified coordinates, and drop any it can't place.
+	Matching and triangulation use wherever the keypoints end up.
+
+	Each step fans out across the task pool, one task per image and bin.
+*/
+#ifndef __PCG_BINNEDKPSTEREO_H__
+#define __PCG_BINNEDKPSTEREO_H__
+
+#include <functional>
+#include "stereoPtCloudGenAlg.h"
+#include "epipolarMatcher.h"
+#include "fastDetector.h"
+
+class BinnedKpStereo {
+public:
+	static const unsigned int MAX_NUM_BINS = 128-1;
+	// Moves a keypoint of side 0 (left) or 1 (right).  False drops it.
+	typedef function<bool(int side, Point2f &pt)> KpMover;
+
+private:
+	// ORB's patches need this much image around each keypoint.  Keypoints
+	// are only found this far in from the edges, so ORB keeps them all,
+	// and bins are described with this many extra rows above and below.
+	static const int ORB_EDGE_PX = 31;
+
+	// Everything worked out for one image.  Kept between frames so the
+	// vectors and matrices keep their memory.
+	class ImageKps {
+	public:
+		Mat blurred;
+		FastDetector fastDets[MAX_NUM_BINS]; // One per bin, since each is used from its own task
+		vector<KeyPoint> binKps[MAX_NUM_BINS];
+		Mat binDesc[MAX_NUM_BINS];
+		// Keypoints & descriptors with common indices, in bin order.  Bin
+		// i's run from bin_bound_idx[i] up to bin_bound_idx[i + 1].
+		vector<KeyPoint> kp;
+		Mat desc;
+		unsigned int bin_bound_idx[MAX_NUM_BINS + 1];
+	};
+	ImageKps imgKps[2]; // Left, right
+	// Indexes the right keypoints, and matches each bin of left ones
+	EpipolarMatcher matcher;
+	vector<DMatch> binMatches[MAX_NUM_BINS];
+	vector<DMatch> matches;
+
+	list<const Benchmarker *> * bms;
+	Logger * logger = NULL;
+	TaskPool * taskPool = NULL;
+	Benchmarker bmBlurImage    ;
+	Benchmarker bmFindingKps   ;
+	Benchmarker bmComputingDesc;
+	Benchmarker bmMatchingKps  ;
+
+	// First row of bin, for an image of the given height.  Bin numBins
+	// starts just past the bottom.
+	int binStartRow(unsigned int bin, int rows) const { return (int)((long)bin * rows / numBins); }
+
+	// Per-image, per-bin steps.  side is 0 for left, 1 for right.
+	void findBinKps(int side, unsigned int bin);
+	void computeDesc(int side, unsigned int bin);
+	void moveBinKps(int side, unsigned int bin, const KpMover &mover);
+	void gatherBin(int side, unsigned int bin);
+	// Sets bin_bound_idx from the bins' keypoint counts, and sizes kp and
+	// desc to match, so each bin's task can fill in its own part
+	void layOutBins(int side);
+
+	// Algorithm parameters
+	int blurKernelSize;
+	int fastThreshold;
+	int orbMaxDescs;
+	unsigned int numBins;
+	double minImprovementFactor;
+	unsigned int minDisparityPx;
+	unsigned int maxDisparityPx;
+	unsigned int maxRowDiffPx;
+
+	// OpenCV processing objects.  One ORB per image and bin, since each
+	// is used from its own task.
+	Ptr<cv::ORB> orbAlgs[2][MAX_NUM_BINS];
+
+public:
+	BinnedKpStereo(list<const Benchmarker *> * _bms) :
+		bms(_bms),
+		bmBlurImage    ("Blurring image"),
+		bmFindingKps   ("Finding keypoints"),
+		bmComputingDesc("Computing descriptors"),
+		bmMatchingKps  ("Matching keypoints")
+	{
+		bms->push_back(&bmBlurImage    );
+		bms->push_back(&bmFindingKps   );
+		bms->push_back(&bmComputingDesc);
+		bms->push_back(&bmMatchingKps  );
+	}
+
+	// Reads the options in the algorithm's section of the configuration.
+	// section_name is only for error messages.
+	void init(json alg_section, string section_name, Logger * lgr, TaskPool * pool);
+
+	// Blurs both images, then finds and describes keypoints in each bin.
+	// Returns how many keypoints there are.
+	size_t findKps(const Mat &img_l, const Mat &img_r);
+	// Calls mover on every keypoint, from one task per image and bin
+	void moveKps(const KpMover &mover);
+	// Matches the keypoints, keeping at most max_matches
+	void matchKps(size_t max_matches);
+
+	size_t getNumMatches() const { return matches.size(); }
+	// Sets points[i] from match i, given the projection of the image the
+	// keypoints are in
+	void triangulate(CloudPoint * points, double tri_const, double focal_len_px, double cx, double cy) const;
+};
+
+#endif // __PCG_BINNEDKPSTEREO_H__
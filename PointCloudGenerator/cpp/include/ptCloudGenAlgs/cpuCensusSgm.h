@@ -0,0 +1,95 @@
+/*
+	cpuCensusSgm.h
+
+	Dense stereo by semi-global matching on census-transformed images, for
+	a point on every textured patch rather than just at corners.  Uses the
+	rectified images, optionally downsampled first.
+
+	Matching costs are the Hamming distances between 5x5 census codes.
+	They're aggregated along five paths: left to right, right to left,
+	down, and down both diagonals, so that each row needs only the row
+	above it.  The image is split into row stripes, one task each; a
+	stripe starts its paths a few rows above its first row, so they've
+	settled by the time its own rows come round.  Aggregation works on 8
+	disparities at a time with SSE2 or NEON.
+*/
+#ifndef __PCG_CPUCENSUSSGM_H__
+#define __PCG_CPUCENSUSSGM_H__
+
+#include <stdint.h>
+#include "stereoPtCloudGenAlg.h"
+#include "cpuPreUndistortAlg.h"
+
+class CpuCensusSgm : public CpuPreUndistortAlg {
+private:
+	static const int CENSUS_RADIUS = 2; // 5x5 window
+	static const int MAX_COST = 24;     // Bits in a census code
+	static const int MAX_P2 = 4000;     // Keeps every sum of paths within int16_t
+	static const int DISP_ALIGN = 8;    // Disparities are aggregated this many at a time
+
+	// Working memory for one stripe, kept between frames
+	class Stripe {
+	public:
+		vector<int16_t> cost;          // Per pixel of the row, numDisparities costs
+		vector<int16_t> sum;           // Same layout, summed over paths
+		// Per pixel, numDisparities + 2 values: a guard, the path costs,
+		// and a guard.  Three paths from the row above, previous and current.
+		vector<int16_t> pathPrev[3], pathCur[3];
+		vector<int16_t> minPrev[3], minCur[3];
+		vector<int16_t> horizPrev, horizCur; // For the two paths along the row
+		vector<int16_t> pathStart;           // What a path starting at this pixel follows
+	};
+	vector<Stripe> stripes;
+
+	Mat imgL, imgR;         // Rectified, then downsampled
+	Mat censusL, censusR;   // CV_32SC1
+	Mat disparity;          // CV_32FC1, in downsampled pixels; negative where unmatched
+
+	void censusTransform(const Mat &img, Mat &census, int first_row, int last_row);
+	void prepareStripe(Stripe &stripe);
+	// Matches rows [first_row, last_row), aggregating from warm_row
+	void matchStripe(Stripe &stripe, int warm_row, int first_row, int last_row);
+	void computeCostRow(Stripe &stripe, int y);
+	void chooseDisparities(const Stripe &stripe, int y);
+	void computeStereoPtCloud();
+
+protected:
+	// Member data
+	Benchmarker bmDownsampling  ;
+	Benchmarker bmCensus        ;
+	Benchmarker bmAggregating   ;
+	Benchmarker bmComputingDepths;
+
+public:
+	CpuCensusSgm(list<const Benchmarker *> * _bms) :
+		CpuPreUndistortAlg(_bms),
+		bmDownsampling   ("Downsampling images"),
+		bmCensus         ("Census transform"),
+		bmAggregating    ("SGM matching and aggregation"),
+		bmComputingDepths("Computing depths")
+	{
+		bms->push_back(&bmDownsampling   );
+		bms->push_back(&bmCensus         );
+		bms->push_back(&bmAggregating    );
+		bms->push_back(&bmComputingDepths);
+	}
+	virtual void init(json options, Logger * lgr, StereoCal calData);
+	virtual void processImages(ImageDataSet imgData);
+private:
+
+	// Algorithm parameters
+	int downsample;
+	int minDisparityPx;
+	int numDisparities;
+	int p1, p2;
+	int uniquenessPct;
+	unsigned int numStripes;
+	int stripeOverlapRows;
+	int pointStridePx;
+	unsigned int maxPoints;
+
+	// From the left projection matrix, for turning disparities into points
+	double focalLenPx, cx, cy;
+};
+
+#endif // __PCG_CPUCENSUSSGM_H__
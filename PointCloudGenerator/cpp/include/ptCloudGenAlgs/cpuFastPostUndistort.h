@@ -0,0 +1,52 @@
+/*
+	cpuFastPostUndistort.h
+
+	CpuFastWithBinnedKps without undistorting the images: FAST keypoints
+	are found in bins of each image as it arrives, kept strongest-first
+	per bin and described with ORB there.  Only then are the keypoints
+	moved to rectified coordinates, where each left one is matched against
+	the right keypoints in its epipolar window.  Keypoints that land
+	outside the rectified image are dropped.
+
+	Saves remapping both whole images every frame.  Descriptors come from
+	distorted patches, which differ a little between the cameras away
+	from the image centres; with moderate lens distortion ORB doesn't
+	notice.
+	Uses CPU.
+*/
+#ifndef __PCG_CPUFASTPOSTUNDISTORT_H__
+#define __PCG_CPUFASTPOSTUNDISTORT_H__
+
+#include "stereoPtCloudGenAlg.h"
+#include "postUndistortAlg.h"
+#include "binnedKpStereo.h"
+
+class CpuFastPostUndistort : public PostUndistortAlg {
+private:
+	BinnedKpStereo kps;
+
+	// Helper function - the core of this particular algorithm.
+	// Works on member data, specifically imgL, imgR
+	void computeStereoPtClouds();
+
+protected:
+	// Member data
+	Benchmarker bmComputingDepths ;
+
+public:
+	CpuFastPostUndistort(list<const Benchmarker *> * _bms) :
+		PostUndistortAlg(_bms),
+		kps(_bms),
+		bmComputingDepths ("Computing depths")
+	{
+		bms->push_back(&bmComputingDepths );
+	}
+	virtual void init(json options, Logger * lgr, StereoCal calData);
+	virtual void processImages(ImageDataSet imgData);
+private:
+
+	// From the left projection matrix, for turning matches into points
+	double focalLenPx, cx, cy;
+};
+
+#endif // __PCG_CPUFASTPOSTUNDISTORT_H__
@@ -0,0 +1,49 @@
+/*
+	cpuFastWithBinnedKps.h
+
+	Finds FAST keypoints in horizontal bands (bins) of each rectified image,
+	keeps the strongest in each bin, describes them with ORB, and matches
+	each left keypoint against the right keypoints in its epipolar window.
+	Matches that pass the ratio test and have enough disparity become
+	points.  The keypoint work is in BinnedKpStereo.
+
+	Each step fans out across the task pool, one task per image and bin,
+	so this keeps up on machines with no GPU.
+	Uses CPU.
+*/
+#ifndef __PCG_CPUFASTWITHBINNEDKPS_H__
+#define __PCG_CPUFASTWITHBINNEDKPS_H__
+
+#include "stereoPtCloudGenAlg.h"
+#include "cpuPreUndistortAlg.h"
+#include "binnedKpStereo.h"
+
+class CpuFastWithBinnedKps : public CpuPreUndistortAlg {
+private:
+	BinnedKpStereo kps;
+
+	// Helper function - the core of this particular algorithm.
+	// Works on member data, specifically imgLRect, imgRRect
+	void computeStereoPtClouds();
+
+protected:
+	// Member data
+	Benchmarker bmComputingDepths ;
+
+public:
+	CpuFastWithBinnedKps(list<const Benchmarker *> * _bms) :
+		CpuPreUndistortAlg(_bms),
+		kps(_bms),
+		bmComputingDepths ("Computing depths")
+	{
+		bms->push_back(&bmComputingDepths );
+	}
+	virtual void init(json options, Logger * lgr, StereoCal calData);
+	virtual void processImages(ImageDataSet imgData);
+private:
+
+	// From the left projection matrix, for turning matches into points
+	double focalLenPx, cx, cy;
+};
+
+#endif // __PCG_CPUFASTWITHBINNEDKPS_H__
@@ -0,0 +1,62 @@
+/*
+	epipolarMatcher.h
+
+	Matches ORB descriptors between rectified images.  A feature's match
+	can only lie within a row or two of it, and to its left by between the
+	minimum and maximum disparity, so the right image's keypoints are
+	indexed by row band and sorted by column, and each left keypoint is
+	compared only against that window.  The ratio test and the disparity
+	limits are applied as each match is found.
+
+	Hamming distances use NEON on ARM, and POPCNT on x86 whenever the CPU
+	has it, whether or not the build targets it.
+
+	setTrain() isn't thread-safe; match() is, and is meant to be fanned
+	out across ranges of left keypoints.
+*/
+#ifndef __PCG_EPIPOLARMATCHER_H__
+#define __PCG_EPIPOLARMATCHER_H__
+
+#include <stdint.h>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+using namespace std;
+
+class EpipolarMatcher {
+public:
+	static const int DESC_BYTES = 32; // 256-bit ORB descriptors
+
+private:
+	int maxRowDiffPx = 1;
+	float minDisparityPx = 0;
+	float maxDisparityPx = 0; // 0 for no limit
+	double minImprovementFactor = 1;
+
+	// The right image's keypoints, by band of bandRows rows and then by
+	// column.  Band b's run from bandStart[b] to bandStart[b + 1].
+	vector<unsigned int> bandStart;
+	vector<float> trainX, trainY;
+	vector<int> trainIdx;            // Into the keypoints given to setTrain()
+	vector<uint8_t> trainDesc;       // DESC_BYTES each, in the same order
+	int bandRows = 1;
+
+public:
+	// Throws if the limits make no sense
+	void init(int max_row_diff_px, double min_disparity_px, double max_disparity_px,
+		double min_improvement_factor);
+
+	// Indexes the right image's keypoints.  desc holds one row of
+	// DESC_BYTES per keypoint.  Throws for other descriptor sizes.
+	void setTrain(const vector<cv::KeyPoint> &kps, const cv::Mat &desc);
+
+	// Appends the best match, if any passes, for each left keypoint in
+	// [begin, end).  queryIdx and trainIdx index the keypoints given here
+	// and to setTrain().
+	void match(const vector<cv::KeyPoint> &kps, const cv::Mat &desc,
+		size_t begin, size_t end, vector<cv::DMatch> &matches) const;
+
+	static int hamming(const uint8_t * a, const uint8_t * b);
+};
+
+#endif // __PCG_EPIPOLARMATCHER_H__
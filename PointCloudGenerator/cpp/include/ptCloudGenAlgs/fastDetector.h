@@ -0,0 +1,62 @@
+/*
+	fastDetector.h
+
+	FAST-9 corner detection with non-max suppression, for 8-bit images.
+	A pixel is a corner if 9 contiguous pixels of the 16 on the circle of
+	radius 3 around it are all brighter than it by more than the
+	threshold, or all darker.  Its score is the largest threshold at which
+	it would still be one.  Corners whose score doesn't beat all eight of
+	their neighbours' are suppressed.
+
+	The corner test runs 32 pixels at a time with AVX2, or 16 with SSE2 or
+	NEON, whichever the compiler targets.  Those kernels and the scalar
+	version, which handles row ends and is the reference, use the same
+	run-counting method, so they agree bit for bit.  Scores are only
+	computed for corners, in scalar code.
+
+	Works on a band of rows at a time, so each bin of an image can be
+	detected on its own task.  One FastDetector per task; it keeps its
+	row buffers between calls.
+*/
+#ifndef __PCG_FASTDETECTOR_H__
+#define __PCG_FASTDETECTOR_H__
+
+#include <stdint.h>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+using namespace std;
+
+class FastDetector {
+public:
+	static const int CIRCLE_SIZE = 16;
+	static const int ARC_LENGTH  = 9;
+	static const int RADIUS      = 3;
+
+	// Finds corners in rows [first_row, last_row) of img, at least border
+	// pixels from each edge, and appends them to kps with their scores as
+	// responses.  Suppression looks at the rows just outside the band too,
+	// so bands detected separately give the same corners as the whole.
+	void detect(const cv::Mat &img, int first_row, int last_row, int threshold, int border,
+		vector<cv::KeyPoint> &kps);
+
+	// Sets mask[x] to 0xFF for each corner in [x_begin, x_end) of a row,
+	// and 0 elsewhere.  row points at the row's first pixel; the caller
+	// keeps x RADIUS pixels clear of every edge.
+	static void markCorners(const uint8_t * row, int step, int x_begin, int x_end,
+		int threshold, uint8_t * mask);
+	// The scalar reference for the above, one pixel at a time
+	static bool isCorner(const uint8_t * p, const int (&offsets)[CIRCLE_SIZE], int threshold);
+	static int cornerScore(const uint8_t * p, const int (&offsets)[CIRCLE_SIZE]);
+	// Offsets of the circle's pixels, clockwise from straight up
+	static void circleOffsets(int step, int (&offsets)[CIRCLE_SIZE]);
+
+private:
+	// Per row: the corner mask, and a score for every pixel (0 for
+	// non-corners), for the three rows suppression needs at once
+	vector<uint8_t> mask;
+	vector<uint8_t> scores[3];
+	vector<int> corners[3]; // Columns of each row's corners
+};
+
+#endif // __PCG_FASTDETECTOR_H__
@@ -1,8 +1,16 @@
 /*
 	postUndistortAlg.h
-	
-	Parent class of algorithms that undistort after processing
-	
+
+	Parent class of algorithms that undistort after processing.  They
+	work on the images as they arrive, and only the points they find are
+	undistorted and rectified, rather than both whole images.
+
+	Points are rectified through a lookup table, built once from the
+	calibration: the rectified position of every LUT_STEP_PX'th input
+	pixel each way, interpolated between.  Distortion varies slowly
+	enough across a few pixels that this matches cv::undistortPoints()
+	to well under a pixel, at a fraction of the cost.
+
 	2018-1-5  JDW  Created.
 */
 #ifndef __PCG_POSTUNDISTORTALG_H__
@@ -11,10 +19,43 @@
 #include "stereoPtCloudGenAlg.h"
 
 class PostUndistortAlg : public StereoPtCloudGenAlg {
+private:
+	static const int LUT_STEP_PX = 4;
+
+	// Per side, CV_32FC2: entry (row, col) is where input pixel
+	// (col * LUT_STEP_PX, row * LUT_STEP_PX) lands in the rectified image.
+	// Reaches at least one step past the input's last row and column.
+	Mat rectifyLuts[2];
+	Size rectSize;
+	// Set for frames that arrive already rectified, eg. rendered ones
+	bool imgsRectified = false;
+
+	void buildRectifyLut(int side);
+
 protected:
-	// TODO
+	// Input images, flipped upright if the calibration expects that to be
+	// done as part of rectification, but otherwise as they arrived
+	Mat imgL, imgR;
+
+	// Member data
+	Benchmarker bmFlippingImages;
+	Benchmarker bmUndistortKps; // For subclasses, around their calls to rectifyPoint()
+
+	// Moves pt from imgL or imgR (side 0 or 1) to rectified coordinates.
+	// False if it lands outside the rectified image.  Safe to call from
+	// any number of tasks at once.
+	bool rectifyPoint(int side, Point2f &pt) const;
+
 public:
-	PostUndistortAlg(list<const Benchmarker *> * _bms) : StereoPtCloudGenAlg(_bms) { ; }
+	PostUndistortAlg(list<const Benchmarker *> * _bms) :
+		StereoPtCloudGenAlg(_bms),
+		bmFlippingImages("Flipping images upright"),
+		bmUndistortKps  ("Undistort keypoints")
+	{
+		bms->push_back(&bmFlippingImages);
+		bms->push_back(&bmUndistortKps  );
+	}
+	virtual void init(json options, Logger * lgr, StereoCal calData);
 	virtual void processImages(ImageDataSet imgData);
 };
 #endif // __PCG_POSTUNDISTORTALG_H__
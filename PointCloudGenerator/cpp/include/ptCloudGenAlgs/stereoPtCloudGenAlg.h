@@ -24,6 +24,8 @@
 #include "imageAcquisition.h"
 #include "stereoCal.h"
 #include "benchmarker.h"
+#include "taskPool.h"
+#include "msgBufferPool.h"
 using namespace cv;
 using namespace cuda;
 using json = nlohmann::json;
@@ -40,19 +42,38 @@ protected:
 	
 	bool cvWindowsAreOpen = false;
 	
-	// The results of the most recent processing.
-	// This class is responsible for delet[]ion prior to each write.
+	// The results of the most recent processing.  msg points into
+	// msgBuffer, which goes back to the pool on clearPointCloud().
 	PointCloudDataMessage * msg = NULL;
+	MsgBufferPool::Buffer msgBuffer;
 	bool pointCloudValid = false;
 	
 	Benchmarker bmShowingImages;
 	Benchmarker bmClearingPtCloud;
 	
 	void clearPointCloud();
+	// Clears the point cloud, then sets msg to an empty message with room
+	// for max_points, taken from the pool.  Leaves msg NULL if the pool
+	// is exhausted, or max_points is more than maxPointsPerMsg(), in which
+	// case this frame's cloud should be skipped.
+	PointCloudDataMessage * allocatePointCloud(unsigned int max_points);
+	// Most points one message can hold, given the pool's buffer size and
+	// the message's 16-bit length
+	static unsigned int maxPointsPerMsg();
+	
+	// Worker threads shared by all algorithms.  Use them to fan out
+	// per-image and per-bin work.
+	static TaskPool * taskPool;
+	// Where point cloud messages come from
+	static MsgBufferPool * msgPool;
 	
 	// Commonly-useful processing steps
 	// void 
 public:
+	// Must be called before init()
+	static void setTaskPool(TaskPool * pool) { taskPool = pool; }
+	static void setMsgPool(MsgBufferPool * pool) { msgPool = pool; }
+
 	virtual void init(json options, Logger * lgr, StereoCal calData);
 	
 	// Processes a set of raw input images and stores a point
@@ -66,9 +87,14 @@ public:
 	bool areCvWindowsOpen() { return cvWindowsAreOpen; }
 	
 	// It's more efficient for this class to generate the message.
-	// This class will be responsible for delet[]ion; the caller should not delete[].
+	// This class keeps ownership; the pointer is good until the next frame.
 	PointCloudDataMessage * getPointCloud() { return pointCloudValid? msg : NULL;  }
 	bool isPointCloudAvailable() { return pointCloudValid; }
+	// Gives the caller a pooled buffer holding the point cloud.  When the
+	// pool is double-buffered, that's our own buffer, and the next cloud
+	// is built in a new one; otherwise it's a copy.  Empty if there's no
+	// cloud, or the pool is exhausted.
+	MsgBufferPool::Buffer takePointCloud();
 	// Direct this class to delete internal resources,
 	// but not de-initialize.  After this function is called,
 	// the object should remain ready to have processImages() called.
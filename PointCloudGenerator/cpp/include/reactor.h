@@ -0,0 +1,56 @@
+/*
+	reactor.h
+
+	Minimal epoll-based event loop.  File descriptors are registered with a
+	handler, which is called from runOnce() whenever the descriptor is
+	readable.  Also wraps eventfd and timerfd, so that other threads and
+	periodic work can wake the loop the same way a socket does.
+*/
+
+#ifndef __PCG_REACTOR_H__
+#define __PCG_REACTOR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <functional>
+#include <chrono> // C++11
+using namespace std;
+
+class Reactor {
+public:
+	typedef function<void()> Handler;
+
+private:
+	static const int MAX_EVENTS_PER_WAIT = 16;
+	int epollFd = -1;
+	map<int, Handler> handlers;
+
+public:
+	~Reactor();
+	// Throws runtime_error on failure, like the rest of our socket setup
+	void init();
+
+	// Call handler whenever fd becomes readable.  The handler must consume
+	// what's there, or it will be called again straight away.
+	void addSource(int fd, Handler handler);
+	void removeSource(int fd);
+
+	// Waits for at most timeout, then runs the handlers of every ready
+	// source.  A negative timeout waits indefinitely.
+	// Returns the number of handlers run.
+	int runOnce(chrono::milliseconds timeout);
+
+	// An eventfd lets any thread (even a driver callback) wake the loop.
+	static int makeEventFd();
+	static void signalEventFd(int fd);
+	// A timerfd becomes readable every period once armed.
+	// A zero period disarms it.
+	static int makeTimerFd();
+	static void setTimerPeriod(int fd, chrono::milliseconds period);
+	// Reads and returns the counter of an eventfd or timerfd, resetting it.
+	// Returns 0 if it wasn't signalled.
+	static uint64_t drain(int fd);
+};
+
+#endif // __PCG_REACTOR_H__
@@ -10,6 +10,7 @@
 #define __PCG_STERCAL_H__
 
 #include "json.hpp"
+#include "ingestWindow.h"
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/cuda.hpp>
 using namespace cv;
@@ -32,6 +33,16 @@ private:
 	double baselineCm;
 	double triangulationConst;
 	
+	// Set when input images come straight off the sensors unflipped.  The
+	// maps then flip them as part of rectification.
+	bool flipImgL = false, flipImgR = false;
+	int imgFlipCodeL = 0, imgFlipCodeR = 0; // As for cv::flip
+	
+	// Input images are cropped and binned to this.  The projection
+	// matrices, maps and triangulation constant are all for the smaller
+	// images; imageWidth and imageHeight stay at the sensors' size.
+	IngestWindow ingest;
+	
 	// Loaded from file - computed with:
 	// https://code.crearecomputing.com/LaserMetrology/LaserMetrologyCommon/blob/develop/PythonCommon/laser_metrology_toolbox/laser_metrology_toolbox/calibration/examples/stereo_example2.py
 	// It would be cleaner to use arrays of matrices, but the default constructors
@@ -58,6 +69,20 @@ private:
 	// into an OpenCV matrix.  Takes dimensions from the OpenCV matrix
 	// and will throw an exception if the JSON matrix lacks sufficient elements.
 	void loadInto(Mat_<double> &cvMat, json jsonMat);
+	// Changes a pair of CV_32FC1 maps, which expect flipped images, to
+	// expect the unflipped image instead.
+	void foldFlipIntoMaps(Mat (&maps)[2], int flip_code);
+	// Scales a projection matrix from full-resolution rectified
+	// coordinates to those of the ingest window's output
+	void ingestProjection(Mat_<double> &P);
+	// Changes a pair of maps, which sample full-resolution images, to
+	// sample images cropped to input_rect and binned
+	void ingestMaps(Mat (&maps)[2], Rect input_rect);
+	// Takes points in an upright input image, cropped and binned by the
+	// ingest window, to rectified coordinates
+	void rectifyPoints(const vector<Point2f> &in, vector<Point2f> &out,
+		const Mat_<double> &cam_matrix, const Mat_<double> &dist_coeffs,
+		const Mat_<double> &rect, const Mat_<double> &proj);
 
 public:
 	StereoCal() :
@@ -79,6 +104,27 @@ public:
 	               Mat  getCpuProjectionMatrixLeft () { return (               Mat )P1; }
 	               Mat  getCpuProjectionMatrixRight() { return (               Mat )P2; }
 	const double getTriangulationConst() { return triangulationConst; }
+	// Size of rectified images, after any crop and binning
+	Size getImageSize() { return ingest.getOutputSize(Size(imageWidth, imageHeight)); }
+	// Size of images handed in for rectification
+	Size getInputSize() { return ingest.getInputSize(Size(imageWidth, imageHeight)); }
+	// Fitted to the maps, so image acquisition should crop with this one
+	const IngestWindow & getIngestWindow() { return ingest; }
+	// Whether the maps expect unflipped images, and the flip they undo.
+	// Anything mapping raw image coordinates by hand needs these too.
+	bool isFlipFoldedLeft () { return flipImgL; }
+	bool isFlipFoldedRight() { return flipImgR; }
+	int  getFlipCodeLeft  () { return imgFlipCodeL; }
+	int  getFlipCodeRight () { return imgFlipCodeR; }
+	// Where points in the input images land in the rectified images, for
+	// algorithms that undistort keypoints rather than whole images.  The
+	// input images must be upright: flip them first if isFlipFolded*().
+	void rectifyPointsLeft (const vector<Point2f> &in, vector<Point2f> &out) {
+		rectifyPoints(in, out, leftCamMatrix,  leftDistCoeffs,  R1, P1);
+	}
+	void rectifyPointsRight(const vector<Point2f> &in, vector<Point2f> &out) {
+		rectifyPoints(in, out, rightCamMatrix, rightDistCoeffs, R2, P2);
+	}
 	void init(json options);
 };
 
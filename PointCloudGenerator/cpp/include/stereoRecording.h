@@ -0,0 +1,175 @@
+/*
+	stereoRecording.h
+
+	Single-file container for recorded stereo frames.  Every frame is a
+	fixed-size record holding its timestamp, validity flags, auto gain
+	values and both raw 8-bit images, so frame N is always at the same
+	offset.  Records are only ever appended; an index of timestamps is
+	written as a footer when the recording is closed.  A recording that
+	was never closed, say because power was cut, is still readable: the
+	index is rebuilt from the record headers.
+
+	Layout, with integers in host (little-endian) byte order:
+		FileHeader                 FILE_HEADER_BYTES
+		Record 0 .. N-1            recordBytes each
+			RecordHeader           RECORD_HEADER_BYTES
+			Left image             imageBytes, padded to a page
+			Right image            imageBytes, padded to a page
+		IndexEntry 0 .. N-1
+		Footer
+*/
+
+#ifndef __PCG_STEREORECORDING_H__
+#define __PCG_STEREORECORDING_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono> // C++11
+
+#include <opencv2/core/core.hpp>
+
+#include "logger.h"
+using namespace std;
+
+// One frame, as stored in a recording
+class StereoRecordingFrame {
+public:
+	chrono::time_point<chrono::system_clock> acquisitionTime;
+	uint64_t frameId = 0;
+	bool validL = false, validR = false;
+	cv::Mat imgL, imgR; // 8-bit, single channel
+	string autoGainValues;
+};
+
+class StereoRecording {
+public:
+	static const char     FILE_MAGIC[8];
+	static const char     FOOTER_MAGIC[8];
+	static const uint32_t RECORD_MAGIC      = 0x4d415246; // "FRAM"
+	static const uint32_t VERSION           = 1;
+	static const size_t   FILE_HEADER_BYTES   = 4096;
+	static const size_t   RECORD_HEADER_BYTES = 4096;
+	static const size_t   AGC_BYTES           = 232;
+
+	// Record flags
+	static const uint32_t FLAG_VALID_L = 1 << 0;
+	static const uint32_t FLAG_VALID_R = 1 << 1;
+
+	struct FileHeader {
+		char     magic[8];
+		uint32_t version;
+		uint32_t width, height;
+		uint32_t imageBytes;      // Of each image, before padding
+		uint64_t recordBytes;
+		uint64_t recordHeaderBytes;
+		uint64_t fileHeaderBytes;
+	};
+	struct RecordHeader {
+		uint32_t magic;
+		uint32_t flags;
+		int64_t  timeUs;          // Since the epoch
+		uint64_t frameId;
+		char     autoGainValues[AGC_BYTES]; // Null terminated, truncated if need be
+	};
+	struct IndexEntry {
+		int64_t  timeUs;
+		uint32_t flags;
+		uint32_t reserved;
+	};
+	struct Footer {
+		char     magic[8];
+		uint64_t numRecords;
+		uint64_t indexOffset;
+	};
+
+	// Bytes taken by each record in a recording of images this size
+	static uint64_t recordBytesFor(uint32_t width, uint32_t height);
+	static int64_t toTimeUs(chrono::time_point<chrono::system_clock> t);
+	static chrono::time_point<chrono::system_clock> fromTimeUs(int64_t us);
+};
+
+class StereoRecordingWriter {
+private:
+	Logger * logger = NULL;
+	string path;
+	int fd = -1;
+	StereoRecording::FileHeader header;
+	vector<StereoRecording::IndexEntry> index;
+	vector<char> zeros; // Padding, and the stand-in for missing images
+
+	bool writeAll(const char * buf, size_t bytes);
+
+public:
+	~StereoRecordingWriter() { close(); }
+
+	// Creates the file and writes its header.  Every frame appended
+	// afterwards must have images of this size.  True for success.
+	bool open(string _path, uint32_t width, uint32_t height, Logger * lgr);
+	bool isOpen() const { return fd >= 0; }
+	// Images that aren't 8-bit, single channel and the recording's size
+	// are stored as invalid.  True for success.
+	bool append(const StereoRecordingFrame &frame);
+	// Writes the index and footer
+	void close();
+
+	size_t getNumFrames() const { return index.size(); }
+};
+
+class StereoRecordingReader {
+private:
+	Logger * logger = NULL;
+	string path;
+	int fd = -1;
+	StereoRecording::FileHeader header;
+	vector<StereoRecording::IndexEntry> index;
+
+	// The whole file, mapped read-only, if mapping it worked
+	const char * mapping = NULL;
+	size_t mappingBytes = 0;
+	size_t readAheadFrames = 0;
+
+	// For seeking by time.  Bucket k holds the first frame at or after
+	// firstTimeUs + k * bucketUs; buckets are about a frame apart, so a
+	// lookup only ever steps over a frame or two.
+	vector<size_t> buckets;
+	int64_t bucketUs = 1;
+
+	bool readAt(char * buf, size_t bytes, uint64_t offset);
+	bool readFooterIndex(uint64_t file_bytes);
+	void rebuildIndex(uint64_t file_bytes);
+	void buildBuckets();
+	void mapFile(uint64_t file_bytes);
+
+public:
+	~StereoRecordingReader() { close(); }
+
+	// True if the file at path starts like a recording
+	static bool isRecording(string path);
+
+	// True for success
+	bool open(string _path, Logger * lgr);
+	bool isOpen() const { return fd >= 0; }
+	bool isMapped() const { return mapping != NULL; }
+	// Invalidates the images of every frame read while mapped
+	void close();
+
+	// How many frames past the one being read to ask the kernel to fetch
+	void setReadAhead(size_t frames) { readAheadFrames = frames; }
+
+	size_t getNumFrames() const { return index.size(); }
+	uint32_t getWidth()  const { return header.width;  }
+	uint32_t getHeight() const { return header.height; }
+	chrono::time_point<chrono::system_clock> getFrameTime(size_t i) const;
+	// The last frame recorded at or before t, or the first frame if t
+	// comes before all of them.  Constant time, as long as the
+	// recording's clock never stepped backwards.
+	size_t findFrame(chrono::time_point<chrono::system_clock> t) const;
+
+	// Reads frame i.  While mapped, the images point straight into the
+	// mapping: they're read-only, and only good until close().
+	// Otherwise they're freshly allocated.  True for success.
+	bool readFrame(size_t i, StereoRecordingFrame &frame);
+};
+
+#endif // __PCG_STEREORECORDING_H__
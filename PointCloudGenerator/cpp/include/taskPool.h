@@ -0,0 +1,125 @@
+/*
+	taskPool.h
+
+	Work-stealing pool of worker threads, for splitting the CPU side of the
+	stereo algorithms across cores.  Each worker has its own deque; it runs
+	its own newest task first, and when it runs dry it steals the oldest
+	task from another worker.  Threads waiting on a TaskGroup run queued
+	tasks too, so nested parallelism can't deadlock, and only sleep once
+	there are none left to run.
+*/
+
+#ifndef __PCG_TASKPOOL_H__
+#define __PCG_TASKPOOL_H__
+
+#include <stdio.h>
+#include <list>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <chrono> // C++11
+
+#include "benchmarker.h"
+#include "frameTracer.h"
+using namespace std;
+
+class TaskPool {
+public:
+	typedef function<void()> Task;
+
+	// A set of tasks that can be waited on together
+	class TaskGroup {
+		friend class TaskPool;
+	private:
+		atomic<int> pending;
+		mutex doneLock;          // Held while pending is decremented
+		condition_variable done; // Signalled when pending reaches 0
+		mutex errorLock;
+		exception_ptr error; // First exception thrown by a task, rethrown by wait()
+	public:
+		TaskGroup() : pending(0) { ; }
+		// True once every task submitted so far has finished
+		bool isDone() const { return pending == 0; }
+	};
+
+private:
+	class Job {
+	public:
+		Task task;
+		TaskGroup * group;
+		unsigned long frameId; // Carried over from the submitting thread, for tracing
+	};
+
+	class Worker {
+	public:
+		mutex lock;
+		deque<Job> jobs;
+		thread th;
+		atomic<long long> busyNs;
+		atomic<long long> idleNs;
+		atomic<int> tasksRun;
+		Worker() : busyNs(0), idleNs(0), tasksRun(0) { ; }
+	};
+
+	list<const Benchmarker *> * bms;
+	Benchmarker bmBusy;
+	Benchmarker bmIdle;
+
+	vector<unique_ptr<Worker>> workers;
+	atomic<unsigned int> nextWorker;
+	atomic<int> queuedJobs;
+	mutex sleepLock;
+	condition_variable wake;
+	bool stopping = false;
+
+	// Totals as of the last publishStats()
+	long long publishedBusyNs = 0;
+	long long publishedIdleNs = 0;
+	int publishedTasksRun = 0;
+	mutex statsLock;
+
+	void workerLoop(int self);
+	// Runs one job, from our own deque if we have one, or stolen otherwise.
+	// self is -1 for threads outside the pool.  Returns false if there was
+	// nothing to run.
+	bool runOne(int self);
+	void runJob(Job &job);
+	int getSelfIndex();
+
+public:
+	TaskPool(list<const Benchmarker *> * _bms, string name = "Task pool") :
+		bms(_bms),
+		bmBusy(name + " busy time (all workers)"),
+		bmIdle(name + " idle time (all workers)"),
+		nextWorker(0),
+		queuedJobs(0)
+	{
+		bms->push_back(&bmBusy);
+		bms->push_back(&bmIdle);
+	}
+	~TaskPool() { stop(); }
+
+	// Starts num_threads workers.  With zero, tasks run inline on submit().
+	void init(unsigned int num_threads);
+	void stop();
+	unsigned int getNumThreads() const { return workers.size(); }
+
+	void submit(TaskGroup &group, Task task);
+	// Runs queued tasks until every task in the group has finished.
+	// Rethrows the first exception any of them threw.
+	void wait(TaskGroup &group);
+	// Calls fn(i) for each i in [begin, end), in parallel, and waits.
+	void parallelFor(int begin, int end, function<void(int)> fn);
+
+	// Adds worker busy and idle time since the last call to the benchmark
+	// summary.  Call from one thread at a time, eg. once per frame.
+	void publishStats();
+};
+
+#endif // __PCG_TASKPOOL_H__
@@ -17,7 +17,7 @@ const int AttitudeTracker::MAG_AXIS_SIGN_FOR_ACCEL_AXIS[3] = {1, 1, -1};
 const char AttitudeTracker::TIMESTAMP_FMT[] = "%Y-%m-%d %H:%M:%S";
 
 
-void AttitudeTracker::init(json options, Logger * lgr) {
+void AttitudeTracker::init(json options, Logger * lgr, Durability * dur) {
 	logger = lgr;
 	imu.init(logger);
 	
@@ -55,6 +55,7 @@ void AttitudeTracker::init(json options, Logger * lgr) {
 			<<  "\"Roll Rate (deg/s)\",\"Pitch Rate (deg/s)\",\"Yaw Rate (deg/s)\","
 			<<  "\"Raw mag 0\",\"Raw mag 1\",\"Raw mag 2\","
 			<< endl;
+		dur->trackAppendedFile(data_path + filename);
 	}
 	
 }
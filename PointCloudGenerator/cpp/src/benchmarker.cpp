@@ -7,16 +7,25 @@
 	2017-03-02  JDW  Moved into its own file.
 */
 #include <benchmarker.h>
+#include <algorithm>
 using namespace std;
 using namespace chrono;
 
+bool Benchmarker::keepSamples = false;
+
 void Benchmarker::start() {
 	startTime = steady_clock::now();
+	lock_guard<mutex> lk(lock);
+	timed = true;
 }
 
 void Benchmarker::pause(int items_processed) {
-	steady_clock::duration elapsed = (steady_clock::now() - startTime);
+	steady_clock::time_point now = steady_clock::now();
+	FrameTracer::record(name.c_str(), startTime, now);
+	steady_clock::duration elapsed = (now - startTime);
+	lock_guard<mutex> lk(lock);
 	totalDuration += elapsed;
+	iterationDuration += elapsed;
 	numItemsProcessed += items_processed;
 }
 void Benchmarker::resume() {
@@ -30,14 +39,62 @@ void Benchmarker::end(int items_processed) {
 	conclude(); // End of this iteration
 }
 
+void Benchmarker::count(int items_processed) {
+	lock_guard<mutex> lk(lock);
+	numItemsProcessed += items_processed;
+	concludeLocked();
+}
+
+void Benchmarker::add(steady_clock::duration elapsed, int items_processed) {
+	lock_guard<mutex> lk(lock);
+	timed = true;
+	totalDuration += elapsed;
+	iterationDuration += elapsed;
+	numItemsProcessed += items_processed;
+	concludeLocked();
+}
+
+void Benchmarker::reset() {
+	lock_guard<mutex> lk(lock);
+	totalDuration = iterationDuration = lastDuration = steady_clock::duration(0);
+	numTimesRun = 0;
+	numItemsProcessed = 0;
+	timed = false;
+	samples.clear();
+}
+
 void Benchmarker::conclude() {
+	lock_guard<mutex> lk(lock);
+	concludeLocked();
+}
+
+void Benchmarker::concludeLocked() {
 	numTimesRun++; // End of this iteration
+	lastDuration = iterationDuration;
+	iterationDuration = steady_clock::duration(0);
+	if(keepSamples && timed) {
+		samples.push_back(lastDuration);
+	}
 }
 
 steady_clock::duration Benchmarker::getAvgTime() const {
+	lock_guard<mutex> lk(lock);
 	return (numTimesRun > 0) ? (totalDuration / numTimesRun) : milliseconds(0);
 }
 
 double Benchmarker::getAvgMs() const {
 	return duration_cast<milliseconds>(getAvgTime()).count();
 }
+
+double Benchmarker::getPercentileMs(double pct) const {
+	vector<steady_clock::duration> sorted;
+	{
+		lock_guard<mutex> lk(lock);
+		sorted = samples;
+	}
+	if(sorted.empty()) { return 0; }
+	size_t idx = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+	if(idx >= sorted.size()) { idx = sorted.size() - 1; }
+	nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+	return duration<double, milli>(sorted[idx]).count();
+}
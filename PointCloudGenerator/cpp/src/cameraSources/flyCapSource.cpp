@@ -0,0 +1,519 @@
+/*
+	flyCapSource.cpp
+
+	Frames from a pair of software-triggered Point Grey cameras.
+*/
+
+#include <cameraSources/flyCapSource.h>
+#include <string.h>
+#include <thread>
+using namespace FlyCapture2;
+using namespace std;
+
+static void discardImage( Image* pImage, const void* pCallbackData ) {
+	;
+}
+
+bool FlyCapSource::initPtGreyCam (unsigned int sn, list<pair<string, double>> cam_props,
+		Camera &cam, CameraInfo &camInfo) {
+	Error error;
+	// Find camera
+	PGRGuid camGuid;
+	error = mgr.GetCameraFromSerialNumber(sn, &camGuid);
+	if (error != PGRERROR_OK)
+	{
+		stringstream ss;
+		ss << "Failed to find camera for SN " << sn;
+		logger->logError(ss.str());
+		return false;
+	}
+
+	error = cam.Connect(&camGuid);
+	if (error != PGRERROR_OK)
+	{
+		stringstream ss;
+		ss << "Failed to connect to camera #" << sn;
+		logger->logError(ss.str());
+		return false;
+	}
+
+	// Get the camera info and print it out
+	error = cam.GetCameraInfo(&camInfo);
+	if ( error != PGRERROR_OK )
+	{
+		stringstream ss;
+		ss << "Failed to find camera info for SN " << sn;
+		logger->logWarning(ss.str());
+	}
+
+	// Send properties to the camera
+	for(auto const &it : cam_props) {
+		Property prop;
+		prop.type = propTypeFromString(it.first);
+
+		//// For testing
+		// error = cam.GetProperty(&prop);
+		// if ( error == PGRERROR_OK )
+		// {
+			// stringstream ss;
+			// ss << "Old value of " << it.first << ":"
+				// << "\nprop.type           = " << prop.type
+				// << "\nprop.present        = " << prop.present
+				// << "\nprop.absControl     = " << prop.absControl
+				// << "\nprop.onePush        = " << prop.onePush
+				// << "\nprop.onOff          = " << prop.onOff
+				// << "\nprop.autoManualMode = " << prop.autoManualMode
+				// << "\nprop.valueA         = " << prop.valueA
+				// << "\nprop.valueB         = " << prop.valueB
+				// << "\nprop.absValue       = " << prop.absValue
+			// << endl;
+			// logger->logInfo(ss.str());
+		// }
+
+		prop.absValue = it.second; // Not absolute in the mathematical sense.
+		prop.absControl = true; // Use absValue, not valueA (valueA is in "ticks", absValue is in a human-readable unit)
+		prop.onOff = true; // Use this property
+		prop.autoManualMode = false; // Manual control for now; may be set to auto later.
+
+		error = cam.SetProperty(&prop);
+		stringstream ss;
+		if ( error != PGRERROR_OK ) {
+			ss << "Failed to set camera " << it.first << " to " << it.second;
+			logger->logError(ss.str());
+		} else {
+			ss << "Succesfully set camera " << it.first << " to " << it.second;
+			logger->logInfo(ss.str());
+		}
+	}
+
+	// Configuire camera trigger mode so that it only captures when commanded.
+	// Currently using Overlapped Exposure Readout Trigger.
+	// (Mode 14, section 7.1.5, page 42 of the Chameleon Technical Reference Manual)
+	TriggerMode camTrigMode;
+	camTrigMode.onOff = true;
+	camTrigMode.source = 0;// No pins, software only
+	camTrigMode.mode = 14;
+	error = cam.SetTriggerMode(&camTrigMode);
+	if ( error != PGRERROR_OK )
+	{
+		stringstream ss;
+		ss << "Failed to set trigger mode for SN " << sn;
+		logger->logWarning(ss.str());
+	}
+
+	return true;
+}
+void FlyCapSource::startPtGreyCam(Camera &cam, CameraCallbackItems* cbItems) {
+	Error error; // TODO: error handling
+	error = cam.StartCapture(&discardImage);
+	if ( error == PGRERROR_ISOCH_BANDWIDTH_EXCEEDED )
+	{ logger->logError("Bandwidth exceeded; can't start image capture."); }
+	else if ( error != PGRERROR_OK )
+	{ logger->logError("Failed to start image capture"); }
+	else if ( error == PGRERROR_OK )
+	{
+		// For some reason, the first trigger often fails.
+		// As a workaround, trigger once here.
+		error = cam.FireSoftwareTrigger();
+		if(error != PGRERROR_OK)
+		{ logger->logWarning("Failed to trigger camera while starting."); }
+		// Need to delay a bit for it to work.  Ideally we'd be doing some
+		// sort of threading, but the core idea is to tolerate one or more
+		// cameras silently failing to acquire.
+		this_thread::sleep_for(milliseconds(1000));
+		// cam.SetCallback(NULL) doesn't work so we just
+		// restart the capture without a callback.
+		error = cam.StopCapture();
+		if(error != PGRERROR_OK)
+		{ logger->logWarning("Failed to restart	camera."); }
+		error = cam.StartCapture(flyCapImgEvent, cbItems);
+		if(error != PGRERROR_OK)
+		{ logger->logWarning("Failed to restart	camera."); }
+	}
+}
+void FlyCapSource::stopPtGreyCam (Camera &cam) {
+	Error error; // TODO: error handling
+	error = cam.StopCapture();
+}
+
+void FlyCapSource::init(json options, Logger * lgr, FramePool * pool) {
+	Error error; // TODO: error handling
+	logger = lgr;
+
+	// Load configuration options
+	string cur_key = "";
+	list<pair<string, double>> cam_props;
+	try {
+		cur_key = "leftCamSn";                  leftVisibleCamSn       = options[cur_key];
+		cur_key = "rightCamSn";                 rightVisibleCamSn      = options[cur_key];
+		cur_key = "cameraTimeoutMs"; cameraTimeout = chrono::milliseconds((int)options[cur_key]);
+		cur_key = "latencyHistogram";     json  hist_section           = options[cur_key];
+		cur_key = "bucketUs";             long  bucket_us              = hist_section[cur_key];
+		cur_key = "maxLatencyMs";         long  max_latency_ms         = hist_section[cur_key];
+		cur_key = "maxSkewMs";            long  max_skew_ms            = hist_section[cur_key];
+		histLatencyL.init(0, max_latency_ms * 1000, bucket_us);
+		histLatencyR.init(0, max_latency_ms * 1000, bucket_us);
+		histSkew    .init(-max_skew_ms * 1000, max_skew_ms * 1000, bucket_us);
+		cur_key = "visibleLightCamProps"; json  cam_props_section      = options[cur_key];
+		for(auto const & cam_prop: cam_props_section) {
+			// Properties are listed as "name", value, "unit".
+			// Units are there for the benefit of the configuration file editor.
+			pair<string, double> prop;
+			prop.first  = cam_prop[0];
+			prop.second = cam_prop[1];
+			cam_props.push_back(prop);
+
+			// Some properties may be set to have the camera control them automatically
+			string auto_or_man = cam_prop[3];
+			if(auto_or_man.compare("auto") == 0) {
+				autoControlledProps.push_back(propTypeFromString(cam_prop[0]));
+				autoGainControlEnabled = true;
+			}
+		}
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	unsigned int numCams = 0;
+	error = mgr.GetNumOfCameras(&numCams);
+	if (error != PGRERROR_OK)
+	{
+		logger->logError("Failed to count cameras");
+	}
+	stringstream ss;
+	ss << "See " << numCams << " cameras.";
+	logger->logDebug(ss.str());
+
+	bool success = initPtGreyCam(leftVisibleCamSn , cam_props, camL, camInfoL);
+	ss.str(""); ss.clear();
+	ss  << "Left  camera: "
+		<< camInfoL.vendorName << ", "
+		<< camInfoL.modelName  << ", "
+		<< camInfoL.serialNumber;
+	if(success) {
+		logger->logInfo(ss.str());
+	} else {
+		logger->logWarning("Couldn't connect to Left camera.  Won't get images from it.");
+	}
+	camLConnected = success;
+
+	success = initPtGreyCam(rightVisibleCamSn, cam_props, camR, camInfoR);
+	ss.str(""); ss.clear();
+	ss  << "Right camera: "
+		<< camInfoR.vendorName << ", "
+		<< camInfoR.modelName  << ", "
+		<< camInfoR.serialNumber;
+	if(success) {
+		logger->logInfo(ss.str());
+	} else {
+		logger->logWarning("Couldn't connect to Right camera.  Won't get images from it.");
+	}
+	camRConnected = success;
+
+
+	// With automatic gain control, we set the left camera to automatically
+	// determine its own gain.  Then we copy that value to the right camera.
+	if(autoGainControlEnabled && camLConnected) {
+		for(auto const &pt : autoControlledProps) {
+			Property prop;
+			prop.type = pt;
+			prop.onOff = true; // Use this property
+			prop.autoManualMode = true; // Automatic control
+			error = camL.SetProperty(&prop);
+			if ( error != PGRERROR_OK ) {
+				logger->logError("Failed to enable auto gain control on left camera.");
+				// Don't try to copy over parameters later
+				autoGainControlEnabled = false;
+			} else {
+				// All good
+			}
+		}
+	} else {
+		// Don't try to copy over parameters later
+		autoGainControlEnabled = false;
+	}
+
+	// Set up the events the callbacks signal
+	cameraEvents.init();
+	cbItemsL.eventFd = Reactor::makeEventFd();
+	cbItemsR.eventFd = Reactor::makeEventFd();
+	cameraEvents.addSource(cbItemsL.eventFd, [this]{
+		Reactor::drain(cbItemsL.eventFd);
+		imageArrivedL = true;
+	});
+	cameraEvents.addSource(cbItemsR.eventFd, [this]{
+		Reactor::drain(cbItemsR.eventFd);
+		imageArrivedR = true;
+	});
+	cbItemsL.logger = logger;
+	cbItemsR.logger = logger;
+	cbItemsL.pool = pool;
+	cbItemsR.pool = pool;
+}
+
+void FlyCapSource::start() {
+	if(camLConnected) { startPtGreyCam(camL, &cbItemsL); }
+	if(camRConnected) { startPtGreyCam(camR, &cbItemsR); }
+	// TODO: start IR cam
+	// TODO: error handling
+}
+
+void FlyCapSource::stop() {
+	if(camLConnected) { stopPtGreyCam(camL); }
+	if(camRConnected) { stopPtGreyCam(camR); }
+	// TODO: stop IR cam
+	// TODO: error handling
+
+	stringstream ss;
+	ss << "Camera timing since startup:" << endl
+	   << histLatencyL.toString() << endl
+	   << histLatencyR.toString() << endl
+	   << histSkew.toString() << endl
+	   << "Timeouts: " << bmTimeoutsL.getIterations() << " left, "
+	   << bmTimeoutsR.getIterations() << " right.";
+	logger->logInfo(ss.str());
+}
+
+void FlyCapSource::trigger(unsigned long frame_id) {
+	Error error;
+	// A callback that missed its timeout last frame may have come in since,
+	// or still be copying.  Re-arming for this frame makes it drop its image,
+	// and draining after discards any signal it already sent.
+	armCallback(cbItemsL, frame_id);
+	armCallback(cbItemsR, frame_id);
+	Reactor::drain(cbItemsL.eventFd);
+	Reactor::drain(cbItemsR.eventFd);
+
+	if(camLConnected)
+	{
+		logger->logDebug("Firing left trigger.");
+		error = camL.FireSoftwareTrigger();
+	}
+	if(error != PGRERROR_OK)
+	{ logger->logWarning("Failed to trigger left camera."); }
+	if(camRConnected)
+	{
+		logger->logDebug("Firing right trigger.");
+		error = camR.FireSoftwareTrigger();
+	}
+	if(error != PGRERROR_OK)
+	{ logger->logWarning("Failed to trigger right camera."); }
+}
+
+void FlyCapSource::retrieve(ImageDataSet &data) {
+	bmCamControl.start();
+	// If we're using automatic gain control, copy parameters from left to right
+	if(autoGainControlEnabled && camLConnected && camRConnected) {
+		data.autoGainValues = copyAutoGainLeftToRight();
+	}
+	bmCamControl.end();
+
+	logger->logDebug("Waiting for images");
+	waitForCallbacks();
+	recordArrivals();
+	// The callback's images are already in our own slots, which we
+	// now hand down the pipeline.  A camera that timed out has none.
+	if(camLConnected && imageArrivedL) { takeImage(cbItemsL, data.imgVisibleL, data.slotVisibleL); }
+	if(camRConnected && imageArrivedR) { takeImage(cbItemsR, data.imgVisibleR, data.slotVisibleR); }
+	// The callback leaves the image empty if it had nowhere to put it
+	data.imgVisibleLValid = camLConnected && imageArrivedL && !data.imgVisibleL.empty();
+	data.imgVisibleRValid = camRConnected && imageArrivedR && !data.imgVisibleR.empty();
+	if(!data.imgVisibleLValid)
+	{ logger->logWarning("Error acquiring left image"); }
+	if(!data.imgVisibleRValid)
+	{ logger->logWarning("Error acquiring right image"); }
+	data.imgInfraredValid = false;
+}
+
+// Makes the next callback on items the one for frame_id, and drops
+// whatever an earlier one left behind
+void FlyCapSource::armCallback(CameraCallbackItems &items, unsigned long frame_id) {
+	lock_guard<mutex> lk(items.lock);
+	items.image.release();
+	items.slot.reset();
+	items.frameId = frame_id;
+	items.armedFrameId = frame_id;
+	items.triggerTime = chrono::steady_clock::now();
+}
+
+// Moves the callback's image and its slot out of items
+void FlyCapSource::takeImage(CameraCallbackItems &items, cv::Mat &image, FramePool::Slot &slot) {
+	lock_guard<mutex> lk(items.lock);
+	image = items.image;
+	slot = std::move(items.slot);
+	items.image.release();
+}
+
+// Returns the values copied, for the recording
+string FlyCapSource::copyAutoGainLeftToRight() {
+	Error error;
+	string values = "";
+	for(auto const &pt : autoControlledProps) {
+		Property prop;
+		prop.type = pt;
+		error = camL.GetProperty(&prop);
+		if ( error != PGRERROR_OK ) {
+			logger->logError("Failed to read gain control from left camera.");
+		} else {
+			prop.absControl = true; // Use absValue, not valueA (valueA is in "ticks", absValue is in a human-readable unit)
+			prop.onOff = true; // Use this property
+			prop.autoManualMode = false; // Manual control
+			error = camR.SetProperty(&prop);
+			if ( error != PGRERROR_OK ) {
+				logger->logError("Failed to set right camera gain.");
+			} else {
+				// Success
+				values = values + propTypeToString(pt) + "=" + to_string(prop.absValue) + ",";
+			}
+		}
+	}
+	return values;
+}
+
+cv::Mat FlyCapSource::cvMatFromFlyCap2Image(FlyCapture2::Image *img, FramePool * pool, FramePool::Slot &slot) {
+	// The driver recycles its buffer as soon as we return, even when it's
+	// one we gave it with SetUserBuffers(), so it can't be adopted.
+	// Copy it, packing the rows.
+	size_t rows = img->GetRows();
+	size_t cols = img->GetCols();
+	size_t stride = img->GetStride();
+	slot = pool->claim(rows * cols);
+	if(!slot) {
+		return cv::Mat();
+	}
+	const unsigned char * src = img->GetData();
+	unsigned char * dst = slot.get();
+	if(stride == cols) {
+		memcpy(dst, src, rows * cols);
+	} else {
+		for(size_t r = 0; r < rows; ++r) {
+			memcpy(dst + r * cols, src + r * stride, cols);
+		}
+	}
+	return cv::Mat(rows, cols, CV_8UC1, dst);
+}
+
+PropertyType FlyCapSource::propTypeFromString(string p) {
+	if(p.compare("brightness") == 0) {
+		return PropertyType::BRIGHTNESS;
+	} else if(p.compare("shutter") == 0) {
+		return PropertyType::SHUTTER;
+	} else if(p.compare("gain") == 0) {
+		return PropertyType::GAIN;
+	} else if(p.compare("exposure") == 0) {
+		return PropertyType::AUTO_EXPOSURE;
+	} else {
+		logger->logError("Unknown camera property type \"" + p + "\"");
+		return PropertyType::UNSPECIFIED_PROPERTY_TYPE;
+	}
+}
+
+string FlyCapSource::propTypeToString(PropertyType  p) {
+	switch(p) {
+		case BRIGHTNESS:                return "Brightness";                break;
+		case AUTO_EXPOSURE:             return "Auto exposure";             break;
+		case SHARPNESS:                 return "Sharpness";                 break;
+		case WHITE_BALANCE:             return "White balance";             break;
+		case HUE:                       return "Hue";                       break;
+		case SATURATION:                return "Saturation";                break;
+		case GAMMA:                     return "Gamma";                     break;
+		case IRIS:                      return "Iris";                      break;
+		case FOCUS:                     return "Focus";                     break;
+		case ZOOM:                      return "Zoom";                      break;
+		case PAN:                       return "Pan";                       break;
+		case TILT:                      return "Tilt";                      break;
+		case SHUTTER:                   return "Shutter";                   break;
+		case GAIN:                      return "Gain";                      break;
+		case TRIGGER_MODE:              return "Trigger mode";              break;
+		case TRIGGER_DELAY:             return "Trigger delay";             break;
+		case FRAME_RATE:                return "Frame rate";                break;
+		case TEMPERATURE:               return "Temperature";               break;
+		case UNSPECIFIED_PROPERTY_TYPE: return "Unspecified property type"; break;
+		default:                        return "Unspecified property type"; break;
+	}
+}
+
+void FlyCapSource::flyCapImgEvent(Image * pImage, const void * pCallbackData) {
+	CameraCallbackItems * items = (CameraCallbackItems*)pCallbackData;
+	// Stamped before the copy, so it's the driver's latency we measure
+	chrono::steady_clock::time_point arrival_time = chrono::steady_clock::now();
+	// Claim the frame this trigger was armed for.  A second callback for
+	// one trigger, or one after a timeout, finds nothing armed.
+	unsigned long frame_id;
+	chrono::steady_clock::time_point trigger_time;
+	{
+		lock_guard<mutex> lk(items->lock);
+		frame_id = items->armedFrameId;
+		trigger_time = items->triggerTime;
+		items->armedFrameId = FrameTracer::NO_FRAME;
+	}
+	if(frame_id == FrameTracer::NO_FRAME) {
+		items->logger->logDebug(string("Dropped unexpected ") + items->side + " callback");
+		return;
+	}
+	FrameTracer::record(frame_id, items->traceName, trigger_time, arrival_time);
+	items->logger->logDebug(string("Got ") +  items->side + " callback");
+
+	// Copy outside the lock, then hand over only if no later trigger has
+	// re-armed for another frame meanwhile
+	FramePool::Slot slot;
+	cv::Mat image = cvMatFromFlyCap2Image(pImage, items->pool, slot);
+	{
+		lock_guard<mutex> lk(items->lock);
+		if(items->frameId != frame_id) {
+			items->logger->logDebug(string("Dropped late ") + items->side + " callback");
+			return;
+		}
+		items->image = image;
+		items->slot = std::move(slot);
+		items->arrivalTime = arrival_time;
+	}
+	Reactor::signalEventFd(items->eventFd);
+}
+
+// Waits for both callbacks of the last trigger, or until cameraTimeout
+// has passed.  Sets imageArrivedL and imageArrivedR.
+void FlyCapSource::waitForCallbacks() {
+	imageArrivedL = !camLConnected;
+	imageArrivedR = !camRConnected;
+	chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + cameraTimeout;
+	while(!(imageArrivedL && imageArrivedR)) {
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if(now >= deadline) {
+			stringstream ss;
+			ss << "Timed out after " << cameraTimeout.count() << "ms waiting for "
+			   << (imageArrivedL ? "" : "left ") << (imageArrivedR ? "" : "right ") << "image.";
+			logger->logWarning(ss.str());
+			if(!imageArrivedL) { bmTimeoutsL.count(); }
+			if(!imageArrivedR) { bmTimeoutsR.count(); }
+			break;
+		}
+		// Round up, so we don't spin through the last partial millisecond
+		cameraEvents.runOnce(chrono::duration_cast<chrono::milliseconds>(deadline - now) + chrono::milliseconds(1));
+	}
+}
+
+// Adds the last frame's arrivals to the histograms.  The eventfd the
+// callback signalled orders its arrivalTime before our read of it.
+void FlyCapSource::recordArrivals() {
+	bool got_l = camLConnected && imageArrivedL;
+	bool got_r = camRConnected && imageArrivedR;
+	if(got_l) {
+		chrono::steady_clock::duration latency = cbItemsL.arrivalTime - cbItemsL.triggerTime;
+		histLatencyL.add(latency);
+		bmLatencyL.add(latency);
+	}
+	if(got_r) {
+		chrono::steady_clock::duration latency = cbItemsR.arrivalTime - cbItemsR.triggerTime;
+		histLatencyR.add(latency);
+		bmLatencyR.add(latency);
+	}
+	if(got_l && got_r) {
+		chrono::steady_clock::duration skew = cbItemsR.arrivalTime - cbItemsL.arrivalTime;
+		histSkew.add(skew);
+		bmSkew.add(skew < chrono::steady_clock::duration(0) ? -skew : skew);
+	}
+}
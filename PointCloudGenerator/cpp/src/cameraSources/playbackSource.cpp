@@ -0,0 +1,285 @@
+/*
+	playbackSource.cpp
+
+	Frames from an earlier recording.
+*/
+
+#include <cameraSources/playbackSource.h>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <opencv2/highgui/highgui.hpp>
+using namespace std;
+
+const string PlaybackSource::REC_INFO_FILENAME = "recording_info.json";
+
+chrono::time_point<chrono::system_clock> PlaybackSource::readTimeFromTabSepInput(istream &input) {
+	// Assumes the next two tokens in the input stream are:
+	// 2017-01-11_192901	489
+	// Where the first token is in the timestampPattern format and the second is milliseconds.
+	int millis;
+	std::tm time_s = {};
+	input >> std::get_time(&time_s, timestampPattern.c_str());
+	input >> millis;
+	chrono::time_point<chrono::system_clock> timestamp = chrono::system_clock::from_time_t(std::mktime(&time_s));
+	timestamp += chrono::milliseconds(millis);
+
+	return timestamp;
+}
+
+void PlaybackSource::init(json options, Logger * lgr, FramePool * pool) {
+	logger = lgr;
+
+	// Load configuration options
+	string index_fn;
+	string rec_dir = "~";
+	string playback_path = "~";
+	string container_fn;
+	size_t read_ahead_frames = 0;
+	unsigned int tiff_decode_threads = 0;
+	string cur_key = "";
+	try {
+		cur_key = "imageRecordPlayback"; json   rec_play_section       = options[cur_key];
+		cur_key = "indexFile";                  index_fn               = rec_play_section[cur_key];
+		cur_key = "recDir";                     rec_dir                = rec_play_section[cur_key];
+		cur_key = "playbackPath";               playback_path          = rec_play_section[cur_key];
+		cur_key = "timestampPattern";           timestampPattern       = rec_play_section[cur_key];
+		cur_key = "containerFile";              container_fn           = rec_play_section[cur_key];
+		cur_key = "readAheadFrames";            read_ahead_frames      = rec_play_section[cur_key];
+		cur_key = "tiffReadAheadFrames";        tiffReadAheadDepth     = rec_play_section[cur_key];
+		cur_key = "tiffDecodeThreads";          tiff_decode_threads    = rec_play_section[cur_key];
+		cur_key = "playbackStartOffsetS"; playbackStartOffset = chrono::milliseconds((int)(1000 * (double)rec_play_section[cur_key]));
+		// Only for recordings that don't say how they were flipped
+		cur_key = "flipImgL";                   recordingFlipped[0]    = options[cur_key];
+		cur_key = "flipImgR";                   recordingFlipped[1]    = options[cur_key];
+		cur_key = "imgFlipCodeL";               recordingFlipCode[0]   = options[cur_key];
+		cur_key = "imgFlipCodeR";               recordingFlipCode[1]   = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	// Play a single-file recording if there is one, otherwise the TIFFs
+	containerFilename = playback_path + container_fn;
+	if(StereoRecordingReader::isRecording(containerFilename)) {
+		logger->logDebug("Will play images from this file: " + containerFilename);
+		playReader.open(containerFilename, logger);
+		playReader.setReadAhead(read_ahead_frames);
+	} else {
+		folderName = playback_path + rec_dir;
+		string index_filename = playback_path + index_fn;
+		logger->logDebug("Will play images from this folder: " + folderName);
+		logger->logDebug("Will play this index file: " + index_filename);
+
+		playIndexFile.open(index_filename.c_str());
+		if(!playIndexFile.is_open())
+		{ logger->logError("Couldn't open recording index file " + index_filename); }
+		decodePool.init(tiff_decode_threads);
+	}
+
+	// Older recordings have no info file, and were always stored flipped
+	// as configured.  Newer ones say what flips they were stored with.
+	ifstream info_file(playback_path + REC_INFO_FILENAME);
+	if(info_file.is_open()) {
+		try {
+			json rec_info;
+			info_file >> rec_info;
+			bool frames_flipped = rec_info["framesFlipped"];
+			bool flip_l         = rec_info["flipImgL"];
+			bool flip_r         = rec_info["flipImgR"];
+			int  code_l         = rec_info["imgFlipCodeL"];
+			int  code_r         = rec_info["imgFlipCodeR"];
+			recordingFlipped [0] = frames_flipped && flip_l;
+			recordingFlipped [1] = frames_flipped && flip_r;
+			recordingFlipCode[0] = code_l;
+			recordingFlipCode[1] = code_r;
+		} catch(exception e) {
+			logger->logWarning("Couldn't parse " + playback_path + REC_INFO_FILENAME + "; assuming frames are flipped as configured.");
+		}
+	}
+	logger->logDebug(string("Recorded frames are stored ") + (recordingFlipped[0] ? "flipped" : "unflipped")
+		+ " on the left and " + (recordingFlipped[1] ? "flipped" : "unflipped") + " on the right.");
+
+	// Note the start time, from which we'll compute deltas.
+	if(playReader.isOpen()) {
+		if(playReader.getNumFrames() > 0) {
+			lastFrameTime = playReader.getFrameTime(0);
+		}
+	} else {
+		lastFrameTime = readTimeFromTabSepInput(playIndexFile);
+		playIndexFile.seekg(0);//rewind
+	}
+	time_t tt = chrono::system_clock::to_time_t(lastFrameTime);
+	stringstream ss;
+	ss << "Selected recording begins at ";
+	ss << put_time(localtime(&tt), timestampPattern.c_str());
+	logger->logDebug(ss.str());
+	rewind();
+}
+
+void PlaybackSource::start() {
+	rewind();
+}
+
+void PlaybackSource::retrieve(ImageDataSet &data) {
+	if(playReader.isOpen()) {
+		// Images sourced from a single-file recording
+		readImagesFromContainer(data);
+	} else {
+		// Images sourced from a recording of TIFFs, decoded ahead of time
+		readImagesFromTiffs(data);
+	}
+}
+
+void PlaybackSource::rewind() {
+	// Anything decoded ahead is from where we were
+	for(auto &f : tiffReadAhead) {
+		decodePool.wait(f->decoded);
+	}
+	tiffReadAhead.clear();
+	tiffIndexExhausted = false;
+	playIndexFile.clear();
+	playIndexFile.seekg(0);
+	playFrame = 0;
+	playbackComplete = playReader.isOpen() && playReader.getNumFrames() == 0;
+	playedFirstFrame = false;
+	if(playReader.isOpen() && playbackStartOffset.count() > 0) {
+		seek(playReader.getFrameTime(0) + playbackStartOffset);
+	}
+}
+
+bool PlaybackSource::seek(chrono::time_point<chrono::system_clock> t) {
+	if(!playReader.isOpen()) {
+		logger->logWarning("Only single-file recordings can be played from a given time.");
+		return false;
+	}
+	playFrame = playReader.findFrame(t);
+	playbackComplete = (playFrame >= playReader.getNumFrames());
+	playedFirstFrame = false;
+	stringstream ss;
+	ss << "Playback continues from frame " << playFrame << " of " << playReader.getNumFrames() << ".";
+	logger->logDebug(ss.str());
+	return true;
+}
+
+// Parses index lines until the current frame and the tiffReadAheadDepth
+// after it have been handed to the decode pool
+void PlaybackSource::queueTiffDecodes() {
+	while(tiffReadAhead.size() < tiffReadAheadDepth + 1 && !tiffIndexExhausted) {
+		unique_ptr<TiffPlaybackFrame> f(new TiffPlaybackFrame());
+		f->frameTime = readTimeFromTabSepInput(playIndexFile);
+
+		string valid;
+		ImageDataSet &images = f->images;
+		playIndexFile >> valid >> f->pathL;
+		f->pathL = folderName + f->pathL;
+		images.imgVisibleLValid = (valid == "true");
+		playIndexFile >> valid >> f->pathR;
+		f->pathR = folderName + f->pathR;
+		images.imgVisibleRValid = (valid == "true");
+		playIndexFile >> valid >> f->pathIR;
+		f->pathIR = folderName + f->pathIR;
+		images.imgInfraredValid = (valid == "true");
+		// Once the index runs out, this is the last frame
+		f->lastFrame = tiffIndexExhausted = playIndexFile.eof();
+
+		// Left, right and infrared are decoded separately, so one frame's
+		// images decode in parallel too
+		TiffPlaybackFrame * fp = f.get();
+		if(images.imgVisibleLValid) {
+			decodePool.submit(fp->decoded, [this, fp]{ decodeTiff(fp->pathL, "left", fp->images.imgVisibleL, fp->images.imgVisibleLValid); });
+		}
+		if(images.imgVisibleRValid) {
+			decodePool.submit(fp->decoded, [this, fp]{ decodeTiff(fp->pathR, "right", fp->images.imgVisibleR, fp->images.imgVisibleRValid); });
+		}
+		if(images.imgInfraredValid) {
+			decodePool.submit(fp->decoded, [this, fp]{ decodeTiff(fp->pathIR, "IR", fp->images.imgInfrared, fp->images.imgInfraredValid); });
+		}
+		tiffReadAhead.push_back(std::move(f));
+	}
+}
+
+// Runs on the decode pool
+void PlaybackSource::decodeTiff(const string &path, const char * side, cv::Mat &img, bool &valid) {
+	logger->logDebug("Opening " + path);
+	img = cv::imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+	if(!img.data) {
+		logger->logWarning(string("Couldn't open ") + side + " image at " + path);
+		valid = false;
+	}
+}
+
+void PlaybackSource::readImagesFromTiffs(ImageDataSet &data) {
+	queueTiffDecodes();
+	// Nothing left, eg. asked again after the last frame or an empty index
+	if(tiffReadAhead.empty()) {
+		data.imgVisibleLValid = data.imgVisibleRValid = data.imgInfraredValid = false;
+		playbackComplete = true;
+		return;
+	}
+	unique_ptr<TiffPlaybackFrame> f = std::move(tiffReadAhead.front());
+	tiffReadAhead.pop_front();
+	// Keep the pool busy with what's coming while this one's used
+	queueTiffDecodes();
+	// Rethrows anything the decode threw, so wait even when it's done
+	bool waiting = !f->decoded.isDone();
+	if(waiting) { bmTiffDecodeWait.start(); }
+	decodePool.wait(f->decoded);
+	if(waiting) { bmTiffDecodeWait.end(); }
+	decodePool.publishStats();
+
+	data.imgVisibleL      = f->images.imgVisibleL;
+	data.imgVisibleR      = f->images.imgVisibleR;
+	data.imgInfrared      = f->images.imgInfrared;
+	data.imgVisibleLValid = f->images.imgVisibleLValid;
+	data.imgVisibleRValid = f->images.imgVisibleRValid;
+	data.imgInfraredValid = f->images.imgInfraredValid;
+
+	if(f->lastFrame) {
+		logger->logDebug("EOF on playback file");
+		playbackComplete = true;
+	} else {
+		if(playedFirstFrame) {
+			interframeDelay = (f->frameTime - lastFrameTime);
+		} else {
+			interframeDelay = std::chrono::milliseconds(0);
+			playedFirstFrame = true;
+		}
+	}
+	lastFrameTime = f->frameTime;
+}
+
+void PlaybackSource::readImagesFromContainer(ImageDataSet &data) {
+	data.imgVisibleLValid = data.imgVisibleRValid = data.imgInfraredValid = false;
+	if(playFrame >= playReader.getNumFrames()) {
+		logger->logDebug("End of playback file");
+		playbackComplete = true;
+		return;
+	}
+
+	StereoRecordingFrame frame;
+	if(playReader.readFrame(playFrame, frame)) {
+		data.imgVisibleL      = frame.imgL;
+		data.imgVisibleR      = frame.imgR;
+		data.imgVisibleLValid = frame.validL;
+		data.imgVisibleRValid = frame.validR;
+		data.autoGainValues   = frame.autoGainValues;
+	} else {
+		stringstream ss;
+		ss << "Couldn't read frame " << playFrame << " of " << containerFilename;
+		logger->logWarning(ss.str());
+	}
+
+	chrono::time_point<chrono::system_clock> nextFrameTime = playReader.getFrameTime(playFrame);
+	if(playedFirstFrame) {
+		interframeDelay = (nextFrameTime - lastFrameTime);
+	} else {
+		interframeDelay = std::chrono::milliseconds(0);
+		playedFirstFrame = true;
+	}
+	lastFrameTime = nextFrameTime;
+	// This frame still goes out; the next call finds the end
+	++playFrame;
+}
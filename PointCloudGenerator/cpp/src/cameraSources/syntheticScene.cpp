@@ -0,0 +1,130 @@
+/*
+	syntheticScene.cpp
+
+	Renders textured planes and boxes into rectified stereo pairs, with
+	ground-truth depth.
+*/
+
+#include <cameraSources/syntheticScene.h>
+#include <cmath>
+#include <stdint.h>
+using namespace std;
+
+SyntheticScene::Vec3 SyntheticScene::vecFromJson(const json &j) {
+	Vec3 v = {j[0], j[1], j[2]};
+	return v;
+}
+
+void SyntheticScene::init(json options) {
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "textureCellM";         textureCellM           = options[cur_key];
+		cur_key = "nearM";                nearM                  = options[cur_key];
+		cur_key = "planes";         json  planes_section         = options[cur_key];
+		for(auto const &p : planes_section) {
+			cur_key = "point";  Plane plane;  plane.point  = vecFromJson(p[cur_key]);
+			cur_key = "normal";               plane.normal = vecFromJson(p[cur_key]);
+			planes.push_back(plane);
+		}
+		cur_key = "boxes";          json  boxes_section          = options[cur_key];
+		for(auto const &b : boxes_section) {
+			cur_key = "min";    Box box;      box.min      = vecFromJson(b[cur_key]);
+			cur_key = "max";                  box.max      = vecFromJson(b[cur_key]);
+			boxes.push_back(box);
+		}
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in synthetic scene section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	if(textureCellM <= 0) {
+		throw invalid_argument("Synthetic scene texture cells must have a positive size.");
+	}
+}
+
+double SyntheticScene::intersect(const Vec3 &o, const Vec3 &d) const {
+	double nearest = 0;
+	for(auto const &pl : planes) {
+		const Vec3 &n = pl.normal;
+		double denom = d.x * n.x + d.y * n.y + d.z * n.z;
+		if(fabs(denom) < 1e-12) { continue; } // Edge on
+		double t = ((pl.point.x - o.x) * n.x + (pl.point.y - o.y) * n.y + (pl.point.z - o.z) * n.z) / denom;
+		if(t >= nearM && (nearest == 0 || t < nearest)) { nearest = t; }
+	}
+	for(auto const &b : boxes) {
+		// Slab method: the ray is inside the box where it's inside all
+		// three pairs of faces
+		const double o_a[3]  = {o.x, o.y, o.z};
+		const double d_a[3]  = {d.x, d.y, d.z};
+		const double lo_a[3] = {b.min.x, b.min.y, b.min.z};
+		const double hi_a[3] = {b.max.x, b.max.y, b.max.z};
+		double t_in = -INFINITY, t_out = INFINITY;
+		for(int i = 0; i < 3; ++i) {
+			if(d_a[i] == 0) {
+				if(o_a[i] < lo_a[i] || o_a[i] > hi_a[i]) { t_out = -INFINITY; }
+				continue;
+			}
+			double t1 = (lo_a[i] - o_a[i]) / d_a[i];
+			double t2 = (hi_a[i] - o_a[i]) / d_a[i];
+			t_in  = max(t_in,  min(t1, t2));
+			t_out = min(t_out, max(t1, t2));
+		}
+		if(t_out < t_in || t_out < nearM) { continue; }
+		double t = (t_in >= nearM) ? t_in : t_out;
+		if(nearest == 0 || t < nearest) { nearest = t; }
+	}
+	return nearest;
+}
+
+// Each cube of the texture grid gets its own grey level.  The grid is
+// offset by a fraction of a cell, so surfaces lying on round numbers don't
+// sit exactly on cube boundaries, where rounding would make them speckle.
+unsigned char SyntheticScene::shade(const Vec3 &p) const {
+	const double OFFSET = 0.371;
+	int32_t ix = (int32_t)floor(p.x / textureCellM + OFFSET);
+	int32_t iy = (int32_t)floor(p.y / textureCellM + OFFSET);
+	int32_t iz = (int32_t)floor(p.z / textureCellM + OFFSET);
+	uint32_t h = (uint32_t)ix * 73856093u ^ (uint32_t)iy * 19349663u ^ (uint32_t)iz * 83492791u;
+	h ^= h >> 16; h *= 0x7feb352du;
+	h ^= h >> 15; h *= 0x846ca68bu;
+	h ^= h >> 16;
+	// Keep clear of black and white, so noise can't saturate
+	return (unsigned char)(16 + (h & 0xFF) * 224 / 256);
+}
+
+void SyntheticScene::renderView(double f, double cx, double cy, double origin_x, cv::Mat &img, cv::Mat * depth) const {
+	const unsigned char BACKGROUND = 128; // Flat, so nothing is found there
+	Vec3 origin = {origin_x, 0, 0};
+	for(int row = 0; row < img.rows; ++row) {
+		unsigned char * img_row = img.ptr<unsigned char>(row);
+		float * depth_row = depth ? depth->ptr<float>(row) : NULL;
+		for(int col = 0; col < img.cols; ++col) {
+			Vec3 dir = {(col - cx) / f, (row - cy) / f, 1};
+			double t = intersect(origin, dir);
+			if(t > 0) {
+				Vec3 hit = {origin.x + t * dir.x, origin.y + t * dir.y, origin.z + t * dir.z};
+				img_row[col] = shade(hit);
+			} else {
+				img_row[col] = BACKGROUND;
+			}
+			if(depth_row) { depth_row[col] = (float)t; }
+		}
+	}
+}
+
+void SyntheticScene::render(StereoCal &cal, cv::Mat &left, cv::Mat &right, cv::Mat &depth) const {
+	Size size = cal.getImageSize();
+	Mat p1 = cal.getCpuProjectionMatrixLeft ();
+	Mat p2 = cal.getCpuProjectionMatrixRight();
+	double f = p1.at<double>(0, 0);
+	// Depths come out of the algorithms as triangulationConst / disparity,
+	// in cm, so take the baseline from the same place
+	double baseline_m = cal.getTriangulationConst() / f / 100;
+	left .create(size, CV_8UC1);
+	right.create(size, CV_8UC1);
+	depth.create(size, CV_32FC1);
+	renderView(f, p1.at<double>(0, 2), p1.at<double>(1, 2), 0,          left,  &depth);
+	renderView(f, p2.at<double>(0, 2), p2.at<double>(1, 2), baseline_m, right, NULL);
+}
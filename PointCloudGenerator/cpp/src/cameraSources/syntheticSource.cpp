@@ -0,0 +1,100 @@
+/*
+	syntheticSource.cpp
+
+	Rendered frames, for running the whole pipeline without cameras.
+*/
+
+#include <cameraSources/syntheticSource.h>
+#include <fstream>
+#include <thread>
+#include "stereoCal.h"
+using namespace std;
+
+void SyntheticSource::init(json options, Logger * lgr, FramePool * pool) {
+	logger = lgr;
+	framePool = pool;
+
+	// Load configuration options
+	string cal_fn;
+	json scene_section;
+	string cur_key = "";
+	try {
+		cur_key = "stereoCalFile";              cal_fn                 = options[cur_key];
+		cur_key = "syntheticSource";      json  synth_section          = options[cur_key];
+		cur_key = "noiseStdDev";                noiseStdDev            = synth_section[cur_key];
+		cur_key = "latencyMs";        latency = chrono::milliseconds((int)synth_section[cur_key]);
+		cur_key = "scene";                      scene_section          = synth_section[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	scene.init(scene_section);
+
+	// Render at the resolution and projection the algorithms will expect,
+	// so with any crop and binning already applied.
+	// The images come out rectified and unflipped, so the maps aren't
+	// needed, and neither is the GPU.
+	json stereo_cal;
+	try {
+		ifstream cal_file(cal_fn);
+		cal_file >> stereo_cal;
+	} catch(exception e) {
+		cerr << "Could not parse JSON calibration file at "
+			 << cal_fn << ".  There was an error opening or parsing:"
+			 << endl << e.what() << endl;
+		throw(e);
+	}
+	stereo_cal["enableGpu"]    = false;
+	stereo_cal["flipImgL"]     = false;
+	stereo_cal["flipImgR"]     = false;
+	stereo_cal["imgFlipCodeL"] = 0;
+	stereo_cal["imgFlipCodeR"] = 0;
+	stereo_cal["ingest"]       = options["ingest"];
+	StereoCal cal;
+	cal.init(stereo_cal);
+	scene.render(cal, sceneL, sceneR, sceneDepth);
+
+	stringstream ss;
+	ss << "Synthetic source: rendered a " << sceneL.cols << "x" << sceneL.rows << " scene.";
+	logger->logInfo(ss.str());
+}
+
+void SyntheticSource::trigger(unsigned long frame_id) {
+	triggerTime = chrono::steady_clock::now();
+}
+
+void SyntheticSource::retrieve(ImageDataSet &data) {
+	this_thread::sleep_until(triggerTime + latency);
+	data.imgVisibleL = render(sceneL, data.slotVisibleL);
+	data.imgVisibleR = render(sceneR, data.slotVisibleR);
+	data.imgVisibleLValid = !data.imgVisibleL.empty();
+	data.imgVisibleRValid = !data.imgVisibleR.empty();
+	data.imgInfraredValid = false;
+	data.isRectified = true;
+	data.depthTruth = sceneDepth;
+	if(!data.imgVisibleLValid || !data.imgVisibleRValid) {
+		logger->logWarning("Frame pool starved; dropping synthetic images.");
+	}
+}
+
+cv::Mat SyntheticSource::render(const cv::Mat &view, FramePool::Slot &slot) {
+	slot = framePool->claim(view.total());
+	if(!slot) {
+		return cv::Mat();
+	}
+	cv::Mat img(view.rows, view.cols, CV_8UC1, slot.get());
+	if(noiseStdDev > 0) {
+		// Fresh noise every frame, as a sensor would have
+		cv::Mat noisy(view.size(), CV_16SC1);
+		cv::randn(noisy, 0, noiseStdDev);
+		cv::Mat view16;
+		view.convertTo(view16, CV_16SC1);
+		noisy += view16;
+		noisy.convertTo(img, CV_8UC1); // Saturates
+	} else {
+		view.copyTo(img);
+	}
+	return img;
+}
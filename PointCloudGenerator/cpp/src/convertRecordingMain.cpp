@@ -0,0 +1,149 @@
+/*
+
+Converts a recording made as TIFFs plus a tab-separated index file into a
+single-file stereo recording, which is written alongside it.  File names
+and the timestamp pattern come from the imageRecordPlayback section of the
+PCG configuration file.
+
+Usage: convert_recording <recording dir> [config file]
+
+*/
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <cstdlib>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "json.hpp"
+#include "logger.h"
+#include "stereoRecording.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+static const char * DEFAULT_CONFIG_FILENAME = "../../config/pcgConfig.json";
+
+// Splits one line of the index file into its tab-separated fields
+static vector<string> splitTabs(const string &line) {
+	vector<string> fields;
+	stringstream ss(line);
+	string field;
+	while(getline(ss, field, '\t')) {
+		fields.push_back(field);
+	}
+	return fields;
+}
+
+// Same interpretation as PlaybackSource::readTimeFromTabSepInput()
+static chrono::time_point<chrono::system_clock> parseTime(const string &ts, const string &ms, const string &pattern) {
+	std::tm time_s = {};
+	stringstream ss(ts);
+	ss >> std::get_time(&time_s, pattern.c_str());
+	chrono::time_point<chrono::system_clock> timestamp = chrono::system_clock::from_time_t(std::mktime(&time_s));
+	timestamp += chrono::milliseconds(atoi(ms.c_str()));
+	return timestamp;
+}
+
+static cv::Mat loadImage(const string &valid, const string &path, Logger &logger) {
+	if(valid != "true") {
+		return cv::Mat();
+	}
+	cv::Mat img = cv::imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+	if(!img.data) {
+		logger.logWarning("Couldn't open " + path + "; storing it as invalid.");
+	}
+	return img;
+}
+
+// Entry point
+int main(int argc, char ** argv)
+{
+	if(argc < 2) {
+		cerr << "Usage: " << argv[0] << " <recording dir> [config file]" << endl;
+		return 1;
+	}
+	string rec_path = string(argv[1]) + "/";
+	const char * config_fn = (argc > 2) ? argv[2] : DEFAULT_CONFIG_FILENAME;
+
+	Logger logger;
+	json loggerOptions = {
+		{"verbosity", 3},
+		{"stream", "cout"},
+		{"timestampPattern", "[%Y-%m-%d %X] "}
+	};
+	logger.init(loggerOptions);
+
+	// Load configuration options
+	string index_fn, rec_dir, container_fn, timestamp_pattern;
+	string cur_key = "";
+	try {
+		json options;
+		ifstream config_file(config_fn);
+		config_file >> options;
+		cur_key = "imageAcquisition";    json rec_play_section = options[cur_key];
+		cur_key = "imageRecordPlayback"; rec_play_section      = rec_play_section[cur_key];
+		cur_key = "indexFile";           index_fn              = rec_play_section[cur_key];
+		cur_key = "recDir";              rec_dir               = rec_play_section[cur_key];
+		cur_key = "containerFile";       container_fn          = rec_play_section[cur_key];
+		cur_key = "timestampPattern";    timestamp_pattern     = rec_play_section[cur_key];
+	} catch (exception &e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" from " << config_fn << ": "
+			 << e.what() << endl;
+		return 1;
+	}
+
+	ifstream index_file(rec_path + index_fn);
+	if(!index_file.is_open()) {
+		logger.logError("Couldn't open recording index file " + rec_path + index_fn);
+		return 1;
+	}
+
+	// Index lines are: timestamp, ms, valid, left file, valid, right file,
+	// valid, infrared file, auto gain values.  Infrared isn't carried over.
+	StereoRecordingWriter writer;
+	string line;
+	size_t line_num = 0;
+	while(getline(index_file, line)) {
+		++line_num;
+		vector<string> fields = splitTabs(line);
+		if(fields.size() < 6) {
+			if(!line.empty()) {
+				stringstream ss;
+				ss << "Skipping malformed line " << line_num << " of " << index_fn;
+				logger.logWarning(ss.str());
+			}
+			continue;
+		}
+
+		StereoRecordingFrame frame;
+		frame.acquisitionTime = parseTime(fields[0], fields[1], timestamp_pattern);
+		frame.frameId         = line_num; // The index has no frame IDs
+		frame.imgL            = loadImage(fields[2], rec_path + rec_dir + fields[3], logger);
+		frame.imgR            = loadImage(fields[4], rec_path + rec_dir + fields[5], logger);
+		frame.validL          = !frame.imgL.empty();
+		frame.validR          = !frame.imgR.empty();
+		frame.autoGainValues  = (fields.size() > 8) ? fields[8] : "";
+
+		if(!writer.isOpen()) {
+			// The recording takes its frame size from the first image
+			const cv::Mat * first = frame.validL ? &frame.imgL : frame.validR ? &frame.imgR : NULL;
+			if(first == NULL) { continue; }
+			if(!writer.open(rec_path + container_fn, first->cols, first->rows, &logger)) { return 1; }
+		}
+		if(!writer.append(frame)) {
+			return 1;
+		}
+	}
+
+	stringstream ss;
+	ss << "Wrote " << writer.getNumFrames() << " frames to " << rec_path << container_fn;
+	writer.close();
+	logger.logInfo(ss.str());
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+	depthEvaluator.cpp
+
+	Scores stereo point clouds against ground-truth depth.
+*/
+
+#include <depthEvaluator.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+void DepthEvaluator::init(json options, cv::Mat projection) {
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "outlierRelError";            outlierRelError        = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in evaluation section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	focalLenPx = projection.at<double>(0, 0);
+	cx         = projection.at<double>(0, 2);
+	cy         = projection.at<double>(1, 2);
+}
+
+void DepthEvaluator::beginProfile(string name, string alg_name) {
+	ProfileResult result;
+	result.name    = name;
+	result.algName = alg_name;
+	results.push_back(result);
+}
+
+void DepthEvaluator::addFrame(const ImageDataSet &data, PointCloudDataMessage * cloud,
+		chrono::steady_clock::duration processing_time) {
+	if(results.empty()) {
+		beginProfile("default", "");
+	}
+	ProfileResult &result = results.back();
+	result.frames++;
+	result.processingTime += processing_time;
+	if(cloud == NULL) {
+		return;
+	}
+	result.clouds++;
+	unsigned int num_points = cloud->getNumPointsThisMsg();
+	result.points += num_points;
+	if(data.depthTruth.empty()) {
+		result.pointsWithoutTruth += num_points;
+		return;
+	}
+
+	CloudPoint * points = cloud->getPointCloud();
+	for(unsigned int i = 0; i < num_points; ++i) {
+		double depth = points[i].getPointX();
+		if(depth <= 0) {
+			result.pointsWithoutTruth++;
+			continue;
+		}
+		int col = (int)lround(cx + focalLenPx * points[i].getPointY() / depth);
+		int row = (int)lround(cy + focalLenPx * points[i].getPointZ() / depth);
+		if(col < 0 || row < 0 || col >= data.depthTruth.cols || row >= data.depthTruth.rows) {
+			result.pointsWithoutTruth++;
+			continue;
+		}
+		float truth = data.depthTruth.at<float>(row, col);
+		if(truth <= 0) {
+			result.pointsWithoutTruth++;
+			continue;
+		}
+		float abs_error = fabs(depth - truth);
+		result.absErrors.push_back(abs_error);
+		result.relErrors.push_back(abs_error / truth);
+	}
+}
+
+// Nearest-rank.  Takes a copy, which it reorders.
+double DepthEvaluator::percentile(vector<float> values, double pct) {
+	if(values.empty()) { return 0; }
+	size_t idx = (size_t)ceil(pct / 100 * values.size());
+	idx = (idx == 0) ? 0 : idx - 1;
+	nth_element(values.begin(), values.begin() + idx, values.end());
+	return values[idx];
+}
+
+string DepthEvaluator::report() const {
+	stringstream ss;
+	ss << fixed << setprecision(2);
+	ss << left << setw(20) << "Profile" << setw(24) << "Algorithm" << right
+	   << setw(8)  << "frames"
+	   << setw(10) << "pts/frm"
+	   << setw(10) << "pts/s"
+	   << setw(9)  << "scored%"
+	   << setw(10) << "mean m"
+	   << setw(10) << "p50 m"
+	   << setw(10) << "p90 m"
+	   << setw(9)  << "p50 rel%"
+	   << setw(10) << "outlier%" << endl;
+	for(auto const &r : results) {
+		double proc_s = chrono::duration<double>(r.processingTime).count();
+		size_t scored = r.absErrors.size();
+		double mean_abs = 0;
+		unsigned long outliers = 0;
+		for(size_t i = 0; i < scored; ++i) {
+			mean_abs += r.absErrors[i];
+			if(r.relErrors[i] > outlierRelError) { outliers++; }
+		}
+		if(scored > 0) { mean_abs /= scored; }
+		ss << left << setw(20) << r.name << setw(24) << r.algName << right
+		   << setw(8)  << r.frames
+		   << setw(10) << (r.frames > 0 ? (double)r.points / r.frames : 0)
+		   << setw(10) << (proc_s > 0 ? r.points / proc_s : 0)
+		   << setw(9)  << (r.points > 0 ? 100.0 * scored / r.points : 0)
+		   << setw(10) << mean_abs
+		   << setw(10) << percentile(r.absErrors, 50)
+		   << setw(10) << percentile(r.absErrors, 90)
+		   << setw(9)  << 100 * percentile(r.relErrors, 50)
+		   << setw(10) << (scored > 0 ? 100.0 * outliers / scored : 0) << endl;
+	}
+	ss << "Points/s is over processing time alone.  Outliers are off by more than "
+	   << 100 * outlierRelError << "% of the true depth." << endl;
+	return ss.str();
+}
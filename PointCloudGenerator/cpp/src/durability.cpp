@@ -0,0 +1,172 @@
+/*
+	durability.cpp
+
+	Flushes the files written by PCG to storage from a background thread.
+*/
+
+#include <durability.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+using namespace std;
+using namespace std::chrono;
+
+void Durability::init(json options, Logger * lgr) {
+	logger = lgr;
+
+	// Load configuration options
+	string cur_key = "";
+	try {
+		int interval_ms = 0;
+		cur_key = "flushIntervalMs";     interval_ms         = options[cur_key];
+		cur_key = "flushThresholdBytes"; flushThresholdBytes = options[cur_key];
+		// A zero interval would have the flush thread spin
+		if(interval_ms <= 0) {
+			throw invalid_argument("durability.flushIntervalMs must be at least 1.");
+		}
+		flushInterval = milliseconds(interval_ms);
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in durability section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	start();
+}
+
+void Durability::start() {
+	if(!flushThread.joinable()) {
+		stopping = false;
+		flushThread = thread(&Durability::flushLoop, this);
+	}
+}
+
+void Durability::stop() {
+	if(flushThread.joinable()) {
+		{
+			lock_guard<mutex> lk(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+		flushThread.join();
+	}
+	for(auto &f : appendedFiles) {
+		close(f.fd);
+	}
+	appendedFiles.clear();
+}
+
+void Durability::trackAppendedFile(string path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		if(logger != NULL) {
+			stringstream ss;
+			ss << "Can't track " << path << " for flushing.  Error #" << errno;
+			logger->logWarning(ss.str());
+		}
+		return;
+	}
+	AppendedFile f = {path, fd, 0};
+	lock_guard<mutex> lk(lock);
+	appendedFiles.push_back(f);
+}
+
+void Durability::trackNewFile(string path) {
+	struct stat st;
+	size_t bytes = (stat(path.c_str(), &st) == 0) ? st.st_size : 0;
+	bool flush_now = false;
+	{
+		lock_guard<mutex> lk(lock);
+		newFiles.push_back(path);
+		pendingBytes += bytes;
+		flush_now = (flushThresholdBytes > 0 && pendingBytes >= flushThresholdBytes);
+	}
+	if(flush_now) {
+		wake.notify_all();
+	}
+}
+
+void Durability::flushLoop() {
+	unique_lock<mutex> lk(lock);
+	while(true) {
+		wake.wait_for(lk, flushInterval, [this]{
+			return stopping || (flushThresholdBytes > 0 && pendingBytes >= flushThresholdBytes);
+		});
+		bool last_pass = stopping;
+		lk.unlock();
+
+		bmFlush.start();
+		int num_files = 0;
+		size_t bytes = flushAll(num_files);
+		bmFlush.end(bytes);
+		if(num_files > 0 && logger != NULL) {
+			stringstream ss;
+			ss << "Flushed " << bytes << " bytes in " << num_files << " files in "
+			   << duration_cast<milliseconds>(bmFlush.getLastTime()).count() << "ms.";
+			logger->logDebug(ss.str());
+		}
+
+		lk.lock();
+		if(last_pass) { break; }
+	}
+}
+
+size_t Durability::flushAll(int &num_files) {
+	// Take ownership of the pending work, so writers aren't held up
+	// while we wait on storage.
+	list<string> new_files;
+	list<AppendedFile> appended_files;
+	{
+		lock_guard<mutex> lk(lock);
+		new_files.swap(newFiles);
+		appended_files = appendedFiles;
+		pendingBytes = 0;
+	}
+
+	size_t bytes = 0;
+	num_files = 0;
+	set<string> dirs;
+	for(auto const &path : new_files) {
+		int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0) { continue; }
+		struct stat st;
+		if(fstat(fd, &st) == 0) { bytes += st.st_size; }
+		fdatasync(fd);
+		close(fd);
+		num_files++;
+
+		// New files also need their directory entry on disk.
+		// dirname() may modify its argument, so give it a copy.
+		string path_copy = path;
+		dirs.insert(dirname(&path_copy[0]));
+	}
+	for(auto const &dir : dirs) {
+		int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+		if(fd < 0) { continue; }
+		fsync(fd);
+		close(fd);
+	}
+
+	// Only flush appended files that have grown since last time
+	list<pair<int, off_t>> synced;
+	for(auto const &f : appended_files) {
+		struct stat st;
+		if(fstat(f.fd, &st) != 0 || st.st_size == f.syncedBytes) { continue; }
+		fdatasync(f.fd);
+		bytes += st.st_size - f.syncedBytes;
+		num_files++;
+		synced.push_back(make_pair(f.fd, st.st_size));
+	}
+	{
+		lock_guard<mutex> lk(lock);
+		for(auto const &s : synced) {
+			for(auto &f : appendedFiles) {
+				if(f.fd == s.first) { f.syncedBytes = s.second; }
+			}
+		}
+	}
+
+	return bytes;
+}
@@ -0,0 +1,203 @@
+/*
+
+Self-check for the FAST corner detector.  Runs the corner test, whatever
+SIMD kernel this build uses, against the scalar reference on every pixel
+of a set of synthetic images, then checks detect() against a plain
+scalar detector with the same suppression, both on whole images and on
+bands of rows.  Prints each mismatch and exits non-zero if there are
+any.
+
+Usage: fast_self_test
+
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <random>
+#include <iostream>
+#include <sstream>
+#include <opencv2/core/core.hpp>
+#include "ptCloudGenAlgs/fastDetector.h"
+
+using namespace std;
+
+static const int THRESHOLDS[] = {0, 1, 10, 20, 40, 100, 254, 255};
+static const int BORDER_PX = 31; // As the ORB algorithms use it
+
+// Widths that leave tails after the 32- and 16-pixel kernels
+static const int IMG_WIDTH = 203, IMG_HEIGHT = 97;
+
+typedef set<tuple<int, int, int>> CornerSet; // y, x, score
+
+// Synthetic test images: noise, with and without saturated pixels, and
+// shapes with sharp corners on flat and noisy backgrounds
+static vector<pair<string, cv::Mat>> makeImages() {
+	mt19937 rng(12345);
+	uniform_int_distribution<int> any(0, 255), coin(0, 3), small(0, 15);
+	vector<pair<string, cv::Mat>> images;
+
+	cv::Mat noise(IMG_HEIGHT, IMG_WIDTH, CV_8UC1);
+	for(int y = 0; y < noise.rows; ++y) {
+		for(int x = 0; x < noise.cols; ++x) { noise.at<uint8_t>(y, x) = (uint8_t)any(rng); }
+	}
+	images.push_back(make_pair(string("uniform noise"), noise));
+
+	cv::Mat extremes(IMG_HEIGHT, IMG_WIDTH, CV_8UC1);
+	for(int y = 0; y < extremes.rows; ++y) {
+		for(int x = 0; x < extremes.cols; ++x) {
+			int c = coin(rng);
+			extremes.at<uint8_t>(y, x) = (uint8_t)(c == 0 ? 0 : c == 1 ? 255 : c == 2 ? small(rng) : 255 - small(rng));
+		}
+	}
+	images.push_back(make_pair(string("near-saturated noise"), extremes));
+
+	for(int noisy = 0; noisy < 2; ++noisy) {
+		cv::Mat shapes(IMG_HEIGHT, IMG_WIDTH, CV_8UC1);
+		for(int y = 0; y < shapes.rows; ++y) {
+			for(int x = 0; x < shapes.cols; ++x) {
+				shapes.at<uint8_t>(y, x) = (uint8_t)(128 + (noisy ? small(rng) - 8 : 0));
+			}
+		}
+		uniform_int_distribution<int> pos_x(0, IMG_WIDTH - 1), pos_y(0, IMG_HEIGHT - 1), size(2, 20);
+		for(int i = 0; i < 60; ++i) {
+			cv::Rect r(pos_x(rng), pos_y(rng), size(rng), size(rng));
+			shapes(r & cv::Rect(0, 0, IMG_WIDTH, IMG_HEIGHT)).setTo(any(rng));
+		}
+		images.push_back(make_pair(string(noisy ? "rectangles on noise" : "rectangles"), shapes));
+	}
+	return images;
+}
+
+// Compares the corner test on every pixel it can be run on
+static int checkMarkCorners(const string &name, const cv::Mat &img, int threshold) {
+	int offsets[FastDetector::CIRCLE_SIZE];
+	FastDetector::circleOffsets(img.step, offsets);
+	const int r = FastDetector::RADIUS;
+	vector<uint8_t> mask(img.cols);
+	int mismatches = 0;
+	for(int y = r; y < img.rows - r; ++y) {
+		const uint8_t * row = img.ptr<uint8_t>(y);
+		FastDetector::markCorners(row, img.step, r, img.cols - r, threshold, mask.data());
+		for(int x = r; x < img.cols - r; ++x) {
+			bool expected = FastDetector::isCorner(row + x, offsets, threshold);
+			if((mask[x] != 0) != expected) {
+				if(mismatches++ < 5) {
+					printf("  %s, threshold %d: corner test differs at (%d, %d): kernel %d, scalar %d\n",
+						name.c_str(), threshold, x, y, mask[x] != 0, expected);
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+// The whole detector, one pixel at a time: scores for every corner, then
+// keep those that beat all eight neighbours
+static CornerSet referenceDetect(const cv::Mat &img, int threshold, int border) {
+	int offsets[FastDetector::CIRCLE_SIZE];
+	FastDetector::circleOffsets(img.step, offsets);
+	const int r = FastDetector::RADIUS;
+	cv::Mat scores = cv::Mat::zeros(img.size(), CV_32SC1); // One more than the score; 0 for none
+	for(int y = r; y < img.rows - r; ++y) {
+		for(int x = r; x < img.cols - r; ++x) {
+			const uint8_t * p = img.ptr<uint8_t>(y) + x;
+			if(FastDetector::isCorner(p, offsets, threshold)) {
+				scores.at<int>(y, x) = FastDetector::cornerScore(p, offsets) + 1;
+			}
+		}
+	}
+	CornerSet corners;
+	border = max(border, r);
+	for(int y = border; y < img.rows - border; ++y) {
+		for(int x = border; x < img.cols - border; ++x) {
+			int s = scores.at<int>(y, x);
+			if(s == 0) { continue; }
+			bool best = true;
+			for(int dy = -1; dy <= 1 && best; ++dy) {
+				for(int dx = -1; dx <= 1; ++dx) {
+					if((dy != 0 || dx != 0) && scores.at<int>(y + dy, x + dx) >= s) { best = false; break; }
+				}
+			}
+			if(best) { corners.insert(make_tuple(y, x, s - 1)); }
+		}
+	}
+	return corners;
+}
+
+static CornerSet toSet(const vector<cv::KeyPoint> &kps) {
+	CornerSet corners;
+	for(const auto &kp : kps) {
+		corners.insert(make_tuple((int)kp.pt.y, (int)kp.pt.x, (int)kp.response));
+	}
+	return corners;
+}
+
+static int compareSets(const string &what, const CornerSet &got, const CornerSet &expected) {
+	int mismatches = 0;
+	for(const auto &c : expected) {
+		if(got.count(c)) { continue; }
+		if(mismatches++ < 5) {
+			printf("  %s: missing corner at (%d, %d), score %d\n", what.c_str(), get<1>(c), get<0>(c), get<2>(c));
+		}
+	}
+	for(const auto &c : got) {
+		if(expected.count(c)) { continue; }
+		if(mismatches++ < 5) {
+			printf("  %s: extra corner at (%d, %d), score %d\n", what.c_str(), get<1>(c), get<0>(c), get<2>(c));
+		}
+	}
+	return mismatches;
+}
+
+// Entry point
+int main(int argc, char ** argv)
+{
+#if defined(__AVX2__)
+	const char * kernel = "AVX2";
+#elif defined(__SSE2__)
+	const char * kernel = "SSE2";
+#elif defined(__aarch64__)
+	const char * kernel = "NEON";
+#else
+	const char * kernel = "scalar only";
+#endif
+	printf("FAST self-test, %s corner kernel.\n", kernel);
+
+	int failures = 0;
+	FastDetector detector;
+	for(const auto &named : makeImages()) {
+		const string &name = named.first;
+		const cv::Mat &img = named.second;
+		for(int threshold : THRESHOLDS) {
+			int mismatches = checkMarkCorners(name, img, threshold);
+
+			CornerSet expected = referenceDetect(img, threshold, BORDER_PX);
+			vector<cv::KeyPoint> kps;
+			detector.detect(img, 0, img.rows, threshold, BORDER_PX, kps);
+			stringstream ss;
+			ss << name << ", threshold " << threshold;
+			mismatches += compareSets(ss.str() + ", whole image", toSet(kps), expected);
+
+			// Bands of uneven heights, as numBins might give
+			kps.clear();
+			for(int first = 0, h = 1; first < img.rows; first += h, h += 3) {
+				detector.detect(img, first, min(first + h, img.rows), threshold, BORDER_PX, kps);
+			}
+			mismatches += compareSets(ss.str() + ", in bands", toSet(kps), expected);
+
+			printf("%-24s threshold %3d: %5lu corners, %s\n", name.c_str(), threshold,
+				(unsigned long)expected.size(), mismatches ? "MISMATCH" : "ok");
+			failures += (mismatches != 0);
+		}
+	}
+
+	if(failures) {
+		printf("%d cases failed.\n", failures);
+		return 1;
+	}
+	printf("All cases passed.\n");
+	return 0;
+}
@@ -0,0 +1,88 @@
+/*
+	framePool.cpp
+
+	Preallocated, page-aligned slots for camera images.
+*/
+
+#include <framePool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdexcept>
+using namespace std;
+
+void FramePool::init(json options, Logger * lgr) {
+	logger = lgr;
+
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "numSlots";  numSlots  = options[cur_key];
+		cur_key = "slotBytes"; slotBytes = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in frame pool section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	// Every slot starts on a page boundary
+	size_t page_bytes = sysconf(_SC_PAGESIZE);
+	slotBytes = (slotBytes + page_bytes - 1) / page_bytes * page_bytes;
+	void * mem = NULL;
+	if(numSlots > 0 && posix_memalign(&mem, page_bytes, numSlots * slotBytes) != 0) {
+		throw runtime_error("posix_memalign(): Failed to allocate camera frame pool.");
+	}
+	storage = make_shared<Storage>();
+	storage->mem = (unsigned char *)mem;
+	for(size_t i = 0; i < numSlots; ++i) {
+		storage->freeSlots.push_back(storage->mem + i * slotBytes);
+	}
+	highWaterMark = 0;
+
+	stringstream ss;
+	ss << "Allocated " << numSlots << " camera frame slots of " << slotBytes << " bytes.";
+	logger->logDebug(ss.str());
+}
+
+FramePool::Slot FramePool::claim(size_t bytes) {
+	unsigned char * slot = NULL;
+	size_t in_use = 0;
+	bool new_high = false;
+	shared_ptr<Storage> st = storage;
+	if(!st) { return Slot(); } // Not initialised
+	{
+		lock_guard<mutex> lk(st->lock);
+		if(bytes <= slotBytes && !st->freeSlots.empty()) {
+			slot = st->freeSlots.back();
+			st->freeSlots.pop_back();
+			in_use = numSlots - st->freeSlots.size();
+			bmOccupancy.count(in_use);
+			if(in_use > highWaterMark) {
+				highWaterMark = in_use;
+				new_high = true;
+			}
+		} else {
+			bmStarved.count();
+		}
+	}
+
+	stringstream ss;
+	if(slot == NULL) {
+		if(bytes > slotBytes) {
+			ss << "Camera image of " << bytes << " bytes doesn't fit a " << slotBytes << " byte frame slot.";
+		} else {
+			ss << "All " << numSlots << " camera frame slots in use; dropping image.";
+		}
+		logger->logWarning(ss.str());
+		return Slot();
+	}
+	if(new_high) {
+		ss << "Camera frame slots in use reached " << in_use << " of " << numSlots << ".";
+		logger->logDebug(ss.str());
+	}
+	// Back to the storage it came from, which this keeps alive till then
+	return Slot(slot, [st](unsigned char * s){
+		lock_guard<mutex> lk(st->lock);
+		st->freeSlots.push_back(s);
+	});
+}
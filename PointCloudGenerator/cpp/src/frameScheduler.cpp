@@ -0,0 +1,80 @@
+/*
+	frameScheduler.cpp
+
+	Paces the frame loop against absolute deadlines.
+*/
+
+#include <frameScheduler.h>
+using namespace std;
+using namespace std::chrono;
+
+void FrameScheduler::init(json options, Logger * lgr) {
+	logger = lgr;
+
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "maxFps";        maxFps        = options[cur_key];
+		cur_key = "playbackSpeed"; playbackSpeed = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in frame scheduling section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	if(maxFps < 0)        { maxFps = 0; }
+	if(playbackSpeed < 0) { playbackSpeed = 0; }
+}
+
+bool FrameScheduler::isPacing(bool playback) {
+	return (maxFps > 0) || (playback && playbackSpeed > 0);
+}
+
+steady_clock::duration FrameScheduler::getFramePeriod(system_clock::duration recorded_delay) {
+	steady_clock::duration period(0);
+	if(playbackSpeed > 0 && recorded_delay > system_clock::duration(0)) {
+		period = duration_cast<steady_clock::duration>(
+			duration<double>(recorded_delay) / playbackSpeed);
+	}
+	if(maxFps > 0) {
+		steady_clock::duration min_period = duration_cast<steady_clock::duration>(
+			duration<double>(1.0 / maxFps));
+		if(period < min_period) { period = min_period; }
+	}
+	return period;
+}
+
+void FrameScheduler::waitForNextFrame(bool playback, system_clock::duration recorded_delay) {
+	steady_clock::time_point now = steady_clock::now();
+	if(resetRequested.exchange(false)) { haveDeadline = false; }
+	if(!isPacing(playback)) {
+		haveDeadline = false;
+		return;
+	}
+
+	steady_clock::duration period = getFramePeriod(playback ? recorded_delay : system_clock::duration(0));
+	if(!haveDeadline || period == steady_clock::duration(0)) {
+		// First frame since starting, or no delay wanted; nothing to be late for.
+		lastDeadline = now;
+		haveDeadline = true;
+		return;
+	}
+
+	steady_clock::time_point deadline = lastDeadline + period;
+	if(deadline < now) {
+		// Don't try to catch up by rushing the following frames, just
+		// start counting from here.
+		bmMissedDeadlines.count();
+		// Overload misses every frame; the benchmark summary has the count
+		stringstream ss;
+		ss << "Missed frame deadline by " << duration_cast<milliseconds>(now - deadline).count()
+		   << "ms (" << bmMissedDeadlines.getIterations() << " missed so far).";
+		logger->logDebug(ss.str());
+		lastDeadline = now;
+	} else {
+		bmSleeping.start();
+		this_thread::sleep_until(deadline);
+		bmSleeping.end();
+		lastDeadline = deadline;
+	}
+}
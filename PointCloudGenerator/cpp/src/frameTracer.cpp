@@ -0,0 +1,146 @@
+/*
+	frameTracer.cpp
+
+	Per-frame span tracing, written out as Chrome trace_event JSON.
+*/
+
+#include <frameTracer.h>
+#include <fstream>
+#include <cstring>
+using namespace std;
+using namespace std::chrono;
+
+const size_t FrameTracer::MAX_NAME_CHARS;
+
+bool                               FrameTracer::enabled = false;
+vector<FrameTracer::Span>          FrameTracer::ring;
+atomic<unsigned long>              FrameTracer::nextSlot(0);
+atomic<unsigned int>               FrameTracer::nextThreadNum(1);
+string                             FrameTracer::outputPath = "";
+steady_clock::time_point           FrameTracer::epoch = steady_clock::now();
+mutex                              FrameTracer::threadNamesLock;
+vector<pair<unsigned int, string>> FrameTracer::threadNames;
+
+static thread_local unsigned long currentFrameId = FrameTracer::NO_FRAME;
+static thread_local unsigned int  currentThreadNum = 0; // 0 until assigned
+
+void FrameTracer::init(json options) {
+	// Load configuration options
+	string cur_key = "";
+	size_t capacity = 0;
+	try {
+		string file_name, path;
+		cur_key = "enabled";      enabled   = options[cur_key];
+		cur_key = "ringCapacity"; capacity  = options[cur_key];
+		cur_key = "fileName";     file_name = options[cur_key];
+		cur_key = "path";         path      = options[cur_key];
+		outputPath = path + file_name;
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in tracing section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	if(capacity == 0) { enabled = false; }
+	if(enabled) {
+		// Allocate everything up front, so recording never allocates
+		ring = vector<Span>(capacity);
+	}
+	nextSlot = 0;
+	epoch = steady_clock::now();
+}
+
+unsigned int FrameTracer::getThreadNum() {
+	if(currentThreadNum == 0) {
+		currentThreadNum = nextThreadNum++;
+	}
+	return currentThreadNum;
+}
+
+void FrameTracer::setThreadName(string name) {
+	lock_guard<mutex> lk(threadNamesLock);
+	threadNames.push_back(make_pair(getThreadNum(), name));
+}
+
+void FrameTracer::setCurrentFrame(unsigned long frame_id) {
+	currentFrameId = frame_id;
+}
+
+unsigned long FrameTracer::getCurrentFrame() {
+	return currentFrameId;
+}
+
+void FrameTracer::record(const char * name, steady_clock::time_point start,
+		steady_clock::time_point end) {
+	record(currentFrameId, name, start, end);
+}
+
+void FrameTracer::record(unsigned long frame_id, const char * name,
+		steady_clock::time_point start, steady_clock::time_point end) {
+	if(!enabled) { return; }
+	Span &span = ring[nextSlot++ % ring.size()];
+	// If the ring has wrapped right round onto a writer that's still going,
+	// drop this span rather than share the slot
+	unsigned long seq = span.seq.load(memory_order_relaxed);
+	if((seq & 1) || !span.seq.compare_exchange_strong(seq, seq + 1, memory_order_acquire)) { return; }
+	atomic_thread_fence(memory_order_release);
+	SpanData &d = span.data;
+	strncpy(d.name, name, MAX_NAME_CHARS - 1);
+	d.name[MAX_NAME_CHARS - 1] = '\0';
+	d.frameId   = frame_id;
+	d.threadNum = getThreadNum();
+	d.start     = start;
+	d.end       = end;
+	span.seq.store(seq + 2, memory_order_release);
+}
+
+// Only quotes and backslashes are expected in span names
+static string escapeJson(const char * s) {
+	string out;
+	for(; *s != '\0'; ++s) {
+		if(*s == '"' || *s == '\\') { out += '\\'; }
+		out += *s;
+	}
+	return out;
+}
+
+string FrameTracer::dump() {
+	if(!enabled || outputPath == "") { return ""; }
+
+	// Oldest span first
+	unsigned long end_slot = nextSlot;
+	unsigned long begin_slot = (end_slot > ring.size()) ? end_slot - ring.size() : 0;
+
+	ofstream out(outputPath, ofstream::out | ofstream::trunc);
+	if(!out.is_open()) { return ""; }
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+	{
+		lock_guard<mutex> lk(threadNamesLock);
+		for(auto const &tn : threadNames) {
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tn.first
+			    << ",\"args\":{\"name\":\"" << escapeJson(tn.second.c_str()) << "\"}}," << endl;
+		}
+	}
+	for(unsigned long i = begin_slot; i < end_slot; ++i) {
+		// Skip slots mid-write, or rewritten while we copied them
+		const Span &slot = ring[i % ring.size()];
+		unsigned long seq = slot.seq.load(memory_order_acquire);
+		if(seq & 1) { continue; }
+		SpanData span = slot.data;
+		atomic_thread_fence(memory_order_acquire);
+		if(slot.seq.load(memory_order_relaxed) != seq) { continue; }
+		if(span.name[0] == '\0') { continue; }
+		out << "{\"name\":\"" << escapeJson(span.name) << "\",\"cat\":\"pcg\",\"ph\":\"X\""
+		    << ",\"pid\":1,\"tid\":" << span.threadNum
+		    << ",\"ts\":"  << duration_cast<microseconds>(span.start - epoch).count()
+		    << ",\"dur\":" << duration_cast<microseconds>(span.end - span.start).count()
+		    << ",\"args\":{\"frame\":" << span.frameId << "}}," << endl;
+	}
+	// A trailing comma isn't valid JSON, so finish with a harmless marker
+	out << "{\"name\":\"trace dumped\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":"
+	    << duration_cast<microseconds>(steady_clock::now() - epoch).count() << "}" << endl;
+	out << "]}" << endl;
+	out.close();
+	return outputPath;
+}
@@ -8,180 +8,25 @@ This class handles acquiring images from the various cameras in the OG system.
 */
 
 #include <imageAcquisition.h>
-using namespace FlyCapture2;
+#include <cameraSources/flyCapSource.h>
+#include <cameraSources/playbackSource.h>
+#include <cameraSources/syntheticSource.h>
 using namespace std;
 
-unsigned long ImageDataSet::getTimeAcquiredS() {
-	chrono::system_clock::duration acq_timestamp = acquisitionTime.time_since_epoch();
-	return chrono::duration_cast<chrono::seconds>(acq_timestamp).count();
-}
-
-unsigned long ImageDataSet::getTimeAcquiredMs() {
-	chrono::system_clock::duration acq_timestamp = acquisitionTime.time_since_epoch();
-	return chrono::duration_cast<chrono::milliseconds>(acq_timestamp).count() % 1000;
-}
-
-unsigned long ImageDataSet::getDurationSinceAcquiredMs() {
-	chrono::system_clock::duration duration_since_acq = chrono::system_clock::now() - acquisitionTime;
-	return chrono::duration_cast<chrono::milliseconds>(duration_since_acq).count();
-}
-
-static void discardImage( Image* pImage, const void* pCallbackData ) {
-	;
-}
-
 const string ImageAcquisition::REC_EXT = "tif";
 
-chrono::time_point<chrono::system_clock> ImageAcquisition::readTimeFromTabSepInput(istream &input) {
-	// Assumes the next two tokens in the input stream are:
-	// 2017-01-11_192901	489
-	// Where the first token is in the timestampPattern format and the second is milliseconds.
-	int millis;
-	std::tm time_s = {};
-	input >> std::get_time(&time_s, timestampPattern.c_str());
-	input >> millis;
-	chrono::time_point<chrono::system_clock> timestamp = chrono::system_clock::from_time_t(std::mktime(&time_s));
-	timestamp += chrono::milliseconds(millis);
-	
-	return timestamp;
-}
-
-bool ImageAcquisition::initPtGreyCam (unsigned int sn, list<pair<string, double>> cam_props, 
-		Camera &cam, CameraInfo &camInfo) {
-	Error error;
-	// Find camera
-	PGRGuid camGuid;
-	error = mgr.GetCameraFromSerialNumber(sn, &camGuid);
-	if (error != PGRERROR_OK)
-	{
-		stringstream ss;
-		ss << "Failed to find camera for SN " << sn;
-		logger->logError(ss.str());
-		return false;
-	}
-	
-	error = cam.Connect(&camGuid);
-	if (error != PGRERROR_OK)
-	{
-		stringstream ss;
-		ss << "Failed to connect to camera #" << sn;
-		logger->logError(ss.str());
-		return false;
-	}
-	
-	// Get the camera info and print it out
-	error = cam.GetCameraInfo(&camInfo);
-	if ( error != PGRERROR_OK )
-	{
-		stringstream ss;
-		ss << "Failed to find camera info for SN " << sn;
-		logger->logWarning(ss.str());
-	}
-	
-	// Send properties to the camera
-	for(auto const &it : cam_props) {
-		Property prop;
-		prop.type = propTypeFromString(it.first);
-
-		//// For testing
-		// error = cam.GetProperty(&prop);
-		// if ( error == PGRERROR_OK )
-		// {
-			// stringstream ss;
-			// ss << "Old value of " << it.first << ":"
-				// << "\nprop.type           = " << prop.type          
-				// << "\nprop.present        = " << prop.present       
-				// << "\nprop.absControl     = " << prop.absControl    
-				// << "\nprop.onePush        = " << prop.onePush       
-				// << "\nprop.onOff          = " << prop.onOff         
-				// << "\nprop.autoManualMode = " << prop.autoManualMode
-				// << "\nprop.valueA         = " << prop.valueA        
-				// << "\nprop.valueB         = " << prop.valueB        
-				// << "\nprop.absValue       = " << prop.absValue      
-			// << endl;
-			// logger->logInfo(ss.str());
-		// }
-
-		prop.absValue = it.second; // Not absolute in the mathematical sense.
-		prop.absControl = true; // Use absValue, not valueA (valueA is in "ticks", absValue is in a human-readable unit)
-		prop.onOff = true; // Use this property
-		prop.autoManualMode = false; // Manual control for now; may be set to auto later.
-		
-		error = cam.SetProperty(&prop);
-		stringstream ss;
-		if ( error != PGRERROR_OK ) {
-			ss << "Failed to set camera " << it.first << " to " << it.second;
-			logger->logError(ss.str());
-		} else {
-			ss << "Succesfully set camera " << it.first << " to " << it.second;
-			logger->logInfo(ss.str());
-		}
-	}
-	
-	// Configuire camera trigger mode so that it only captures when commanded.
-	// Currently using Overlapped Exposure Readout Trigger.
-	// (Mode 14, section 7.1.5, page 42 of the Chameleon Technical Reference Manual)
-	TriggerMode camTrigMode;
-	camTrigMode.onOff = true;
-	camTrigMode.source = 0;// No pins, software only
-	camTrigMode.mode = 14;
-	error = cam.SetTriggerMode(&camTrigMode);
-	if ( error != PGRERROR_OK )
-	{
-		stringstream ss;
-		ss << "Failed to set trigger mode for SN " << sn;
-		logger->logWarning(ss.str());
-	}
-	
-	return true;
-}
-void ImageAcquisition::startPtGreyCam(Camera &cam, CameraCallbackItems* cbItems) {
-	Error error; // TODO: error handling
-	error = cam.StartCapture(&discardImage);
-	if ( error == PGRERROR_ISOCH_BANDWIDTH_EXCEEDED )
-	{ logger->logError("Bandwidth exceeded; can't start image capture."); }
-	else if ( error != PGRERROR_OK )
-	{ logger->logError("Failed to start image capture"); }
-	else if ( error == PGRERROR_OK )
-	{
-		// For some reason, the first trigger often fails.
-		// As a workaround, trigger once here.
-		error = cam.FireSoftwareTrigger();
-		if(error != PGRERROR_OK)
-		{ logger->logWarning("Failed to trigger camera while starting."); }
-		// Need to delay a bit for it to work.  Ideally we'd be doing some
-		// sort of threading, but the core idea is to tolerate one or more
-		// cameras silently failing to acquire.
-		this_thread::sleep_for(milliseconds(1000));
-		// cam.SetCallback(NULL) doesn't work so we just
-		// restart the capture without a callback.
-		error = cam.StopCapture();
-		if(error != PGRERROR_OK)
-		{ logger->logWarning("Failed to restart	camera."); }
-		error = cam.StartCapture(flyCapImgEvent, cbItems);
-		if(error != PGRERROR_OK)
-		{ logger->logWarning("Failed to restart	camera."); }
-	}
-}
-void ImageAcquisition::stopPtGreyCam (Camera &cam) {
-	Error error; // TODO: error handling
-	error = cam.StopCapture();
-}
-
-void ImageAcquisition::init(json options, Logger * lgr) {
-	Error error; // TODO: error handling
+void ImageAcquisition::init(json options, Logger * lgr, Durability * dur) {
 	logger = lgr;
+	durability = dur;
 	
 	// Load configuration options
 	string index_fn;
 	string data_path = "~";
 	string rec_dir = "~";
-	string playback_path = "~";
+	string container_fn;
+	string source_name;
 	string cur_key = "";
-	list<pair<string, double>> cam_props;
 	try {
-		cur_key = "leftCamSn";                  leftVisibleCamSn       = options[cur_key];
-		cur_key = "rightCamSn";                 rightVisibleCamSn      = options[cur_key];
 		cur_key = "imageRecordPlayback"; json   rec_play_section       = options[cur_key];
 		cur_key = "path";                       data_path              = options[cur_key];
 		cur_key = "mode";                string mode_string            = rec_play_section[cur_key];
@@ -189,29 +34,19 @@ void ImageAcquisition::init(json options, Logger * lgr) {
 		playbackEnabled = (mode_string == "playback");
 		cur_key = "indexFile";                  index_fn               = rec_play_section[cur_key];
 		cur_key = "recDir";                     rec_dir                = rec_play_section[cur_key];
-		cur_key = "playbackPath";               playback_path          = rec_play_section[cur_key];
 		cur_key = "timestampPattern";           timestampPattern       = rec_play_section[cur_key];
-		cur_key = "visibleLightCamProps"; json  cam_props_section      = options[cur_key];
+		cur_key = "format";              string format_string          = rec_play_section[cur_key];
+		recordToContainer = (format_string == "container");
+		cur_key = "containerFile";              container_fn           = rec_play_section[cur_key];
+		cur_key = "cameraSource";               source_name            = options[cur_key];
 		cur_key = "flipImgL";                   flipImgL               = options[cur_key];
 		cur_key = "flipImgR";                   flipImgR               = options[cur_key];
 		cur_key = "imgFlipCodeL";               imgFlipCodeL           = options[cur_key];
 		cur_key = "imgFlipCodeR";               imgFlipCodeR           = options[cur_key];
-		cur_key = "visibleLightCamProps";
-		for(auto const & cam_prop: cam_props_section) {
-			// Properties are listed as "name", value, "unit".  
-			// Units are there for the benefit of the configuration file editor.
-			pair<string, double> prop;
-			prop.first  = cam_prop[0];
-			prop.second = cam_prop[1];
-			cam_props.push_back(prop);
-			
-			// Some properties may be set to have the camera control them automatically
-			string auto_or_man = cam_prop[3];
-			if(auto_or_man.compare("auto") == 0) {
-				autoControlledProps.push_back(propTypeFromString(cam_prop[0]));
-				autoGainControlEnabled = true;
-			}
-		}
+		cur_key = "foldFlipsIntoRectification"; foldFlips              = options[cur_key];
+		cur_key = "ingest";                     ingestWindow.init(options[cur_key]);
+		cur_key = "framePool";           json   frame_pool_section     = options[cur_key];
+		framePool.init(frame_pool_section, logger);
 	} catch (domain_error e) {
 		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
 			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: "
@@ -220,7 +55,23 @@ void ImageAcquisition::init(json options, Logger * lgr) {
 		return;
 	}
 	
-	if(recordEnabled) {
+	// Playback replaces whichever source is configured
+	if(playbackEnabled) {
+		source.reset(new PlaybackSource(bms));
+	} else if(source_name == "flycapture") {
+		source.reset(new FlyCapSource(bms));
+	} else if(source_name == "synthetic") {
+		source.reset(new SyntheticSource());
+	} else {
+		logger->logError("Unknown camera source \"" + source_name + "\"");
+		throw invalid_argument("Unknown camera source \"" + source_name + "\"");
+	}
+	logger->logDebug(playbackEnabled ? "Camera source: playback" : "Camera source: " + source_name);
+	
+	if(recordEnabled && recordToContainer) {
+		containerFilename = data_path + container_fn;
+		logger->logDebug("Will record images to this file: " + containerFilename);
+	} else if(recordEnabled) {
 		folderName = data_path + rec_dir;
 		string index_filename = data_path + index_fn;
 		logger->logDebug("Will record images to this folder: " + folderName);
@@ -234,284 +85,145 @@ void ImageAcquisition::init(json options, Logger * lgr) {
 		recIndexFile.open(index_filename.c_str(), ios::out | ios::app);
 		if(!recIndexFile.is_open())
 		{ logger->logError("Couldn't open recording index file " + index_filename); }
-	} else if (playbackEnabled) {
-		folderName = playback_path + rec_dir;
-		string index_filename = playback_path + index_fn;
-		logger->logDebug("Will play images from this folder: " + folderName);
-		logger->logDebug("Will play this index file: " + index_filename);
-		
-		playIndexFile.open(index_filename.c_str());
-		if(!playIndexFile.is_open())
-		{ logger->logError("Couldn't open recording index file " + index_filename); }
-
-		// Note the start time, from which we'll compute deltas.
-		lastFrameTime = readTimeFromTabSepInput(playIndexFile);
-		time_t tt = chrono::system_clock::to_time_t(lastFrameTime);
-		stringstream ss;
-		ss << "Selected recording begins at ";
-		ss << put_time(localtime(&tt), timestampPattern.c_str());
-		logger->logDebug(ss.str());
-		playIndexFile.seekg(0);//rewind
-		playbackComplete = false;
-		playedFirstFrame = false;
-	}
-
-	unsigned int numCams = 0;
-	error = mgr.GetNumOfCameras(&numCams);
-	if (error != PGRERROR_OK)
-	{
-		logger->logError("Failed to count cameras");
-	}
-	stringstream ss;
-	ss << "See " << numCams << " cameras.";
-	logger->logDebug(ss.str());
-	
-	bool success = initPtGreyCam(leftVisibleCamSn , cam_props, camL, camInfoL);
-	ss.str(""); ss.clear();
-	ss  << "Left  camera: "
-		<< camInfoL.vendorName << ", "
-		<< camInfoL.modelName  << ", " 
-		<< camInfoL.serialNumber;
-	if(success) {
-		logger->logInfo(ss.str());
-	} else {
-		logger->logWarning("Couldn't connect to Left camera.  Won't get images from it.");
-	}
-	camLConnected = success;
-
-	success = initPtGreyCam(rightVisibleCamSn, cam_props, camR, camInfoR);
-	ss.str(""); ss.clear();
-	ss  << "Right camera: "
-		<< camInfoR.vendorName << ", "
-		<< camInfoR.modelName  << ", " 
-		<< camInfoR.serialNumber;
-	if(success) {
-		logger->logInfo(ss.str());
-	} else {
-		logger->logWarning("Couldn't connect to Right camera.  Won't get images from it.");
+		else
+		{ durability->trackAppendedFile(index_filename); }
 	}
-	camRConnected = success;
-	
-	
-	// With automatic gain control, we set the left camera to automatically
-	// determine its own gain.  Then we copy that value to the right camera.
-	if(autoGainControlEnabled && camLConnected) {
-		for(auto const &pt : autoControlledProps) {
-			Property prop;
-			prop.type = pt;
-			prop.onOff = true; // Use this property
-			prop.autoManualMode = true; // Automatic control
-			error = camL.SetProperty(&prop);
-			if ( error != PGRERROR_OK ) {
-				logger->logError("Failed to enable auto gain control on left camera.");
-				// Don't try to copy over parameters later
-				autoGainControlEnabled = false;
-			} else {
-				// All good
-			}
-		}
-	} else {
-		// Don't try to copy over parameters later
-		autoGainControlEnabled = false;
+	if(recordEnabled) {
+		// Note how the frames are stored, so playback knows whether to flip them
+		json rec_info;
+		rec_info["format"]        = recordToContainer ? "container" : "tiff";
+		rec_info["framesFlipped"] = !foldFlips;
+		rec_info["flipImgL"]      = flipImgL;
+		rec_info["flipImgR"]      = flipImgR;
+		rec_info["imgFlipCodeL"]  = imgFlipCodeL;
+		rec_info["imgFlipCodeR"]  = imgFlipCodeR;
+		string info_filename = data_path + PlaybackSource::REC_INFO_FILENAME;
+		ofstream info_file(info_filename);
+		info_file << rec_info.dump(1) << endl;
+		info_file.close();
+		durability->trackNewFile(info_filename);
 	}
 	
-	// Initialize semaphores
-	sem_init(&imageWaitL, 0, 0);
-	sem_init(&imageWaitR, 0, 0);
-	cbItemsL.pSem = &imageWaitL;
-	cbItemsR.pSem = &imageWaitR;
-	cbItemsL.logger = logger;
-	cbItemsR.logger = logger;
+	source->init(options, logger, &framePool);
 }
 
 void ImageAcquisition::start() {
-	if(playbackEnabled) { 
-		playIndexFile.clear();
-		playIndexFile.seekg(0);
-		playbackComplete = false;
-		playedFirstFrame = false;
-	} else {
-		if(camLConnected) { startPtGreyCam(camL, &cbItemsL); }
-		if(camRConnected) { startPtGreyCam(camR, &cbItemsR); }
-		// TODO: start IR cam
-		// TODO: error handling
-	}
+	source->start();
 	running = true;
 }
 
 void ImageAcquisition::stop() {
-	if(camLConnected) { stopPtGreyCam(camL); }
-	if(camRConnected) { stopPtGreyCam(camR); }
-	// TODO: stop IR cam
-	// TODO: error handling
+	source->stop();
 	running = false;
 }
 
 ImageDataSet ImageAcquisition::acquireImages() {
 	ImageDataSet data;
 	if(running) {
-		FlyCapture2::Image imgL, imgR;
-		if(!playbackEnabled) {
-			// New images sourced from reality
-			Error error;
-			bmCamControl.start();
-			// If we're using automatic gain control, copy parameters from left to right
-			if(autoGainControlEnabled && camLConnected && camRConnected) {
-				autoGainControlValues = "";
-				for(auto const &pt : autoControlledProps) {
-					Property prop;
-					prop.type = pt;
-					error = camL.GetProperty(&prop);
-					if ( error != PGRERROR_OK ) {
-						logger->logError("Failed to read gain control from left camera.");
-					} else {
-						prop.absControl = true; // Use absValue, not valueA (valueA is in "ticks", absValue is in a human-readable unit)
-						prop.onOff = true; // Use this property
-						prop.autoManualMode = false; // Manual control
-						error = camR.SetProperty(&prop);
-						if ( error != PGRERROR_OK ) {
-							logger->logError("Failed to set right camera gain.");
-						} else {
-							// Success
-							autoGainControlValues = autoGainControlValues + propTypeToString(pt) + "=" + to_string(prop.absValue) + ",";
-						} 
-					}
-				}
-			} else {
-				// No automatic gain control
-			}
-			bmCamControl.end();
-			
-			// Assumes someone has already called beginAcquisition()
-			data.acquisitionTime = lastAcquisitionTime;
-			
-			if(camLConnected)
-			{
-				logger->logDebug("Waiting for left image");
-				// sem_timedwait(&imageWaitL, &imageWaitTimeout);
-				sem_wait(&imageWaitL);
-				data.imgVisibleLValid = true;
-			}
-			if(!data.imgVisibleLValid)
-			{ logger->logWarning("Error acquiring left image"); }
-			if(camRConnected)
-			{
-				logger->logDebug("Waiting for right image");
-				// sem_timedwait(&imageWaitR, &imageWaitTimeout);
-				sem_wait(&imageWaitR);
-				data.imgVisibleRValid = true;
-			}
-			data.imgVisibleRValid = (error == PGRERROR_OK);
-			if(!data.imgVisibleRValid)
-			{ logger->logWarning("Error acquiring right image"); }
-			data.imgInfraredValid = false;
-		} else {
-			// Images sourced from a recording
-			chrono::time_point<chrono::system_clock> nextFrameTime = readTimeFromTabSepInput(playIndexFile);
-
-			// TODO: The amount of copy-paste here is a little absurd, refactor into a common function.
-			string valid;
-			string left_img_path = "", right_img_path = "";
-			string infrared_path = "";
-			playIndexFile >> valid >> left_img_path;
-			left_img_path = folderName + left_img_path;
-			data.imgVisibleLValid = (valid == "true");
-			playIndexFile >> valid >> right_img_path;
-			right_img_path = folderName + right_img_path;
-			data.imgVisibleRValid = (valid == "true");
-			playIndexFile >> valid >> infrared_path;
-			infrared_path = folderName + infrared_path;
-			data.imgInfraredValid = (valid == "true");
-			
-			// stringstream dbg;
-			// dbg << (data.imgVisibleLValid? "true" : "false") << '\t' << left_img_path  << '\t'
-			    // << (data.imgVisibleRValid? "true" : "false") << '\t' << right_img_path << '\t'
-			    // << (data.imgInfraredValid? "true" : "false") << '\t' << infrared_path;
-			// logger->logDebug(dbg.str());
-			
-			if(data.imgVisibleLValid) { 
-				logger->logDebug("Opening " + left_img_path);
-				data.imgVisibleL = cv::imread(left_img_path,  CV_LOAD_IMAGE_GRAYSCALE); 
-				if(!data.imgVisibleL.data) {
-					logger->logWarning("Couldn't open left image at " + left_img_path);
-					data.imgVisibleLValid = false;
-				}
-			}
-			data.acquisitionTime = lastAcquisitionTime;
-			if(data.imgVisibleRValid) { 
-				logger->logDebug("Opening " + right_img_path);
-				data.imgVisibleR = cv::imread(right_img_path,  CV_LOAD_IMAGE_GRAYSCALE); 
-				if(!data.imgVisibleR.data) {
-					logger->logWarning("Couldn't open right image at " + right_img_path);
-					data.imgVisibleRValid = false;
-				}
-			}
-			if(data.imgInfraredValid) { 
-				logger->logDebug("Opening " + infrared_path);
-				data.imgInfrared = cv::imread(infrared_path,  CV_LOAD_IMAGE_GRAYSCALE); 
-				if(!data.imgInfrared.data) {
-					logger->logWarning("Couldn't open IR image at " + infrared_path);
-					data.imgInfraredValid = false;
-				}
-			}
+		// Assumes someone has already called beginAcquisition()
+		source->retrieve(data);
+		data.acquisitionTime = lastAcquisitionTime;
+		data.frameId = lastFrameId;
 		
-			if(playIndexFile.eof()) { 
-				logger->logDebug("EOF on playback file"); 
-				playbackComplete = true;
-			} else {
-				if(playedFirstFrame) {
-					interframeDelay = (nextFrameTime - lastFrameTime);
-				} else {
-					interframeDelay = std::chrono::milliseconds(0);
-					playedFirstFrame = true;
-				}
-			}
-			lastFrameTime = nextFrameTime;
-		}
-		
-		if(!playbackEnabled) {
-			// Convert
-			data.imgVisibleL = cbItemsL.image;
-			data.imgVisibleR = cbItemsR.image;
-			
-			// Flip
-			// Mat imgLFlipped;
-			if(flipImgL) {
-				bmFlipImageCpu.start();
-				cv::flip(data.imgVisibleL,data.imgVisibleL,imgFlipCodeL);
-				bmFlipImageCpu.end();
-			} else {
-				// imgLFlipped = data.imgVisibleL;
-			}
-			// Mat imgRFlipped;
-			if(flipImgR) {
-				bmFlipImageCpu.start();
-				cv::flip(data.imgVisibleR,data.imgVisibleR,imgFlipCodeR);
-				bmFlipImageCpu.end();
-			} else {
-				// imgRFlipped = data.imgVisibleR;
-			}
-
-			
-			// Record
-			if(recordEnabled) {
-				saveImages(data);
-			}
+		// Images go out flipped, unless rectification does the flipping.
+		// Rectified images are already as the algorithms want them.
+		if(!data.isRectified) {
+			orientImages(data);
 		}
 	}
 	
 	return data;
 }
 
-cv::Mat ImageAcquisition::cvMatFromFlyCap2Image(FlyCapture2::Image *img) {
-	return cv::Mat(img->GetRows(), 
-		img->GetCols(),
-		CV_8UC1, 
-		img->GetData(), 
-		img->GetStride());
+// A cv::flip code as two bits, mirroring left-right and top-bottom.
+// Flips compose by XOR, so undoing one and applying another is one flip.
+static int flipBits(bool flip, int flip_code) {
+	if(!flip) { return 0; }
+	return (flip_code != 0 ? 1 : 0) | (flip_code <= 0 ? 2 : 0);
+}
+static int flipCodeOf(int bits) { return (bits == 1) ? 1 : (bits == 2) ? 0 : -1; }
+
+// In place, unless the source's images are read-only, as a mapped
+// recording's are
+void ImageAcquisition::orientImages(ImageDataSet &data) {
+	bool in_place = source->areImagesWritable();
+	if(data.imgVisibleLValid) { orientImage(data.imgVisibleL, 0, flipImgL, imgFlipCodeL, in_place); }
+	if(data.imgVisibleRValid) { orientImage(data.imgVisibleR, 1, flipImgR, imgFlipCodeR, in_place); }
+}
+
+void ImageAcquisition::orientImage(cv::Mat &img, int side, bool flip, int flip_code, bool in_place) {
+	int stored_code = 0;
+	bool stored = source->isImageFlipped(side, stored_code);
+	int net = flipBits(stored, stored_code) ^ (foldFlips ? 0 : flipBits(flip, flip_code));
+	if(net == 0) { return; }
+	bmFlipImageCpu.start();
+	cv::Mat flipped;
+	cv::flip(img, in_place ? img : flipped, flipCodeOf(net));
+	if(!in_place) { img = flipped; }
+	bmFlipImageCpu.end();
+}
+
+void ImageAcquisition::ingest(ImageDataSet &data) {
+	// Rendered images come at the ingest window's size already
+	if(ingestWindow.isFullFrame() || data.isRectified) { return; }
+	// Images are still as the sensor sees them if the maps do the flipping
+	if(data.imgVisibleLValid) {
+		bmIngest.start();
+		ingestImage(data.imgVisibleL, data.slotVisibleL, foldFlips && flipImgL, imgFlipCodeL);
+		bmIngest.end();
+	}
+	if(data.imgVisibleRValid) {
+		bmIngest.start();
+		ingestImage(data.imgVisibleR, data.slotVisibleR, foldFlips && flipImgR, imgFlipCodeR);
+		bmIngest.end();
+	}
+}
+
+void ImageAcquisition::ingestImage(cv::Mat &img, FramePool::Slot &slot, bool flipped, int flip_code) {
+	cv::Rect rect = ingestWindow.getInputRect(img.size(), flipped, flip_code);
+	if(ingestWindow.getBinning() == 1) {
+		// Just a view, which keeps the full frame's slot alive
+		img = img(rect);
+		return;
+	}
+	// Binned into a slot of its own, so the full frame's can go back
+	cv::Size out_size = ingestWindow.getInputSize(img.size());
+	FramePool::Slot out_slot = framePool.claim(out_size.area());
+	cv::Mat out;
+	if(out_slot) { out = cv::Mat(out_size, CV_8UC1, out_slot.get()); }
+	ingestWindow.apply(img, rect, out);
+	img = out;
+	slot = out_slot;
+}
+
+void ImageAcquisition::saveImagesToContainer(const ImageDataSet &data) {
+	if(!recWriter.isOpen()) {
+		// The recording takes its frame size from the first image we get
+		const cv::Mat * first = data.imgVisibleLValid ? &data.imgVisibleL :
+		                        data.imgVisibleRValid ? &data.imgVisibleR : NULL;
+		if(first == NULL) { return; }
+		if(!recWriter.open(containerFilename, first->cols, first->rows, logger)) { return; }
+		durability->trackAppendedFile(containerFilename);
+	}
+	
+	StereoRecordingFrame frame;
+	frame.acquisitionTime = data.acquisitionTime;
+	frame.frameId         = data.frameId;
+	frame.validL          = data.imgVisibleLValid;
+	frame.validR          = data.imgVisibleRValid;
+	frame.imgL            = data.imgVisibleL;
+	frame.imgR            = data.imgVisibleR;
+	frame.autoGainValues  = data.autoGainValues;
+	recWriter.append(frame);
 }
 
 void ImageAcquisition::saveImages(ImageDataSet data) {
+	if(recordToContainer) {
+		bmSaveImages.start();
+		saveImagesToContainer(data);
+		bmSaveImages.end((data.imgVisibleLValid ? 1 : 0) + (data.imgVisibleRValid ? 1 : 0));
+		return;
+	}
 	bmSaveImages.start();
 	time_t time_acq_s = data.getTimeAcquiredS();
 	stringstream fn;
@@ -533,6 +245,7 @@ void ImageAcquisition::saveImages(ImageDataSet data) {
 		left_img_fn = fn.str();
 		logger->logDebug("Saving L to: " + left_img_fn);
 		cv::imwrite(folderName + left_img_fn, data.imgVisibleL);
+		durability->trackNewFile(folderName + left_img_fn);
 	}
 
 	if(data.imgVisibleRValid) {
@@ -545,6 +258,7 @@ void ImageAcquisition::saveImages(ImageDataSet data) {
 		right_img_fn = fn.str();
 		logger->logDebug("Saving R to: " + right_img_fn);
 		cv::imwrite(folderName + right_img_fn, data.imgVisibleR);
+		durability->trackNewFile(folderName + right_img_fn);
 	}
 	
 	// Tab-separated, one line per time entry.
@@ -552,72 +266,14 @@ void ImageAcquisition::saveImages(ImageDataSet data) {
 	             << (data.imgVisibleLValid? "true" : "false") << '\t' << left_img_fn  << '\t'
 	             << (data.imgVisibleRValid? "true" : "false") << '\t' << right_img_fn << '\t'
 	             << (data.imgInfraredValid? "true" : "false") << '\t' << infrared_fn  << '\t'
-				 << autoGainControlValues << '\t'
+				 << data.autoGainValues << '\t'
 	<< endl;
-	bmSaveImages.end(data.imgVisibleLValid? 1:0 + data.imgVisibleRValid? 1:0);
-}
-
-PropertyType ImageAcquisition::propTypeFromString(string p) {
-	if(p.compare("brightness") == 0) {
-		return PropertyType::BRIGHTNESS;
-	} else if(p.compare("shutter") == 0) {
-		return PropertyType::SHUTTER;
-	} else if(p.compare("gain") == 0) {
-		return PropertyType::GAIN;
-	} else if(p.compare("exposure") == 0) {
-		return PropertyType::AUTO_EXPOSURE;
-	} else {
-		logger->logError("Unknown camera property type \"" + p + "\"");
-		return PropertyType::UNSPECIFIED_PROPERTY_TYPE;
-	}
-}
-
-string ImageAcquisition::propTypeToString(PropertyType  p) {
-	switch(p) {
-		case BRIGHTNESS:                return "Brightness";                break;
-		case AUTO_EXPOSURE:             return "Auto exposure";             break;
-		case SHARPNESS:                 return "Sharpness";                 break;
-		case WHITE_BALANCE:             return "White balance";             break;
-		case HUE:                       return "Hue";                       break;
-		case SATURATION:                return "Saturation";                break;
-		case GAMMA:                     return "Gamma";                     break;
-		case IRIS:                      return "Iris";                      break;
-		case FOCUS:                     return "Focus";                     break;
-		case ZOOM:                      return "Zoom";                      break;
-		case PAN:                       return "Pan";                       break;
-		case TILT:                      return "Tilt";                      break;
-		case SHUTTER:                   return "Shutter";                   break;
-		case GAIN:                      return "Gain";                      break;
-		case TRIGGER_MODE:              return "Trigger mode";              break;
-		case TRIGGER_DELAY:             return "Trigger delay";             break;
-		case FRAME_RATE:                return "Frame rate";                break;
-		case TEMPERATURE:               return "Temperature";               break;
-		case UNSPECIFIED_PROPERTY_TYPE: return "Unspecified property type"; break;
-		default:                        return "Unspecified property type"; break;
-	}
-}
-
-void ImageAcquisition::flyCapImgEvent(Image * pImage, const void * pCallbackData) {
-	((CameraCallbackItems*)pCallbackData)->logger->logDebug(string("Got ") +  ((CameraCallbackItems*)pCallbackData)->side + " callback");
-	((CameraCallbackItems*)pCallbackData)->image = cvMatFromFlyCap2Image(pImage);
-	sem_post(((CameraCallbackItems*)pCallbackData)->pSem);
+	bmSaveImages.end((data.imgVisibleLValid ? 1 : 0) + (data.imgVisibleRValid ? 1 : 0));
 }
 
 void ImageAcquisition::beginAcquisition() {
-	Error error;
-	if(camLConnected)
-	{ 
-		logger->logDebug("Firing left trigger.");
-		error = camL.FireSoftwareTrigger(); 
-	}
-	if(error != PGRERROR_OK)
-	{ logger->logWarning("Failed to trigger left camera."); }
+	// Every frame gets an ID, which follows it through the pipeline
+	lastFrameId++;
 	lastAcquisitionTime = chrono::system_clock::now();
-	if(camRConnected)
-	{ 
-		logger->logDebug("Firing right trigger.");
-		error = camR.FireSoftwareTrigger(); 
-	}
-	if(error != PGRERROR_OK)
-	{ logger->logWarning("Failed to trigger right camera."); }
-}
\ No newline at end of file
+	source->trigger(lastFrameId);
+}
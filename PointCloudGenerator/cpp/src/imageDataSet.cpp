@@ -0,0 +1,23 @@
+/*
+	imageDataSet.cpp
+	
+	One frame of input from the camera-like sensors.
+*/
+
+#include <imageDataSet.h>
+using namespace std;
+
+unsigned long ImageDataSet::getTimeAcquiredS() {
+	chrono::system_clock::duration acq_timestamp = acquisitionTime.time_since_epoch();
+	return chrono::duration_cast<chrono::seconds>(acq_timestamp).count();
+}
+
+unsigned long ImageDataSet::getTimeAcquiredMs() {
+	chrono::system_clock::duration acq_timestamp = acquisitionTime.time_since_epoch();
+	return chrono::duration_cast<chrono::milliseconds>(acq_timestamp).count() % 1000;
+}
+
+unsigned long ImageDataSet::getDurationSinceAcquiredMs() {
+	chrono::system_clock::duration duration_since_acq = chrono::system_clock::now() - acquisitionTime;
+	return chrono::duration_cast<chrono::milliseconds>(duration_since_acq).count();
+}
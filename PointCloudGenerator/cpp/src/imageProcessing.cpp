@@ -9,7 +9,7 @@
 #include <imageProcessing.h>
 using namespace std;
 using namespace std::chrono;
-void ImageProcessing::init(json options, Logger * lgr) {
+void ImageProcessing::init(json options, Logger * lgr, MsgBufferPool * msg_pool) {
 	logger = lgr;
 	
 	stringstream ss;
@@ -20,10 +20,16 @@ void ImageProcessing::init(json options, Logger * lgr) {
 	string cur_key = "";
 	string cal_fn = "";
 	string alg_name = "";
+	unsigned int num_worker_threads = 0;
+	bool show_images = false;
+	json profiles_config;
 	try {
-		cur_key = "stereoCalFile"; cal_fn    = options[cur_key];
-		cur_key = "algorithm";     alg_name  = options[cur_key];
-		cur_key = "enableGpu";     enableGpu = options[cur_key];
+		cur_key = "stereoCalFile";     cal_fn             = options[cur_key];
+		cur_key = "algorithm";         alg_name           = options[cur_key];
+		cur_key = "enableGpu";         enableGpu          = options[cur_key];
+		cur_key = "numWorkerThreads";  num_worker_threads = options[cur_key];
+		cur_key = "showImages";        show_images        = options[cur_key];
+		cur_key = "algorithmProfiles"; profiles_config    = options[cur_key];
 	} catch (domain_error e) {
 		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
 			 << endl << "While reading key \"" << cur_key << "\" in processing section: "
@@ -42,6 +48,18 @@ void ImageProcessing::init(json options, Logger * lgr) {
 		throw(e);
 	}
 	stereo_cal["enableGpu"] = enableGpu;
+	try {
+		cur_key = "flipImgL";     stereo_cal[cur_key] = options[cur_key];
+		cur_key = "flipImgR";     stereo_cal[cur_key] = options[cur_key];
+		cur_key = "imgFlipCodeL"; stereo_cal[cur_key] = options[cur_key];
+		cur_key = "imgFlipCodeR"; stereo_cal[cur_key] = options[cur_key];
+		cur_key = "ingest";       stereo_cal[cur_key] = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in processing section: "
+			 << e.what() << endl;
+		throw(e);
+	}
 
 	// Load calibration
 	cal_data.init(stereo_cal);
@@ -61,14 +79,124 @@ void ImageProcessing::init(json options, Logger * lgr) {
 		logger->logError("No GPU found!");
 	}
 	
-	// Initialize underlying algorithm
+	// Start worker threads.  The processing thread pitches in while waiting
+	// on them, so one fewer than the number of cores keeps every core busy.
+	taskPool.init(num_worker_threads);
+	ss.str(""); ss.clear();
+	ss << "Started " << num_worker_threads << " stereo worker threads.";
+	logger->logDebug(ss.str());
+	StereoPtCloudGenAlg::setTaskPool(&taskPool);
+	StereoPtCloudGenAlg::setMsgPool(msg_pool);
+	
+	// Initialize underlying algorithms.  Profile 0 is the one configured
+	// above; the rest each override some of its options.
+	// Each algorithm keeps a pointer to its profile's benchmarker list, so
+	// profiles stay where they're built, and are loaded only once there
+	profiles.push_back(unique_ptr<AlgorithmProfile>(new AlgorithmProfile()));
+	AlgorithmProfile &default_profile = *profiles.back();
+	default_profile.name    = "default";
+	default_profile.algName = alg_name;
+	loadProfile(default_profile, options);
+	for(auto const &profile_config : profiles_config) {
+		profiles.push_back(unique_ptr<AlgorithmProfile>(new AlgorithmProfile()));
+		AlgorithmProfile &profile = *profiles.back();
+		json profile_options = options;
+		try {
+			cur_key = "name";      profile.name    = profile_config[cur_key];
+			cur_key = "algorithm"; profile.algName = profile_config[cur_key];
+			cur_key = "overrides"; mergeOptions(profile_options, profile_config[cur_key]);
+		} catch (domain_error e) {
+			cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+				 << endl << "While reading key \"" << cur_key << "\" in algorithm profiles section: "
+				 << e.what() << endl;
+			throw(e);
+		}
+		loadProfile(profile, profile_options);
+	}
+	
+	// Debug windows belong to the processing thread, so don't open them here
+	if(!show_images) {
+		for(auto &profile : profiles) {
+			warmUp(*profile);
+		}
+	}
+	for(size_t i = 0; i < profiles.size(); ++i) {
+		ss.str(""); ss.clear();
+		ss << "Loaded stereo algorithm profile " << i << ", \"" << profiles[i]->name
+		   << "\": " << profiles[i]->algName;
+		logger->logDebug(ss.str());
+	}
+	activeProfile = 0;
+	alg = profiles[activeProfile]->alg;
+}
+
+StereoPtCloudGenAlg * ImageProcessing::createAlgorithm(string alg_name, list<const Benchmarker *> * alg_bms) {
 	if(alg_name == "GpuFastWithBinnedKps") {
-		alg = new GpuFastWithBinnedKps(bms);
+		return new GpuFastWithBinnedKps(alg_bms);
+	} else if(alg_name == "CpuFastWithBinnedKps") {
+		return new CpuFastWithBinnedKps(alg_bms);
+	} else if(alg_name == "CpuCensusSgm") {
+		return new CpuCensusSgm(alg_bms);
+	} else if(alg_name == "CpuFastPostUndistort") {
+		return new CpuFastPostUndistort(alg_bms);
 	} else {
 		// Default to doing nothing
-		alg = new DummyAlg(bms);
+		return new DummyAlg(alg_bms);
+	}
+}
+
+void ImageProcessing::loadProfile(AlgorithmProfile &profile, json options) {
+	profile.alg = createAlgorithm(profile.algName, &profile.bms);
+	// The benchmarkers are the algorithm's own members, so they can be
+	// renamed here, before anything uses them
+	for(const Benchmarker * bm : profile.bms) {
+		Benchmarker * own = const_cast<Benchmarker *>(bm);
+		own->setName(profile.name + ": " + own->getName());
+		bms->push_back(bm);
 	}
-	alg->init(options, logger, cal_data);
+	profile.alg->init(options, logger, cal_data);
+}
+
+void ImageProcessing::warmUp(AlgorithmProfile &profile) {
+	StereoPtCloudGenAlg * candidate = profile.alg;
+	Size img_size = cal_data.getInputSize();
+	if(img_size.area() == 0) { return; }
+	ImageDataSet blank;
+	blank.acquisitionTime  = chrono::system_clock::now();
+	blank.imgVisibleL      = Mat::zeros(img_size, CV_8UC1);
+	blank.imgVisibleR      = Mat::zeros(img_size, CV_8UC1);
+	blank.imgVisibleLValid = true;
+	blank.imgVisibleRValid = true;
+	blank.imgInfraredValid = false;
+	candidate->processImages(blank);
+	candidate->selfClean();
+	for(const Benchmarker * bm : profile.bms) {
+		const_cast<Benchmarker *>(bm)->reset();
+	}
+}
+
+void ImageProcessing::mergeOptions(json &base, const json &overrides) {
+	for(auto it = overrides.begin(); it != overrides.end(); ++it) {
+		if(it.value().is_object() && base[it.key()].is_object()) {
+			mergeOptions(base[it.key()], it.value());
+		} else {
+			base[it.key()] = it.value();
+		}
+	}
+}
+
+bool ImageProcessing::selectProfile(unsigned int profile_idx) {
+	stringstream ss;
+	if(profile_idx >= profiles.size()) {
+		ss << "No stereo algorithm profile " << profile_idx << "; have " << profiles.size() << ".";
+		logger->logWarning(ss.str());
+		return false;
+	}
+	ss << "Switching to stereo algorithm profile " << profile_idx << ", \""
+	   << profiles[profile_idx]->name << "\", on the next frame.";
+	logger->logInfo(ss.str());
+	requestedProfile = profile_idx;
+	return true;
 }
 
 ////////////////////////////////////////////////////////////
@@ -76,10 +204,20 @@ void ImageProcessing::init(json options, Logger * lgr) {
 ////////////////////////////////////////////////////////////
 
 void ImageProcessing::processImages(ImageDataSet imgData) {
+	// Switch between frames, on this thread, so the algorithm is never
+	// changed out from under itself
+	int requested = requestedProfile.exchange(-1);
+	if(requested >= 0 && (size_t)requested != activeProfile) {
+		alg->selfClean();
+		activeProfile = requested;
+		alg = profiles[activeProfile]->alg;
+	}
+	
 	if(alg != NULL) {
 		bmImgTotal.start();
 		alg->processImages(imgData);
 		bmImgTotal.end();
+		taskPool.publishStats();
 	}
 }
 
@@ -91,6 +229,14 @@ PointCloudDataMessage * ImageProcessing::getPointCloud() {
 	}
 }
 
+MsgBufferPool::Buffer ImageProcessing::takePointCloud() {
+	if(alg != NULL) {
+		return alg->takePointCloud();
+	} else {
+		return MsgBufferPool::Buffer();
+	}
+}
+
 bool ImageProcessing::isPointCloudAvailable() {
 	if(alg != NULL) {
 		return alg->isPointCloudAvailable();
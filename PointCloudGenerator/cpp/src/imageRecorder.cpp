@@ -0,0 +1,115 @@
+/*
+	imageRecorder.cpp
+
+	Writes recorded frames to storage on a thread of its own.
+*/
+
+#include <imageRecorder.h>
+using namespace std;
+
+void ImageRecorder::init(json options, Logger * lgr) {
+	logger = lgr;
+
+	// Load configuration options
+	string cur_key = "";
+	size_t queue_depth = 1;
+	string policy_string;
+	try {
+		cur_key = "queueDepth";     queue_depth   = options[cur_key];
+		cur_key = "overflowPolicy"; policy_string = options[cur_key];
+		cur_key = "recordEveryN";   everyN        = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in image recorder section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+
+	if(policy_string == "block") {
+		policy = BLOCK;
+	} else if(policy_string == "dropOldest") {
+		policy = DROP_OLDEST;
+	} else if(policy_string == "everyNth") {
+		policy = EVERY_NTH;
+	} else {
+		throw domain_error("Unknown image recorder overflow policy \"" + policy_string + "\"");
+	}
+	if(everyN < 1) { everyN = 1; }
+	queue.setCapacity(queue_depth);
+}
+
+void ImageRecorder::start(Writer write) {
+	writer = write;
+	writerThread = thread(&ImageRecorder::run, this);
+}
+
+void ImageRecorder::stop() {
+	if(!writerThread.joinable()) { return; }
+	queue.close();
+	writerThread.join();
+}
+
+void ImageRecorder::submit(const ImageDataSet &data) {
+	if(!writerThread.joinable()) { return; }
+
+	bool full = (queue.size() >= queue.getCapacity());
+	switch(policy) {
+	case BLOCK:
+		queue.push(data);
+		break;
+	case DROP_OLDEST: {
+		bool was_dropped = false;
+		queue.pushDroppingOldest(data, was_dropped);
+		if(was_dropped) { dropped(); }
+		break;
+	}
+	case EVERY_NTH:
+		// Once the writer falls behind, thin the stream out until it has
+		// caught all the way up.
+		if(full && !thinning) {
+			thinning = true;
+			sinceKept = 0;
+			stringstream ss;
+			ss << "Image recording fell behind; keeping one frame in every " << everyN << ".";
+			logger->logInfo(ss.str());
+		} else if(thinning && queue.size() == 0) {
+			thinning = false;
+			logger->logInfo("Image recording caught up; keeping every frame.");
+		}
+		if(thinning && (++sinceKept % everyN) != 0) {
+			dropped();
+			return;
+		}
+		queue.push(data);
+		break;
+	}
+	bmQueueDepth.count(queue.size());
+}
+
+void ImageRecorder::dropped() {
+	bmDropped.count();
+	logger->logDebug("Image recording fell behind; dropped a frame.");
+}
+
+void ImageRecorder::run() {
+	FrameTracer::setThreadName("Image recorder");
+	ImageDataSet data;
+	while(queue.pop(data)) {
+		FrameTracer::setCurrentFrame(data.frameId);
+		size_t bytes = 0;
+		if(data.imgVisibleLValid) { bytes += data.imgVisibleL.total() * data.imgVisibleL.elemSize(); }
+		if(data.imgVisibleRValid) { bytes += data.imgVisibleR.total() * data.imgVisibleR.elemSize(); }
+		int kib = bytes / 1024;
+
+		bmWrite.start();
+		writer(data);
+		bmWrite.end(kib);
+
+		double secs = duration_cast<duration<double>>(bmWrite.getLastTime()).count();
+		if(secs > 0) {
+			bmBandwidth.count(kib / secs);
+		}
+		// Hand the frame pool slots back promptly
+		data = ImageDataSet();
+	}
+}
@@ -0,0 +1,82 @@
+/*
+	ingestWindow.cpp
+
+	The part of each camera image that's processed, and how far it's binned.
+*/
+
+#include <ingestWindow.h>
+#include <iostream>
+#include <cmath>
+#include <opencv2/imgproc/imgproc.hpp>
+using namespace std;
+
+const int IngestWindow::INTERP_MARGIN;
+
+void IngestWindow::init(json options) {
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "roi";                  json  roi_section            = options[cur_key];
+		int x = roi_section[0], y = roi_section[1], w = roi_section[2], h = roi_section[3];
+		roi = cv::Rect(x, y, w, h);
+		cur_key = "binning";                    binning                = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in ingest section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	if(binning != 1 && binning != 2 && binning != 4) {
+		throw invalid_argument("Ingest binning must be 1, 2 or 4.");
+	}
+	if(roi.x < 0 || roi.y < 0 || roi.width < 0 || roi.height < 0) {
+		throw invalid_argument("Ingest region of interest can't be negative.");
+	}
+}
+
+cv::Rect IngestWindow::trimToBins(cv::Rect r) const {
+	r.width  -= r.width  % binning;
+	r.height -= r.height % binning;
+	return r;
+}
+
+cv::Rect IngestWindow::getRoi(cv::Size full_size) const {
+	cv::Rect whole(0, 0, full_size.width, full_size.height);
+	cv::Rect r = (roi.area() == 0) ? whole : (roi & whole);
+	return trimToBins(r);
+}
+
+// Bilinear interpolation reads the input pixel either side of each
+// sample, and an input pixel is binning full-resolution pixels across.
+// Samples off the sensor are clamped to it; remap fills in their border.
+void IngestWindow::fitInputToMaps(cv::Size full_size, const cv::Mat &map_x, const cv::Mat &map_y) {
+	double min_x, max_x, min_y, max_y;
+	cv::minMaxLoc(map_x, &min_x, &max_x);
+	cv::minMaxLoc(map_y, &min_y, &max_y);
+	int margin = INTERP_MARGIN * binning;
+	int x0 = (int)floor(min_x) - margin, x1 = (int)ceil(max_x) + margin;
+	int y0 = (int)floor(min_y) - margin, y1 = (int)ceil(max_y) + margin;
+	cv::Rect r(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+	if(inputRect.area() > 0) { r |= inputRect; }
+	inputRect = trimToBins(r & cv::Rect(0, 0, full_size.width, full_size.height));
+}
+
+cv::Rect IngestWindow::getInputRect(cv::Size full_size, bool flipped, int flip_code) const {
+	cv::Rect whole(0, 0, full_size.width, full_size.height);
+	cv::Rect r = (inputRect.area() == 0) ? trimToBins(whole) : (inputRect & whole);
+	if(flipped) {
+		// The same pixels, in the image as the sensor sees it
+		if(flip_code != 0) { r.x = full_size.width  - r.x - r.width;  } // Around the y axis
+		if(flip_code <= 0) { r.y = full_size.height - r.y - r.height; } // Around the x axis
+	}
+	return r;
+}
+
+void IngestWindow::apply(const cv::Mat &in, const cv::Rect &rect, cv::Mat &out) const {
+	if(binning == 1) {
+		in(rect).copyTo(out);
+	} else {
+		// For whole factors, area interpolation is an exact box average
+		cv::resize(in(rect), out, binned(rect), 0, 0, cv::INTER_AREA);
+	}
+}
@@ -0,0 +1,91 @@
+/*
+	latencyHistogram.cpp
+
+	Fixed-width buckets of durations.
+*/
+
+#include <latencyHistogram.h>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+using namespace std;
+
+void LatencyHistogram::init(long min_us, long max_us, long bucket_us) {
+	if(bucket_us <= 0 || max_us <= min_us) {
+		throw invalid_argument("Histogram \"" + name + "\" needs positive bucket width and range.");
+	}
+	minUs    = chrono::microseconds(min_us);
+	bucketUs = chrono::microseconds(bucket_us);
+	buckets.assign((max_us - min_us + bucket_us - 1) / bucket_us, 0);
+	clear();
+}
+
+void LatencyHistogram::clear() {
+	fill(buckets.begin(), buckets.end(), 0);
+	underflows = overflows = total = 0;
+}
+
+void LatencyHistogram::add(chrono::steady_clock::duration d) {
+	total++;
+	chrono::microseconds us = chrono::duration_cast<chrono::microseconds>(d);
+	if(us < minUs) {
+		underflows++;
+		return;
+	}
+	size_t idx = (us - minUs) / bucketUs;
+	if(idx >= buckets.size()) {
+		overflows++;
+		return;
+	}
+	buckets[idx]++;
+}
+
+double LatencyHistogram::getPercentileMs(double pct) const {
+	if(total == 0) { return 0; }
+	double target = pct / 100.0 * total;
+	double seen = underflows;
+	if(seen >= target) {
+		return minUs.count() / 1000.0;
+	}
+	for(size_t i = 0; i < buckets.size(); ++i) {
+		seen += buckets[i];
+		if(seen >= target) {
+			return (minUs + bucketUs * (long)(i + 1)).count() / 1000.0;
+		}
+	}
+	return (minUs + bucketUs * (long)buckets.size()).count() / 1000.0;
+}
+
+string LatencyHistogram::toString() const {
+	const int BAR_WIDTH = 40;
+	unsigned long tallest = max(underflows, overflows);
+	for(auto b : buckets) { tallest = max(tallest, b); }
+
+	stringstream ss;
+	ss << fixed << setprecision(2);
+	ss << name << ": " << total << " samples, p50 " << getPercentileMs(50)
+	   << "ms, p90 " << getPercentileMs(90) << "ms, p99 " << getPercentileMs(99) << "ms";
+	if(total == 0) { return ss.str(); }
+
+	auto bar = [&](unsigned long n) {
+		return string(tallest > 0 ? (size_t)(BAR_WIDTH * n / tallest) : 0, '#');
+	};
+	double lo_ms = minUs.count() / 1000.0;
+	double hi_ms = (minUs + bucketUs * (long)buckets.size()).count() / 1000.0;
+	if(underflows > 0) {
+		ss << endl << "  " << setw(8) << "" << " < " << setw(8) << lo_ms << " ms |"
+		   << left << setw(BAR_WIDTH) << bar(underflows) << right << " " << underflows;
+	}
+	for(size_t i = 0; i < buckets.size(); ++i) {
+		if(buckets[i] == 0) { continue; }
+		double b_lo = (minUs + bucketUs * (long)i).count() / 1000.0;
+		double b_hi = (minUs + bucketUs * (long)(i + 1)).count() / 1000.0;
+		ss << endl << "  " << setw(8) << b_lo << " - " << setw(8) << b_hi << " ms |"
+		   << left << setw(BAR_WIDTH) << bar(buckets[i]) << right << " " << buckets[i];
+	}
+	if(overflows > 0) {
+		ss << endl << "  " << setw(8) << "" << ">= " << setw(8) << hi_ms << " ms |"
+		   << left << setw(BAR_WIDTH) << bar(overflows) << right << " " << overflows;
+	}
+	return ss.str();
+}
@@ -12,17 +12,21 @@ using namespace std;
 string Logger::getTimeString() {
 	chrono::time_point<chrono::system_clock> now = chrono::system_clock::now();
 	time_t tt = chrono::system_clock::to_time_t(now);
+	struct tm local;
+	localtime_r(&tt, &local);
 	stringstream ss;
-	ss << put_time(localtime(&tt), timestampPattern.c_str());
+	ss << put_time(&local, timestampPattern.c_str());
 	return ss.str();
 }
 
 void Logger::log(string message) {
+	string line = getTimeString() + message;
+	lock_guard<mutex> lk(lock);
 	if(haveStatusstatusLogStream) {
-		(*statusLogStream) << getTimeString() << message << endl;
+		(*statusLogStream) << line << endl;
 		statusLogStream->flush();
 	} else {
-		cout << getTimeString() << message << endl;
+		cout << line << endl;
 	}
 }
 void Logger::log(string message, LogVerbosity level) {
@@ -51,6 +55,7 @@ void Logger::init(json options) {
 			cur_key = "path";     file_stream_path = options[cur_key];
 			string file_path = file_stream_path + file_stream_name;
 			statusLogFile.open(file_path, ofstream::out | ofstream::app);
+			logFilePath = file_path;
 			statusLogStream = &statusLogFile;
 			haveStatusstatusLogStream = true;
 		} else {
@@ -22,30 +22,73 @@ using namespace std;
 const char * PcgMain::DEFAULT_CONFIG_FILENAME = "../../config/pcgConfig.json";
 
 void PcgMain::handleNewMessages() {
-	// Check for messages - will block when PCG is disabled.
-	Msg * rxd_msg = messaging.checkForMessage();
-	if(rxd_msg != NULL) {
-		switch(rxd_msg->getMsgId()) {
-			case MsgId::EN_POINT_CLOUD_GEN:
-				enable();
-			break;
-			case MsgId::DIS_POINT_CLOUD_GEN:
-				disable();
-			break;
-			case MsgId::SHUTDOWN_PCG:
-				logger.logInfo("Shutting down.");
-				// Make sure this user has passwordless sudo privs
-				system("sudo shutdown -hP now");
-			break;
-			default:
-				stringstream ss;
-				ss << "Unrecognized MID 0x" << hex << setw(4) << rxd_msg->getMsgId();
-				logger.logWarning(ss.str());
+	// Called when the socket is readable.  Handle everything that's
+	// waiting, since we won't be woken again for data already received.
+	while(true) {
+		MsgBufferPool::Buffer rxd_buf = messaging.checkForMessage();
+		if(rxd_buf) {
+			handleMessage((const Msg *)rxd_buf.get());
+		} else if(const Msg * pending = messaging.peekPendingMessage()) {
+			// No pool buffer free to copy it into (the pool logs that).
+			// Handle it in the receive buffer rather than leave it there.
+			handleMessage(pending);
+			messaging.discardPendingMessage();
+		} else {
 			break;
 		}
-		
-		delete[] rxd_msg;
-		rxd_msg = NULL;
+	}
+}
+
+void PcgMain::handleMessage(const Msg * rxd_msg) {
+	switch(rxd_msg->getMsgId()) {
+		case MsgId::EN_POINT_CLOUD_GEN:
+			enable();
+		break;
+		case MsgId::DIS_POINT_CLOUD_GEN:
+			disable();
+		break;
+		case MsgId::SHUTDOWN_PCG:
+			logger.logInfo("Shutting down.");
+			dumpTrace();
+			// Make sure this user has passwordless sudo privs
+			system("sudo shutdown -hP now");
+		break;
+		case MsgId::SELECT_STEREO_ALG:
+			if(rxd_msg->getLenB() < sizeof(SelectStereoAlgorithmMsg)) {
+				logger.logWarning("Stereo algorithm selection message is too short; ignoring.");
+			} else {
+				img_processing.selectProfile(((const SelectStereoAlgorithmMsg *)rxd_msg)->getProfileIdx());
+			}
+		break;
+		default:
+			stringstream ss;
+			ss << "Unrecognized MID 0x" << hex << setw(4) << rxd_msg->getMsgId();
+			logger.logWarning(ss.str());
+		break;
+	}
+}
+
+// Runs every controlLoopPeriod while enabled
+void PcgMain::controlTick() {
+	bmControlLoop.start();
+	// Store attitude
+	attitude_tracker.estimateAttitude();
+	
+	if(playbackFinished) {
+		logger.logInfo("Reached end of playback.");
+		disable();
+	}
+	// LidarReader keeps its socket to itself, so it's polled here rather
+	// than waited on directly.
+	if(pcgEnabled && useLidar) {
+		handleLidar();
+	}
+	bmControlLoop.end();
+	
+	if(traceDumpInterval > chrono::seconds(0)
+			&& chrono::steady_clock::now() - lastTraceDump > traceDumpInterval) {
+		dumpTraceInBackground();
+		lastTraceDump = chrono::steady_clock::now();
 	}
 }
 
@@ -56,10 +99,17 @@ void PcgMain::enable() {
 			logger.logWarning("No point cloud sources configured.  Cannot enable.");
 		} else {
 			logger.logInfo("Enabling point cloud generation.");
-			if(useStereoCams) { img_acquisition.start(); }
-			if(useLidar)      { lidar          .start(); }
-			pcgEnabled = true;
-			messaging.setBlockingListen(false);
+			{
+				lock_guard<mutex> lock(acquisitionMutex);
+				if(useStereoCams) { img_acquisition.start(); }
+				if(useLidar)      { lidar          .start(); }
+				acquisitionTriggered = false;
+				playbackFinished = false;
+				frameScheduler.reset();
+				pcgEnabled = true;
+			}
+			acquisitionCv.notify_all();
+			Reactor::setTimerPeriod(controlTimerFd, controlLoopPeriod);
 		}
 	} else {
 		logger.logInfo("Tried to enable when already enabled.");
@@ -68,10 +118,17 @@ void PcgMain::enable() {
 void PcgMain::disable() {
 	if(pcgEnabled) {
 		logger.logInfo("Disabling point cloud generation.");
-		pcgEnabled = false;
+		{
+			unique_lock<mutex> lock(acquisitionMutex);
+			pcgEnabled = false;
+			// Waits for the acquisition stage to finish its current frame
+			acquisitionCv.wait(lock, [this]{ return !acquiring; });
 			if(useStereoCams) { img_acquisition.stop(); }
 			if(useLidar)      { lidar          .stop(); }
-		messaging.setBlockingListen(true);
+			acquisitionTriggered = false;
+		}
+		Reactor::setTimerPeriod(controlTimerFd, chrono::milliseconds(0));
+		dumpTraceInBackground();
 	} else {
 		logger.logInfo("Tried to disable when already disabled.");
 	}
@@ -98,6 +155,13 @@ void PcgMain::init(char * config_fn) {
 	json lidar_config;
 	json platform_offset;
 	json output_rec_config;
+	json pipeline_config;
+	json durability_config;
+	json scheduling_config;
+	json tracing_config;
+	json msg_pool_config;
+	json recorder_config;
+	json evaluation_config;
 	double platform_pitch_down_rad = 0.0;
 	double platform_downward_offset_cm = 0.0;
 	bool enable_gpu = true;
@@ -119,18 +183,61 @@ void PcgMain::init(char * config_fn) {
 		cur_key = "recordProcessedPointClouds"; outputPcRecEnabled   = output_rec_config[cur_key];
 		cur_key = "timestampPattern";           recOutputPcTsPattern = output_rec_config[cur_key];
 
+		cur_key = "pipeline";                   pipeline_config      = options[cur_key];
+		cur_key = "queueDepth";          size_t queue_depth          = pipeline_config[cur_key];
+		cur_key = "controlLoopPeriodMs"; int    control_period_ms    = pipeline_config[cur_key];
+		cur_key = "latestFrameWins";            latestFrameWins      = pipeline_config[cur_key];
+		pipelineQueueDepth = queue_depth;
+		// A zero period would disarm the control timer, and with it the
+		// end-of-playback check
+		if(control_period_ms <= 0) {
+			throw invalid_argument("pipeline.controlLoopPeriodMs must be at least 1.");
+		}
+		controlLoopPeriod  = chrono::milliseconds(control_period_ms);
+
+		cur_key = "msgBufferPool";    msg_pool_config    = options[cur_key];
+		cur_key = "imageRecorder";    recorder_config    = options[cur_key];
+		cur_key = "durability";       durability_config  = options[cur_key];
+		cur_key = "frameScheduling";  scheduling_config  = options[cur_key];
+		cur_key = "tracing";          tracing_config     = options[cur_key];
+		cur_key = "dumpIntervalS";    traceDumpInterval  = chrono::seconds((int)tracing_config[cur_key]);
 		cur_key = "logging";          logging_config     = options[cur_key];
 		cur_key = "imageAcquisition"; acquisition_config = options[cur_key];
 		cur_key = "imageProcessing";  processing_config  = options[cur_key];
 		cur_key = "attitudeTracker";  attitude_config    = options[cur_key];
 		cur_key = "messaging";        messaging_config   = options[cur_key];
 		cur_key = "lidar";            lidar_config       = options[cur_key];
+		cur_key = "evaluation";       evaluation_config  = options[cur_key];
+		cur_key = "framesPerProfile"; evalFramesPerProfile = evaluation_config[cur_key];
 	} catch (domain_error e) {
 		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
 			 << endl << "While reading key \"" << cur_key << "\": " << e.what() << endl;
 		throw e;
 	}
 	
+	if(benchMode) {
+		// Play the given recording back as fast as it can be processed,
+		// with nothing but the stereo pipeline running.  Every frame is
+		// processed, so runs are comparable.
+		json &rec_play_config = acquisition_config["imageRecordPlayback"];
+		if(evalMode) {
+			// Rendered frames, which come with their true depth
+			rec_play_config["mode"]            = "normal";
+			acquisition_config["cameraSource"] = "synthetic";
+		} else {
+			rec_play_config["mode"]         = "playback";
+			rec_play_config["playbackPath"] = benchRecordingPath;
+		}
+		scheduling_config["maxFps"]        = 0;
+		scheduling_config["playbackSpeed"] = 0;
+		processing_config["showImages"]    = false;
+		latestFrameWins    = false;
+		useLidar           = false;
+		useStereoCams      = true;
+		outputPcRecEnabled = false;
+		pcgEnabled         = false;
+	}
+	
 	// Create a directory for this recording, and a subdir for output
 	stringstream path;
 	time_t now_s = system_clock::to_time_t(system_clock::now()); 
@@ -145,6 +252,7 @@ void PcgMain::init(char * config_fn) {
 	}
 	// Submodules will handle their own subdir creation
 	logging_config    ["path"] = recDataPath;
+	tracing_config    ["path"] = recDataPath;
 	acquisition_config["path"] = recDataPath;
 	attitude_config   ["path"] = recDataPath;
 	lidar_config      ["path"] = recDataPath;
@@ -152,17 +260,62 @@ void PcgMain::init(char * config_fn) {
 	// Use of the GPU should be disable-able in all submodules that use it
 	processing_config["enableGpu"] = enable_gpu;
 	
+	// When folding flips into rectification, processing gets raw images
+	// and has to know how they'd have been flipped.
+	try {
+		cur_key = "foldFlipsIntoRectification";
+		bool fold_flips = acquisition_config[cur_key];
+		cur_key = "flipImgL";     processing_config["flipImgL"]     = fold_flips && (bool)acquisition_config[cur_key];
+		cur_key = "flipImgR";     processing_config["flipImgR"]     = fold_flips && (bool)acquisition_config[cur_key];
+		cur_key = "imgFlipCodeL"; processing_config["imgFlipCodeL"] = (int)acquisition_config[cur_key];
+		cur_key = "imgFlipCodeR"; processing_config["imgFlipCodeR"] = (int)acquisition_config[cur_key];
+		// Images arrive cropped and binned, and the maps have to match
+		cur_key = "ingest";       processing_config[cur_key]        = acquisition_config[cur_key];
+		// The synthetic camera source renders to match the calibration
+		cur_key = "stereoCalFile"; string cal_fn = processing_config[cur_key];
+		acquisition_config[cur_key] = cal_fn;
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: " << e.what() << endl;
+		throw e;
+	}
+	
 	// Compute transformation matrices
 	lidarTransform = stereoTransform = makeXform(platform_pitch_down_rad, platform_downward_offset_cm);
 	
 	// Pass subsections to component modules
+	FrameTracer::init(tracing_config);
 	logger.init(logging_config);
-	messaging.init(messaging_config, &logger);
-	messaging.setBlockingListen(!pcgEnabled);
-	img_acquisition .init(acquisition_config, &logger);
-	img_processing  .init(processing_config,  &logger);
-	attitude_tracker.init(attitude_config,    &logger);
+	durability.init(durability_config, &logger);
+	if(logger.getFilePath() != "") {
+		durability.trackAppendedFile(logger.getFilePath());
+	}
+	cloudPool.init(msg_pool_config, &logger);
+	frameScheduler.init(scheduling_config, &logger);
+	reactor.init();
+	if(!benchMode) {
+		// Without init, messaging silently sends nothing
+		messaging.init(messaging_config, &logger);
+		messaging.setBlockingListen(false);
+		reactor.addSource(messaging.getListenSocket(), [this]{ handleNewMessages(); });
+	}
+	controlTimerFd = Reactor::makeTimerFd();
+	reactor.addSource(controlTimerFd, [this]{
+		Reactor::drain(controlTimerFd);
+		controlTick();
+	});
+	img_acquisition .init(acquisition_config, &logger, &durability);
+	imageRecorder   .init(recorder_config,    &logger);
+	if(img_acquisition.isRecordEnabled()) {
+		imageRecorder.start([this](const ImageDataSet &data){ img_acquisition.saveImages(data); });
+	}
+	img_processing  .init(processing_config,  &logger, &cloudPool);
+	img_acquisition .setIngestWindow(img_processing.getStereoCal().getIngestWindow());
+	attitude_tracker.init(attitude_config,    &logger, &durability);
 	lidar           .init(lidar_config,       &logger);
+	if(evalMode) {
+		evaluator.init(evaluation_config, img_processing.getStereoCal().getCpuProjectionMatrixLeft());
+	}
 	
 	
 	// Copy the config file into the recording directory so we know what was used.
@@ -171,6 +324,8 @@ void PcgMain::init(char * config_fn) {
 		ifstream config_file(config_fn, ios::binary);
 		ofstream saved_config(save_path, ios::binary);
 		saved_config << config_file.rdbuf();
+		saved_config.close();
+		durability.trackNewFile(save_path);
 	}
 }
 
@@ -199,151 +354,369 @@ int PcgMain::main(char * config_fn)
 	}
 	
 	
-	uint16_t pc_seq = 0;
-	if(pcgEnabled && useStereoCams) {
-		img_acquisition.beginAcquisition();
-	}
+	startPipeline();
+	
+	// The control loop handles commands, attitude, and the LIDAR.
+	// Stereo frames are handled by the pipeline stage threads.
+	// Commands are handled as soon as they arrive; everything else runs
+	// off the control timer, which only ticks while enabled.
+	FrameTracer::setThreadName("Control loop");
+	lastTraceDump = chrono::steady_clock::now();
 	while(true) {
-		bmOneFrame.start();
-		handleNewMessages();
+		reactor.runOnce(chrono::milliseconds(-1));
+	}
+	
+	stopPipeline();
+	dumpTrace();
+	durability.stop();
+	return 0;
+}
+
+// Runs a recording through the stereo pipeline as fast as possible, then
+// prints throughput and per-stage latencies.
+int PcgMain::bench(char * recording_path, char * config_fn) {
+	benchMode = true;
+	benchRecordingPath = recording_path;
+	if(benchRecordingPath.back() != '/') {
+		benchRecordingPath += '/';
+	}
+	Benchmarker::setKeepSamples(true);
+	try {
+		init(config_fn);
+	} catch(exception e) {
+		cerr << "The PCG application requires a valid JSON file at "
+			 << (config_fn ? config_fn : DEFAULT_CONFIG_FILENAME) << ".  There was an error opening or parsing:"
+			 << endl << e.what() << endl << "Exiting.";
+		return 1;
+	}
+	logger.logInfo("---------------------------------------------------------");
+	logger.logInfo("Benchmarking playback of " + benchRecordingPath);
+	
+	FrameTracer::setThreadName("Control loop");
+	lastTraceDump = chrono::steady_clock::now();
+	chrono::steady_clock::time_point bench_start = chrono::steady_clock::now();
+	enable();
+	startPipeline();
+	// The control timer disables us at the end of playback
+	while(pcgEnabled) {
+		reactor.runOnce(chrono::milliseconds(-1));
+	}
+	// Let every frame already acquired make it out the other end
+	stopPipeline();
+	printBenchReport(chrono::steady_clock::now() - bench_start);
+	
+	dumpTrace();
+	durability.stop();
+	return 0;
+}
+
+// Runs rendered frames through each algorithm profile in turn, on this
+// thread, and prints how fast each made points against how accurate they were.
+int PcgMain::evaluate(char * config_fn) {
+	benchMode = true;
+	evalMode = true;
+	try {
+		init(config_fn);
+	} catch(exception e) {
+		cerr << "The PCG application requires a valid JSON file at "
+			 << (config_fn ? config_fn : DEFAULT_CONFIG_FILENAME) << ".  There was an error opening or parsing:"
+			 << endl << e.what() << endl << "Exiting.";
+		return 1;
+	}
+	logger.logInfo("---------------------------------------------------------");
+	logger.logInfo("Evaluating stereo algorithm profiles on synthetic frames");
+	
+	FrameTracer::setThreadName("Evaluation");
+	img_acquisition.start();
+	for(size_t p = 0; p < img_processing.getNumProfiles(); ++p) {
+		// Takes effect at the next frame
+		img_processing.selectProfile(p);
+		evaluator.beginProfile(img_processing.getProfileName(p), img_processing.getProfileAlgName(p));
+		for(unsigned int i = 0; i < evalFramesPerProfile; ++i) {
+			img_acquisition.beginAcquisition();
+			ImageDataSet images = img_acquisition.acquireImages();
+			img_acquisition.ingest(images);
+			FrameTracer::setCurrentFrame(images.frameId);
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			img_processing.processImages(images);
+			chrono::steady_clock::duration processing_time = chrono::steady_clock::now() - start;
+			evaluator.addFrame(images, img_processing.getPointCloud(), processing_time);
+		}
+	}
+	img_acquisition.stop();
+	
+	string report = evaluator.report();
+	cout << report;
+	logger.logInfo("Stereo algorithm evaluation:\n" + report);
+	dumpTrace();
+	durability.stop();
+	return 0;
+}
+
+void PcgMain::printBenchReport(chrono::steady_clock::duration elapsed) {
+	double elapsed_s = chrono::duration<double>(elapsed).count();
+	int num_frames = bmProcStage.getIterations();
+	int num_clouds = bmOutputStage.getIterations();
+	long long num_points = bmOutputStage.getItemsProcessed();
+	
+	stringstream ss;
+	ss << fixed << setprecision(2);
+	ss << "Benchmark of " << benchRecordingPath << endl;
+	ss << num_frames << " frames in " << elapsed_s << "s: "
+	   << (elapsed_s > 0 ? num_frames / elapsed_s : 0) << " frames/s" << endl;
+	ss << num_clouds << " point clouds, " << num_points << " points total, "
+	   << (num_clouds > 0 ? (double)num_points / num_clouds : 0) << " points/cloud avg" << endl;
+	ss << endl << left << setw(50) << "Stage" << right
+	   << setw(8) << "n" << setw(10) << "p50 ms" << setw(10) << "p90 ms"
+	   << setw(10) << "p99 ms" << setw(10) << "max ms" << endl;
+	for(auto bm = allBms.begin(); bm != allBms.end(); ++bm) {
+		if(!(*bm)->isTimed() || (*bm)->getIterations() == 0) { continue; }
+		ss << left << setw(50) << (*bm)->getName() << right
+		   << setw(8)  << (*bm)->getIterations()
+		   << setw(10) << (*bm)->getPercentileMs(50)
+		   << setw(10) << (*bm)->getPercentileMs(90)
+		   << setw(10) << (*bm)->getPercentileMs(99)
+		   << setw(10) << (*bm)->getPercentileMs(100) << endl;
+	}
+	for(auto bm = allBms.begin(); bm != allBms.end(); ++bm) {
+		if((*bm)->isTimed() || (*bm)->getIterations() == 0) { continue; }
+		ss << (*bm)->getName() << ": " << (*bm)->getIterations() << " occurrences";
+		if((*bm)->getAvgItemsProcessed() > 0) {
+			ss << ", " << (*bm)->getAvgItemsProcessed() << " avg items";
+		}
+		ss << "." << endl;
+	}
+	
+	cout << ss.str();
+	logger.logInfo(ss.str());
+}
+
+void PcgMain::handleLidar() {
+	lidar.handleIncomingData();
+
+	// The LIDAR currently scans a full circle faster than
+	// the rest of the code runs.  So we usually have a valid point cloud.
+	if(lidar.isNewPcAvail()) {
+		chrono::time_point<chrono::system_clock> acq_time = lidar.getLastPcAcquisitionTime();
+		PointCloudDataMessage * cloud = lidar.popPointCloud();
 		
-		// Store attitude
-		attitude_tracker.estimateAttitude();
+		// Use false data for testing
+		// DummyPointCloud dpc;
+		// cloud = dpc.getMsg();
 		
-		// Process images
-		if(pcgEnabled) {
-			ImageDataSet image_data;
-			if(useStereoCams) {
-				image_data = img_acquisition.acquireImages();
-				// logger.logDebug(img_acquisition.isPlaybackEnabled() ? "Playback is enabled." : "Playback is disabled.");
-				// logger.logDebug(img_acquisition.isPlaybackComplete()? "Playback is complete." : "Playback is incomplete.");
-				if(img_acquisition.isPlaybackEnabled() && img_acquisition.isPlaybackComplete()) {
-					logger.logInfo("Reached end of playback.");
-					disable();
-				} else {
-					img_processing.processImages(image_data);
-				}
-			} 
-			if(useLidar) {
-				lidar.handleIncomingData();
-
-				// The LIDAR currently scans a full circle faster than
-				// the rest of the code runs.  So we usually have a valid point cloud.
-				if(lidar.isNewPcAvail()) {
-					chrono::system_clock::duration acq_timestamp = lidar.getLastPcAcquisitionTime().time_since_epoch();
-					PointCloudDataMessage * cloud = lidar.popPointCloud();
-					
-					// Use false data for testing
-					// DummyPointCloud dpc;
-					// cloud = dpc.getMsg();
-					
-					if(cloud != NULL && cloud->getNumPointsThisMsg() > 0) {
-						if(correctLidarPointCloud) {
-							affineTransformPointCloud(cloud, lidarTransform);
-						}
-						
-						PointCloudMetadataMessage metadata;
-						cloud->  setPointCloudSeqNum        (pc_seq);
-						metadata.setPointCloudSeqNum        (pc_seq);
-						metadata.setNumPktsThisPointCloud   (1);
-						metadata.setNumPointsThisPointCloud (cloud->getNumPointsThisMsg());
-						metadata.setOpticalDataCaptureTimeS (chrono::duration_cast<chrono::seconds>     (acq_timestamp).count());
-						metadata.setOpticalDataCaptureTimeMs(chrono::duration_cast<chrono::milliseconds>(acq_timestamp).count() % 1000);
-						metadata.setTimeSpentProcessingMs   (0); // TODO
-						metadata.setPointCloudSource        (PointCloudSource::LIDAR_DOWNSAMPLED);
-						
-											stringstream lidarSs;
-						lidarSs << "Sending " << cloud->getNumPointsThisMsg() << " LIDAR points.";
-						logger.logDebug(lidarSs.str());
-
-						messaging.sendMessage(&metadata);
-						messaging.sendMessage(cloud);
-						if(outputPcRecEnabled) {
-							saveOutputPcToFile(&metadata, cloud);
-						}
-						pc_seq++;
-					} else {
-						logger.logDebug("No LIDAR point cloud to send this iteration.");
-					}
-				} else {
-					logger.logDebug("No fresh LIDAR point cloud to send this iteration.");
-				}
-			}
-			
-			// Get the next one started
-			img_acquisition.beginAcquisition();
+		if(cloud != NULL && cloud->getNumPointsThisMsg() > 0) {
+			shared_ptr<PipelineFrame> frame(new PipelineFrame());
+			frame->source          = PointCloudSource::LIDAR_DOWNSAMPLED;
+			frame->acquisitionTime = acq_time;
+			// The reader reuses its buffer, so take a copy
+			frame->setCloud(cloudPool.copyOf(cloud));
 			
-			// Send out point cloud
-			if(useStereoCams) {
-				if(img_processing.isPointCloudAvailable()) {
-					PointCloudDataMessage * cloud = img_processing.getPointCloud();
-
-					// Use false data for testing
-					// DummyPointCloud dpc;
-					// cloud = dpc.getMsg();
-					
-					if(correctStereoPointCloud) {
-						affineTransformPointCloud(cloud, stereoTransform);
-					}
-
-					// chrono::system_clock::duration now = chrono::system_clock::now().time_since_epoch();
-					// chrono::duration_cast<chrono::milliseconds>(acq_timestamp).count() % 1000;
-					PointCloudMetadataMessage metadata;
-					cloud->  setPointCloudSeqNum        (pc_seq);
-					metadata.setPointCloudSeqNum        (pc_seq);
-					metadata.setNumPktsThisPointCloud   (1);
-					metadata.setNumPointsThisPointCloud (cloud->getNumPointsThisMsg());
-					metadata.setOpticalDataCaptureTimeS (image_data.getTimeAcquiredS() );
-					metadata.setOpticalDataCaptureTimeMs(image_data.getTimeAcquiredMs());
-					metadata.setTimeSpentProcessingMs   (image_data.getDurationSinceAcquiredMs());
-					metadata.setPointCloudSource        (PointCloudSource::VIS_LIGHT_STEREO);
-					
-					messaging.sendMessage(&metadata);
-					messaging.sendMessage(cloud);
-					pc_seq++;
-				} else {
-					logger.logDebug("No stereo point cloud to send this iteration.");
+			if(frame->getCloud() != NULL) {
+				stringstream lidarSs;
+				lidarSs << "Sending " << cloud->getNumPointsThisMsg() << " LIDAR points.";
+				logger.logDebug(lidarSs.str());
+				// This is the control thread, so never wait on the output
+				// stage.  The next scan will be along shortly.
+				if(!outputQueue.tryPush(frame)) {
+					bmDroppedLidar.count();
+					logger.logDebug("Output fell behind; dropped a LIDAR point cloud.");
 				}
-			} 
-			
-			summarizeBenchmarksToLog();
-			
-			// Sometimes we wish to sleep after processing, due to a max frame rate
-			// or due to a preferred playback rate.
-			// TODO: reduce sleep time based on how long the processing took.
-			// TODO: add an optional frame rate cap
-			chrono::system_clock::duration sleep_time = chrono::milliseconds(0);
-			if(img_acquisition.isPlaybackEnabled()) {
-				sleep_time = img_acquisition.getFrameDelay();
-			} else {
-				sleep_time = std::chrono::milliseconds(0);;
 			}
-			stringstream ss;
-			ss << "Sleeping for " << chrono::duration_cast<chrono::milliseconds>(sleep_time).count()
-				<< "ms between frames.";
-			logger.logInfo(ss.str());
-			if(img_processing.areCvWindowsOpen()) {
-				// We need a GUI-friendly form of sleep for the debug windows to update
-				int ms_to_sleep = chrono::duration_cast<chrono::milliseconds>(sleep_time).count();
-				if(ms_to_sleep <= 0) { ms_to_sleep = 1; };
-				cv::waitKey(ms_to_sleep);
-			} else {
-				// Standard C++11 sleep
-				this_thread::sleep_for(sleep_time);
+		} else {
+			logger.logDebug("No LIDAR point cloud to send this iteration.");
+		}
+	} else {
+		logger.logDebug("No fresh LIDAR point cloud to send this iteration.");
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Pipeline stages.  Each runs on its own thread.
+////////////////////////////////////////////////////////////
+
+void PcgMain::startPipeline() {
+	// With latestFrameWins, acquisition hands processing a single-slot
+	// mailbox instead.  A frame still waiting there when the next one
+	// arrives is stale, and gets dropped.
+	processingQueue.setCapacity(latestFrameWins ? 1 : pipelineQueueDepth);
+	outputQueue    .setCapacity(pipelineQueueDepth);
+	recordingQueue .setCapacity(pipelineQueueDepth);
+	pipelineRunning = true;
+	stageThreads.push_back(thread(&PcgMain::recordingStage,   this));
+	stageThreads.push_back(thread(&PcgMain::outputStage,      this));
+	stageThreads.push_back(thread(&PcgMain::processingStage,  this));
+	stageThreads.push_back(thread(&PcgMain::acquisitionStage, this));
+}
+
+// Stops acquiring, then lets the downstream stages drain in order.
+void PcgMain::stopPipeline() {
+	{
+		lock_guard<mutex> lock(acquisitionMutex);
+		pipelineRunning = false;
+	}
+	acquisitionCv.notify_all();
+	for(auto &t : stageThreads) {
+		t.join();
+	}
+	stageThreads.clear();
+}
+
+void PcgMain::acquisitionStage() {
+	FrameTracer::setThreadName("Acquisition stage");
+	while(true) {
+		unique_lock<mutex> lock(acquisitionMutex);
+		acquisitionCv.wait(lock, [this]{
+			return !pipelineRunning || (pcgEnabled && useStereoCams && !playbackFinished);
+		});
+		if(!pipelineRunning) { break; }
+		// Don't hold the lock while we wait on the cameras
+		acquiring = true;
+		bool triggered = acquisitionTriggered;
+		lock.unlock();
+		
+		bmImageAcq.start();
+		if(!triggered) {
+			img_acquisition.beginAcquisition();
+		}
+		shared_ptr<PipelineFrame> frame(new PipelineFrame());
+		frame->images = img_acquisition.acquireImages();
+		FrameTracer::setCurrentFrame(frame->images.frameId);
+		frame->source = PointCloudSource::VIS_LIGHT_STEREO;
+		frame->acquisitionTime = frame->images.acquisitionTime;
+		// logger.logDebug(img_acquisition.isPlaybackEnabled() ? "Playback is enabled." : "Playback is disabled.");
+		// logger.logDebug(img_acquisition.isPlaybackComplete()? "Playback is complete." : "Playback is incomplete.");
+		bool playback = img_acquisition.isPlaybackEnabled();
+		bool playback_done = playback && img_acquisition.isPlaybackComplete();
+		
+		// Get the next one started, so it's exposed and read out while
+		// this one is being processed.  When pacing frames, the trigger
+		// instead waits for the next deadline, so the frame isn't stale.
+		triggered = !playback_done && !frameScheduler.isPacing(playback);
+		if(triggered) {
+			img_acquisition.beginAcquisition();
+		}
+		chrono::system_clock::duration recorded_delay = playback ?
+			img_acquisition.getFrameDelay() : chrono::system_clock::duration(0);
+		bmImageAcq.end();
+		
+		lock.lock();
+		acquiring = false;
+		acquisitionTriggered = triggered;
+		// The control loop will disable us
+		if(playback_done) { playbackFinished = true; }
+		lock.unlock();
+		acquisitionCv.notify_all();
+		if(playback_done) { continue; }
+		
+		if(img_acquisition.isRecordEnabled()) {
+			imageRecorder.submit(frame->images);
+		}
+		// Processing sees only the ingest window; recordings keep full frames
+		img_acquisition.ingest(frame->images);
+		if(latestFrameWins) {
+			bool dropped = false;
+			processingQueue.pushDroppingOldest(frame, dropped);
+			if(dropped) {
+				bmDroppedFrames.count();
+				logger.logDebug("Processing fell behind; dropped a stale frame.");
 			}
 		} else {
-			// To avoid spinlock, it's important that messaging.setBlockingListen(true);
-			// was called before this point.
+			processingQueue.push(frame);
 		}
-		// OS call to flush all file buffers
-		bmSyncFs.start();
-		sync();
-		bmSyncFs.end();
 		
-		bmOneFrame.end();
+		// Sometimes we wish to wait between frames, due to a max frame rate
+		// or due to a preferred playback rate.
+		frameScheduler.waitForNextFrame(playback, recorded_delay);
+	}
+	processingQueue.close();
+}
+
+void PcgMain::processingStage() {
+	FrameTracer::setThreadName("Stereo processing stage");
+	shared_ptr<PipelineFrame> frame;
+	while(processingQueue.pop(frame)) {
+		FrameTracer::setCurrentFrame(frame->images.frameId);
+		bmProcStage.start();
+		img_processing.processImages(frame->images);
+		bool have_cloud = img_processing.isPointCloudAvailable();
+		if(have_cloud) {
+			frame->setCloud(img_processing.takePointCloud());
+			// The pool counts and logs it if it's run dry
+			have_cloud = (frame->getCloud() != NULL);
+		} else {
+			logger.logDebug("No stereo point cloud to send this iteration.");
+		}
+		bmProcStage.end();
+		
+		if(have_cloud) {
+			outputQueue.push(frame);
+		}
+		summarizeBenchmarksToLog();
+		if(img_processing.areCvWindowsOpen()) {
+			// The debug windows belong to this thread, and only
+			// update while it waits on a key.
+			cv::waitKey(1);
+		}
+	}
+	outputQueue.close();
+}
+
+void PcgMain::outputStage() {
+	FrameTracer::setThreadName("Transform and send stage");
+	uint16_t pc_seq = 0;
+	shared_ptr<PipelineFrame> frame;
+	while(outputQueue.pop(frame)) {
+		FrameTracer::setCurrentFrame(frame->images.frameId);
+		bmOutputStage.start();
+		PointCloudDataMessage * cloud = frame->getCloud();
+		bool is_lidar = (frame->source == PointCloudSource::LIDAR_DOWNSAMPLED);
+		
+		// Use false data for testing
+		// DummyPointCloud dpc;
+		// cloud = dpc.getMsg();
+		
+		if(is_lidar && correctLidarPointCloud) {
+			affineTransformPointCloud(cloud, lidarTransform);
+		} else if(!is_lidar && correctStereoPointCloud) {
+			affineTransformPointCloud(cloud, stereoTransform);
+		}
+
+		chrono::system_clock::duration acq_timestamp = frame->acquisitionTime.time_since_epoch();
+		PointCloudMetadataMessage &metadata = frame->metadata;
+		cloud->  setPointCloudSeqNum        (pc_seq);
+		metadata.setPointCloudSeqNum        (pc_seq);
+		metadata.setNumPktsThisPointCloud   (1);
+		metadata.setNumPointsThisPointCloud (cloud->getNumPointsThisMsg());
+		metadata.setOpticalDataCaptureTimeS (chrono::duration_cast<chrono::seconds>     (acq_timestamp).count());
+		metadata.setOpticalDataCaptureTimeMs(chrono::duration_cast<chrono::milliseconds>(acq_timestamp).count() % 1000);
+		metadata.setTimeSpentProcessingMs   (is_lidar ? 0 : frame->images.getDurationSinceAcquiredMs()); // TODO for LIDAR
+		metadata.setPointCloudSource        (frame->source);
+		
+		bmSending.start();
+		messaging.sendMessage(&metadata);
+		messaging.sendMessage(cloud);
+		bmSending.end();
+		pc_seq++;
+		bmOutputStage.end(cloud->getNumPointsThisMsg());
+		
+		if(outputPcRecEnabled) {
+			recordingQueue.push(frame);
+		}
+	}
+	recordingQueue.close();
+}
+
+void PcgMain::recordingStage() {
+	FrameTracer::setThreadName("Recording stage");
+	shared_ptr<PipelineFrame> frame;
+	while(recordingQueue.pop(frame)) {
+		FrameTracer::setCurrentFrame(frame->images.frameId);
+		bmRecordStage.start();
+		saveOutputPcToFile(&frame->metadata, frame->getCloud());
+		bmRecordStage.end();
+		// Drop our reference promptly; the frame may be holding large images
+		frame.reset();
 	}
-	
-	return 0;
 }
 
 // Apply the given transformation matrix, on the CPU.
@@ -417,15 +790,54 @@ void PcgMain::saveOutputPcToFile(PointCloudMetadataMessage *md, PointCloudDataMe
 	}
 
 	outfile.close();
+	durability.trackNewFile(path.str());
 	logger.logDebug("Saving complete.");
 	bmSaveFiles.pause(1);
 }
 
+// Write the frame trace ring into the recording directory.  Waits for
+// any background dump first, so two never write the file at once.
+void PcgMain::dumpTrace() {
+	if(traceDumpThread.joinable()) { traceDumpThread.join(); }
+	writeTrace();
+}
+
+// The same, from a thread of its own.  Skipped if the last one is still
+// being written.
+void PcgMain::dumpTraceInBackground() {
+	if(traceDumpBusy) {
+		logger.logDebug("Still writing the last frame trace; skipping this one.");
+		return;
+	}
+	if(traceDumpThread.joinable()) { traceDumpThread.join(); }
+	traceDumpBusy = true;
+	traceDumpThread = thread([this]{
+		writeTrace();
+		traceDumpBusy = false;
+	});
+}
+
+void PcgMain::writeTrace() {
+	string path = FrameTracer::dump();
+	if(path != "") {
+		durability.trackNewFile(path);
+		logger.logDebug("Wrote frame trace to " + path);
+	}
+}
+
 // Iterate through allBms and write a summary of benchmarkers
 // to the logger object
 void PcgMain::summarizeBenchmarksToLog() {
 	stringstream ss;
 	for(auto bm = allBms.begin(); bm != allBms.end(); ++bm) {
+		if(!(*bm)->isTimed()) {
+			ss << endl << (*bm)->getName() << ": " << (*bm)->getIterations() << " occurrences";
+			if((*bm)->getAvgItemsProcessed() > 0) {
+				ss << ", " << (*bm)->getAvgItemsProcessed() << " avg items";
+			}
+			ss << ".";
+			continue;
+		}
 		ss << endl << (*bm)->getName() << ": "  << (*bm)->getAvgMs() << "ms avg";
 		if((*bm)->getAvgItemsProcessed() > 0) {
 			ss << ", " << (*bm)->getAvgItemsProcessed() << " avg items";
@@ -441,8 +853,21 @@ int main(int argc, char ** argv)
 {
 	PcgMain pcg;
 	
-	// We currently support exactly one argument, which is optional:
-	// the path to the configuration file.
+	// Usage: pcg [config file]
+	//        pcg --bench <recording dir> [config file]
+	//        pcg --evaluate [config file]
+	if(argc > 1 && string(argv[1]) == "--evaluate") {
+		return pcg.evaluate((argc > 2) ? argv[2] : NULL);
+	}
+	if(argc > 1 && string(argv[1]) == "--bench") {
+		if(argc < 3) {
+			cerr << "Usage: " << argv[0] << " --bench <recording dir> [config file]" << endl;
+			return 1;
+		}
+		return pcg.bench(argv[2], (argc > 3) ? argv[3] : NULL);
+	}
+	
+	// Otherwise, the only argument is optional: the path to the configuration file.
 	char * config_fn = NULL;
 	if(argc > 1) {
 		config_fn = argv[1];
@@ -10,17 +10,20 @@
 using namespace std;
  
 void Messaging::test() {
-	Messaging module;
+	list<const Benchmarker *> bms;
+	Messaging module(&bms);
+	module.recvPool.init(1, MSGING_RECV_BUFFER_SIZE_B, false, NULL);
 	module.initSend();
 	module.initListen();
 	
 	cout << "Testing receive.  Waiting for packet." << endl;
-	Msg* msg_in = NULL;
+	MsgBufferPool::Buffer msg_buf;
 	while(1) {
-		while (msg_in == NULL) {
-			msg_in = module.checkForMessage();
+		while (!msg_buf) {
+			msg_buf = module.checkForMessage();
 			usleep(1000);
 		}
+		Msg * msg_in = (Msg*)msg_buf.get();
 		cout << "Got a message of type 0x" << hex << setw(4) << msg_in->getMsgId() <<
 			", size 0x" <<  msg_in->getLenB() << " bytes." << endl;
 			
@@ -60,13 +63,16 @@ void Messaging::test() {
 			case SHUTDOWN_PCG:
 				cout << "Commanded to shutdown." << endl;
 			break;
+			case SELECT_STEREO_ALG:
+				cout << "Commanded to use stereo algorithm profile "
+				     << dec << ((SelectStereoAlgorithmMsg *)msg_in)->getProfileIdx() << "." << endl;
+			break;
 			default:
 				cout << "Unrecognized MID 0x" << hex << setw(4) << msg_in->getMsgId() << endl;
 			break;
 		}
 		
-		delete[] msg_in;
-		msg_in = NULL;
+		msg_buf.reset();
 	}
 }
 
@@ -81,6 +87,8 @@ void Messaging::init(json options, Logger * lgr) {
 		cur_key = "remoteDestPort";      remoteDestPort      = options[cur_key];
 		cur_key = "dataSourcePort";      dataSourcePort      = options[cur_key];
 		cur_key = "cmdRespSourcePort";   cmdRespSourcePort   = options[cur_key];
+		cur_key = "numRecvBuffers"; size_t num_recv_buffers  = options[cur_key];
+		recvPool.init(num_recv_buffers, MSGING_RECV_BUFFER_SIZE_B, false, logger);
 	} catch (domain_error e) {
 		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
 			 << endl << "While reading key \"" << cur_key << "\" in acquisition section: "
@@ -165,14 +173,15 @@ void Messaging::sendMessage(const Msg * msg) {
 	}
 }
 
-Msg * Messaging::checkForMessage() {
-	if(!listening) { return NULL; }
+MsgBufferPool::Buffer Messaging::checkForMessage() {
+	if(!listening) { return MsgBufferPool::Buffer(); }
 	
 	// Copy any new data into the buffer
-	Msg * ret_msg = NULL;
+	MsgBufferPool::Buffer ret_msg;
 	struct sockaddr_in sender_address;
 	unsigned int sender_addr_len = sizeof(sender_address);
-	int bytes_rxd = recvfrom(sockInbound, incomingMsgStart, MSGING_RECV_BUFFER_SIZE_B - incomingMsgBytesReceived, 0,
+	char * recv_end = incomingMsgStart + incomingMsgBytesReceived;
+	int bytes_rxd = recvfrom(sockInbound, recv_end, MSGING_RECV_BUFFER_SIZE_B - (recv_end - recvBuffer), 0,
 		(struct sockaddr*)&sender_address, &sender_addr_len);
 	if(bytes_rxd == -1) {
 		// This is probably due to a lack of message waiting for us
@@ -191,18 +200,17 @@ Msg * Messaging::checkForMessage() {
 	if(incomingMsgBytesReceived >= sizeof(Msg)) {
 		// We have enough to start trying to make sense of the message
 		size_t msg_len = ((Msg*)incomingMsgStart)->getLenB() ;
-		if(msg_len >= incomingMsgBytesReceived) {
-			// We have this entire message
-			ret_msg = (Msg*)new char[msg_len];
-			memcpy((void*)ret_msg, incomingMsgStart, msg_len);
-			incomingMsgStart += msg_len;
-			incomingMsgBytesReceived -= msg_len;
-			
-			// If the buffer was left empty by that, jump back to the beginning
-			if(incomingMsgBytesReceived == 0) {
-				incomingMsgStart = recvBuffer;
-			} else {
-				// The buffer has at least the start of another message
+		if(msg_len < sizeof(Msg)) {
+			// Can't be a real message, and we'd never get past it
+			logger->logWarning("Received a malformed message header; discarding buffer.");
+			incomingMsgStart = recvBuffer;
+			incomingMsgBytesReceived = 0;
+		} else if(msg_len <= incomingMsgBytesReceived) {
+			// We have this entire message.  If there's no buffer for it,
+			// leave it where it is and try again next time.
+			ret_msg = recvPool.copyOf((Msg*)incomingMsgStart);
+			if(ret_msg) {
+				consumeMessage(msg_len);
 			}
 		} else {
 			// We only have a chunk of this message
@@ -220,4 +228,30 @@ Msg * Messaging::checkForMessage() {
 	}
 	
 	return ret_msg;
-}
\ No newline at end of file
+}
+
+void Messaging::consumeMessage(size_t msg_len) {
+	incomingMsgStart += msg_len;
+	incomingMsgBytesReceived -= msg_len;
+	
+	// If the buffer was left empty by that, jump back to the beginning
+	if(incomingMsgBytesReceived == 0) {
+		incomingMsgStart = recvBuffer;
+	} else {
+		// The buffer has at least the start of another message
+	}
+}
+
+const Msg * Messaging::peekPendingMessage() const {
+	if(incomingMsgBytesReceived < sizeof(Msg)) { return NULL; }
+	size_t msg_len = ((const Msg*)incomingMsgStart)->getLenB();
+	if(msg_len < sizeof(Msg) || msg_len > incomingMsgBytesReceived) { return NULL; }
+	return (const Msg*)incomingMsgStart;
+}
+
+void Messaging::discardPendingMessage() {
+	const Msg * pending = peekPendingMessage();
+	if(pending != NULL) {
+		consumeMessage(pending->getLenB());
+	}
+}
@@ -0,0 +1,82 @@
+/*
+	msgBufferPool.cpp
+
+	Fixed-capacity pool of message buffers.
+*/
+
+#include <msgBufferPool.h>
+using namespace std;
+
+void MsgBufferPool::init(json options, Logger * lgr) {
+	// Load configuration options
+	string cur_key = "";
+	size_t num_buffers = 0;
+	size_t buffer_bytes = 0;
+	bool double_buffer = false;
+	try {
+		cur_key = "numBuffers";   num_buffers   = options[cur_key];
+		cur_key = "bufferBytes";  buffer_bytes  = options[cur_key];
+		cur_key = "doubleBuffer"; double_buffer = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in message buffer pool section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	init(num_buffers, buffer_bytes, double_buffer, lgr);
+}
+
+void MsgBufferPool::init(size_t num_buffers, size_t buffer_bytes, bool double_buffer, Logger * lgr) {
+	lock_guard<mutex> lk(lock);
+	logger = lgr;
+	doubleBuffer = double_buffer;
+	numBuffers = num_buffers;
+	// Keep every buffer 8-byte aligned
+	bufferBytes = (buffer_bytes + 7) & ~(size_t)7;
+	storage.assign(numBuffers * bufferBytes, 0);
+	freeBuffers.clear();
+	for(size_t i = 0; i < numBuffers; ++i) {
+		freeBuffers.push_back(storage.data() + i * bufferBytes);
+	}
+	lowWaterMark = numBuffers;
+}
+
+MsgBufferPool::Buffer MsgBufferPool::acquire(size_t bytes) {
+	Releaser releaser;
+	releaser.pool = this;
+	char * buf = NULL;
+	{
+		lock_guard<mutex> lk(lock);
+		if(bytes <= bufferBytes && !freeBuffers.empty()) {
+			buf = freeBuffers.back();
+			freeBuffers.pop_back();
+			if(freeBuffers.size() < lowWaterMark) { lowWaterMark = freeBuffers.size(); }
+		} else {
+			bmExhausted.count();
+		}
+	}
+	if(buf == NULL && logger != NULL) {
+		stringstream ss;
+		if(bytes > bufferBytes) {
+			ss << bmExhausted.getName() << ": asked for " << bytes << " bytes, buffers hold " << bufferBytes << ".";
+		} else {
+			ss << bmExhausted.getName() << ": all " << numBuffers << " buffers in use ("
+			   << bmExhausted.getIterations() << " times so far).";
+		}
+		logger->logWarning(ss.str());
+	}
+	return Buffer(buf, releaser);
+}
+
+MsgBufferPool::Buffer MsgBufferPool::copyOf(const Msg * msg) {
+	Buffer buf = acquire(msg->getLenB());
+	if(buf) {
+		memcpy(buf.get(), msg, msg->getLenB());
+	}
+	return buf;
+}
+
+void MsgBufferPool::release(char * buf) {
+	lock_guard<mutex> lk(lock);
+	freeBuffers.push_back(buf);
+}
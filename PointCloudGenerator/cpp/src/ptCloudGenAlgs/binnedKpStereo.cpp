@@ -0,0 +1,200 @@
+/*
+	binnedKpStereo.cpp
+
+	FAST keypoints, binned by row and described with ORB, matched between
+	left and right images.  Uses CPU.
+*/
+
+#include <ptCloudGenAlgs/binnedKpStereo.h>
+
+using namespace std;
+
+const unsigned int BinnedKpStereo::MAX_NUM_BINS;
+const int BinnedKpStereo::ORB_EDGE_PX;
+
+void BinnedKpStereo::init(json alg_section, string section_name, Logger * lgr, TaskPool * pool) {
+	logger = lgr;
+	taskPool = pool;
+
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "blurKernelSize";       blurKernelSize       = alg_section[cur_key];
+		cur_key = "fastThreshold";        fastThreshold        = alg_section[cur_key];
+		cur_key = "orbMaxDescs";          orbMaxDescs          = alg_section[cur_key];
+		cur_key = "numBins";              numBins              = alg_section[cur_key];
+		cur_key = "minImprovementFactor"; minImprovementFactor = alg_section[cur_key];
+		cur_key = "minDisparityPx";       minDisparityPx       = alg_section[cur_key];
+		cur_key = "maxDisparityPx";       maxDisparityPx       = alg_section[cur_key];
+		cur_key = "maxRowDiffPx";         maxRowDiffPx         = alg_section[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in " << section_name << ": "
+			 << e.what() << endl;
+		throw(e);
+	}
+	if(numBins < 1 || numBins > MAX_NUM_BINS) {
+		stringstream ss;
+		ss << "numBins must be between 1 and " << MAX_NUM_BINS << "; clamping.";
+		logger->logWarning(ss.str());
+		numBins = max(1u, min(numBins, MAX_NUM_BINS));
+	}
+
+	matcher.init(maxRowDiffPx, minDisparityPx, maxDisparityPx, minImprovementFactor);
+
+	// Only ever asked to describe keypoints we found, at full scale
+	for(int side = 0; side < 2; ++side) {
+		for(unsigned int bin = 0; bin < numBins; ++bin) {
+			orbAlgs[side][bin] = cv::ORB::create(orbMaxDescs, 1.2f, 1, ORB_EDGE_PX, 0, 2,
+				cv::ORB::HARRIS_SCORE, ORB_EDGE_PX, fastThreshold);
+		}
+	}
+}
+
+// FAST on one bin's rows, straight into the bin, then just the strongest
+// keypoints, so that every band of the image gets its share of the
+// descriptors.  Ties go to position, so the selection is repeatable.
+void BinnedKpStereo::findBinKps(int side, unsigned int bin) {
+	ImageKps &ik = imgKps[side];
+	vector<KeyPoint> &kps = ik.binKps[bin];
+	kps.clear();
+	ik.fastDets[bin].detect(ik.blurred, binStartRow(bin, ik.blurred.rows), binStartRow(bin + 1, ik.blurred.rows),
+		fastThreshold, ORB_EDGE_PX, kps);
+
+	size_t max_kps = max(1u, (unsigned int)orbMaxDescs / numBins);
+	if(kps.size() > max_kps) {
+		nth_element(kps.begin(), kps.begin() + max_kps, kps.end(), [](const KeyPoint &a, const KeyPoint &b) {
+			if(a.response != b.response) { return a.response > b.response; }
+			if(a.pt.y     != b.pt.y    ) { return a.pt.y     < b.pt.y    ; }
+			return a.pt.x < b.pt.x;
+		});
+		kps.resize(max_kps);
+	}
+}
+
+// ORB on one bin's rows.  ORB pads and blurs whatever image it's given,
+// so hand it just the bin and enough rows around it for its patches,
+// rather than the whole image once per bin.  ORB can't have dropped any
+// keypoints, since none are near the edges.
+void BinnedKpStereo::computeDesc(int side, unsigned int bin) {
+	ImageKps &ik = imgKps[side];
+	vector<KeyPoint> &kps = ik.binKps[bin];
+	if(kps.empty()) { return; }
+	const Mat &img = ik.blurred;
+	int top    = max(0,        binStartRow(bin,     img.rows) - ORB_EDGE_PX);
+	int bottom = min(img.rows, binStartRow(bin + 1, img.rows) + ORB_EDGE_PX);
+	for(auto &kp : kps) { kp.pt.y -= top; }
+	orbAlgs[side][bin]->compute(img.rowRange(top, bottom), kps, ik.binDesc[bin]);
+	for(auto &kp : kps) { kp.pt.y += top; }
+	CV_Assert((int)kps.size() == ik.binDesc[bin].rows && ik.binDesc[bin].cols == EpipolarMatcher::DESC_BYTES);
+}
+
+// Moves the bin's keypoints, dropping those the mover can't place along
+// with their descriptors
+void BinnedKpStereo::moveBinKps(int side, unsigned int bin, const KpMover &mover) {
+	vector<KeyPoint> &kps = imgKps[side].binKps[bin];
+	Mat &desc = imgKps[side].binDesc[bin];
+	size_t kept = 0;
+	for(size_t i = 0; i < kps.size(); ++i) {
+		KeyPoint kp = kps[i];
+		if(!mover(side, kp.pt)) { continue; }
+		if(kept != i) {
+			Mat dest = desc.row(kept);
+			desc.row(i).copyTo(dest);
+		}
+		kps[kept++] = kp;
+	}
+	kps.resize(kept);
+	if(!desc.empty()) { desc = desc.rowRange(0, kept); }
+}
+
+void BinnedKpStereo::layOutBins(int side) {
+	ImageKps &ik = imgKps[side];
+	ik.bin_bound_idx[0] = 0;
+	for(unsigned int bin = 0; bin < numBins; ++bin) {
+		ik.bin_bound_idx[bin + 1] = ik.bin_bound_idx[bin] + ik.binKps[bin].size();
+	}
+	ik.kp.resize(ik.bin_bound_idx[numBins]);
+	ik.desc.create(ik.bin_bound_idx[numBins], EpipolarMatcher::DESC_BYTES, CV_8UC1);
+}
+
+// Into this bin's part of the whole image's keypoints and descriptors
+void BinnedKpStereo::gatherBin(int side, unsigned int bin) {
+	ImageKps &ik = imgKps[side];
+	vector<KeyPoint> &kps = ik.binKps[bin];
+	if(kps.empty()) { return; }
+	unsigned int begin = ik.bin_bound_idx[bin], end = ik.bin_bound_idx[bin + 1];
+	copy(kps.begin(), kps.end(), ik.kp.begin() + begin);
+	Mat desc_slot = ik.desc.rowRange(begin, end);
+	ik.binDesc[bin].copyTo(desc_slot);
+}
+
+size_t BinnedKpStereo::findKps(const Mat &img_l, const Mat &img_r) {
+	const int num_tasks = 2 * numBins;
+
+	bmBlurImage.start();
+	taskPool->parallelFor(0, 2, [&](int side) {
+		const Mat &img = (side == 0) ? img_l : img_r;
+		if(blurKernelSize > 1) {
+			GaussianBlur(img, imgKps[side].blurred, Size(blurKernelSize, blurKernelSize), 0);
+		} else {
+			imgKps[side].blurred = img;
+		}
+	});
+	bmBlurImage.end(2);
+
+	bmFindingKps.start();
+	taskPool->parallelFor(0, num_tasks, [&](int i) { findBinKps(i / numBins, i % numBins); });
+	size_t num_found = 0;
+	for(int side = 0; side < 2; ++side) {
+		for(unsigned int bin = 0; bin < numBins; ++bin) { num_found += imgKps[side].binKps[bin].size(); }
+	}
+	bmFindingKps.end(num_found);
+
+	bmComputingDesc.start();
+	taskPool->parallelFor(0, num_tasks, [&](int i) { computeDesc(i / numBins, i % numBins); });
+	bmComputingDesc.end();
+	return num_found;
+}
+
+void BinnedKpStereo::moveKps(const KpMover &mover) {
+	taskPool->parallelFor(0, 2 * numBins, [&](int i) { moveBinKps(i / numBins, i % numBins, mover); });
+}
+
+// The right keypoints are indexed by row and column, then each bin of
+// left keypoints is matched against whichever lie in their epipolar
+// windows.  The ratio test and disparity limits are applied as they go.
+void BinnedKpStereo::matchKps(size_t max_matches) {
+	bmMatchingKps.start();
+	layOutBins(0);
+	layOutBins(1);
+	taskPool->parallelFor(0, 2 * numBins, [&](int i) { gatherBin(i / numBins, i % numBins); });
+
+	const ImageKps &left = imgKps[0], &right = imgKps[1];
+	matcher.setTrain(right.kp, right.desc);
+	taskPool->parallelFor(0, numBins, [&](int bin) {
+		binMatches[bin].clear();
+		matcher.match(left.kp, left.desc, left.bin_bound_idx[bin], left.bin_bound_idx[bin + 1],
+			binMatches[bin]);
+	});
+	matches.clear();
+	for(unsigned int bin = 0; bin < numBins; ++bin) {
+		matches.insert(matches.end(), binMatches[bin].begin(), binMatches[bin].end());
+	}
+	if(matches.size() > max_matches) { matches.resize(max_matches); }
+	bmMatchingKps.end(matches.size());
+}
+
+void BinnedKpStereo::triangulate(CloudPoint * points, double tri_const, double focal_len_px,
+		double cx, double cy) const {
+	const ImageKps &left = imgKps[0], &right = imgKps[1];
+	for(size_t i = 0; i < matches.size(); ++i) {
+		const Point2f &pt_l = left .kp[matches[i].queryIdx].pt;
+		const Point2f &pt_r = right.kp[matches[i].trainIdx].pt;
+		double depth_m = tri_const / (pt_l.x - pt_r.x) / 100;
+		points[i].setPoint(
+			depth_m,
+			(pt_l.x - cx) * depth_m / focal_len_px,
+			(pt_l.y - cy) * depth_m / focal_len_px);
+	}
+}
@@ -0,0 +1,368 @@
+/*
+	cpuCensusSgm.cpp
+
+	Census-transform semi-global matching.  Uses CPU.
+*/
+
+#include <ptCloudGenAlgs/cpuCensusSgm.h>
+#include <climits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+const int CpuCensusSgm::CENSUS_RADIUS;
+const int CpuCensusSgm::MAX_COST;
+const int CpuCensusSgm::MAX_P2;
+const int CpuCensusSgm::DISP_ALIGN;
+
+// Path costs are at most MAX_COST + MAX_P2, so this is never the
+// cheapest way into a disparity, even with P1 added
+static const int16_t GUARD_COST = 0x3FFF;
+
+void CpuCensusSgm::init(json options, Logger * lgr, StereoCal calData) {
+	CpuPreUndistortAlg::init(options, lgr, calData);
+
+	// Load configuration options
+	string cur_key = "";
+	try {
+		cur_key = "CpuCensusSgmOptions";  json alg_section = options[cur_key];
+		cur_key = "downsample";           downsample           = alg_section[cur_key];
+		cur_key = "minDisparityPx";       minDisparityPx       = alg_section[cur_key];
+		cur_key = "numDisparities";       numDisparities       = alg_section[cur_key];
+		cur_key = "p1";                   p1                   = alg_section[cur_key];
+		cur_key = "p2";                   p2                   = alg_section[cur_key];
+		cur_key = "uniquenessPct";        uniquenessPct        = alg_section[cur_key];
+		cur_key = "numStripes";           numStripes           = alg_section[cur_key];
+		cur_key = "stripeOverlapRows";    stripeOverlapRows    = alg_section[cur_key];
+		cur_key = "pointStridePx";        pointStridePx        = alg_section[cur_key];
+		cur_key = "maxPoints";            maxPoints            = alg_section[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in processing section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	if(downsample != 1 && downsample != 2 && downsample != 4) {
+		throw invalid_argument("CpuCensusSgm downsample must be 1, 2 or 4.");
+	}
+	if(numDisparities <= 0 || numDisparities % DISP_ALIGN != 0 || minDisparityPx < 0) {
+		throw invalid_argument("CpuCensusSgm numDisparities must be a positive multiple of 8, and minDisparityPx non-negative.");
+	}
+	if(p1 <= 0 || p2 < p1 || p2 > MAX_P2) {
+		throw invalid_argument("CpuCensusSgm needs 0 < p1 <= p2 <= 4000.");
+	}
+	if(pointStridePx < 1 || stripeOverlapRows < 0) {
+		throw invalid_argument("CpuCensusSgm pointStridePx must be at least 1, and stripeOverlapRows non-negative.");
+	}
+	// A message holds at most this many points
+	if(maxPoints > maxPointsPerMsg()) {
+		stringstream ss;
+		ss << "CpuCensusSgm maxPoints is more than a message holds; clamping to " << maxPointsPerMsg() << ".";
+		logger->logWarning(ss.str());
+		maxPoints = maxPointsPerMsg();
+	}
+
+	Mat P1 = cal_data.getCpuProjectionMatrixLeft();
+	focalLenPx = P1.at<double>(0, 0);
+	cx         = P1.at<double>(0, 2);
+	cy         = P1.at<double>(1, 2);
+}
+
+void CpuCensusSgm::processImages(ImageDataSet imgData) {
+	if(!imgData.imgVisibleLValid || !imgData.imgVisibleRValid) {
+		clearPointCloud();
+		return;
+	}
+
+	// Parent tasks: undistort into imgLRect, imgRRect
+	CpuPreUndistortAlg::processImages(imgData);
+
+	bmDownsampling.start();
+	if(downsample > 1) {
+		Size small(imgLRect.cols / downsample, imgLRect.rows / downsample);
+		taskPool->parallelFor(0, 2, [&](int side) {
+			cv::resize(side == 0 ? imgLRect : imgRRect, side == 0 ? imgL : imgR, small, 0, 0, INTER_AREA);
+		});
+	} else {
+		imgL = imgLRect;
+		imgR = imgRRect;
+	}
+	bmDownsampling.end();
+
+	// Stripes of rows, for both the census and the matching
+	unsigned int num_stripes = numStripes ? numStripes : 2 * (taskPool->getNumThreads() + 1);
+	num_stripes = max(1u, min(num_stripes, (unsigned int)imgL.rows));
+	stripes.resize(num_stripes);
+	auto stripe_row = [&](unsigned int i) { return (int)((long)i * imgL.rows / num_stripes); };
+
+	bmCensus.start();
+	censusL.create(imgL.size(), CV_32SC1);
+	censusR.create(imgR.size(), CV_32SC1);
+	taskPool->parallelFor(0, 2 * num_stripes, [&](int i) {
+		unsigned int stripe = i / 2;
+		censusTransform(i % 2 == 0 ? imgL : imgR, i % 2 == 0 ? censusL : censusR,
+			stripe_row(stripe), stripe_row(stripe + 1));
+	});
+	bmCensus.end(2);
+
+	bmAggregating.start();
+	disparity.create(imgL.size(), CV_32FC1);
+	taskPool->parallelFor(0, num_stripes, [&](int i) {
+		int first = stripe_row(i), last = stripe_row(i + 1);
+		prepareStripe(stripes[i]);
+		matchStripe(stripes[i], max(0, first - stripeOverlapRows), first, last);
+	});
+	bmAggregating.end(imgL.rows);
+
+	computeStereoPtCloud();
+}
+
+// Each bit says whether a pixel in the 5x5 window is darker than the
+// centre.  Pixels too near the edge for a whole window get 0.
+void CpuCensusSgm::censusTransform(const Mat &img, Mat &census, int first_row, int last_row) {
+	for(int y = first_row; y < last_row; ++y) {
+		int32_t * out = census.ptr<int32_t>(y);
+		if(y < CENSUS_RADIUS || y >= img.rows - CENSUS_RADIUS) {
+			fill(out, out + img.cols, 0);
+			continue;
+		}
+		for(int x = 0; x < img.cols; ++x) {
+			if(x < CENSUS_RADIUS || x >= img.cols - CENSUS_RADIUS) {
+				out[x] = 0;
+				continue;
+			}
+			uint8_t centre = img.ptr<uint8_t>(y)[x];
+			int32_t code = 0;
+			for(int dy = -CENSUS_RADIUS; dy <= CENSUS_RADIUS; ++dy) {
+				const uint8_t * row = img.ptr<uint8_t>(y + dy);
+				for(int dx = -CENSUS_RADIUS; dx <= CENSUS_RADIUS; ++dx) {
+					if(dx == 0 && dy == 0) { continue; }
+					code = (code << 1) | (row[x + dx] < centre);
+				}
+			}
+			out[x] = code;
+		}
+	}
+}
+
+void CpuCensusSgm::prepareStripe(Stripe &stripe) {
+	size_t width = imgL.cols;
+	size_t slot = numDisparities + 2;
+	if(stripe.cost.size() == width * numDisparities && stripe.pathStart.size() == slot) {
+		return;
+	}
+	stripe.cost.assign(width * numDisparities, 0);
+	stripe.sum .assign(width * numDisparities, 0);
+	for(int k = 0; k < 3; ++k) {
+		stripe.pathPrev[k].assign(width * slot, GUARD_COST);
+		stripe.pathCur [k].assign(width * slot, GUARD_COST);
+		stripe.minPrev [k].assign(width, 0);
+		stripe.minCur  [k].assign(width, 0);
+	}
+	stripe.horizPrev.assign(slot, GUARD_COST);
+	stripe.horizCur .assign(slot, GUARD_COST);
+	// Following a path of zeros adds nothing, so a path starts at its cost
+	stripe.pathStart.assign(slot, 0);
+	stripe.pathStart.front() = stripe.pathStart.back() = GUARD_COST;
+}
+
+void CpuCensusSgm::computeCostRow(Stripe &stripe, int y) {
+	const int32_t * census_l = censusL.ptr<int32_t>(y);
+	const int32_t * census_r = censusR.ptr<int32_t>(y);
+	for(int x = 0; x < imgL.cols; ++x) {
+		int16_t * cost = &stripe.cost[x * numDisparities];
+		for(int d = 0; d < numDisparities; ++d) {
+			int x_r = x - minDisparityPx - d;
+			cost[d] = (x_r >= 0) ? __builtin_popcount(census_l[x] ^ census_r[x_r]) : MAX_COST;
+		}
+	}
+}
+
+// One step along a path, for every disparity:
+//   cur[d] = cost[d] + min(prev[d], prev[d -+ 1] + P1, min(prev) + P2) - min(prev)
+// and adds cur into sum.  prev has a guard either side.  Returns min(cur).
+// Ops wraps one instruction set's saturating int16_t operations.
+template<class Ops>
+static int16_t aggregateStep(const int16_t * cost, const int16_t * prev, int16_t min_prev,
+		int16_t * cur, int16_t * sum, int num_disp, int16_t p1, int16_t p2) {
+	typedef typename Ops::V V;
+	const V v_p1 = Ops::set1(p1);
+	const V v_jump = Ops::set1(min_prev + p2);
+	const V v_min_prev = Ops::set1(min_prev);
+	V v_min = Ops::set1(INT16_MAX);
+	for(int d = 0; d < num_disp; d += Ops::WIDTH) {
+		V step = Ops::min(Ops::adds(Ops::load(prev + d - 1), v_p1), Ops::adds(Ops::load(prev + d + 1), v_p1));
+		V best = Ops::min(Ops::min(Ops::load(prev + d), step), v_jump);
+		V lr = Ops::subs(Ops::adds(Ops::load(cost + d), best), v_min_prev);
+		Ops::store(cur + d, lr);
+		Ops::store(sum + d, Ops::adds(Ops::load(sum + d), lr));
+		v_min = Ops::min(v_min, lr);
+	}
+	int16_t lanes[Ops::WIDTH];
+	Ops::store(lanes, v_min);
+	return *min_element(lanes, lanes + Ops::WIDTH);
+}
+
+#if defined(__SSE2__)
+struct Sse2Int16Ops {
+	typedef __m128i V;
+	static const int WIDTH = 8;
+	static V load(const int16_t * p)     { return _mm_loadu_si128((const __m128i *)p); }
+	static void store(int16_t * p, V v)  { _mm_storeu_si128((__m128i *)p, v); }
+	static V set1(int16_t v)             { return _mm_set1_epi16(v); }
+	static V adds(V a, V b)              { return _mm_adds_epi16(a, b); }
+	static V subs(V a, V b)              { return _mm_subs_epi16(a, b); }
+	static V min(V a, V b)               { return _mm_min_epi16(a, b); }
+};
+typedef Sse2Int16Ops Int16Ops;
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+struct NeonInt16Ops {
+	typedef int16x8_t V;
+	static const int WIDTH = 8;
+	static V load(const int16_t * p)     { return vld1q_s16(p); }
+	static void store(int16_t * p, V v)  { vst1q_s16(p, v); }
+	static V set1(int16_t v)             { return vdupq_n_s16(v); }
+	static V adds(V a, V b)              { return vqaddq_s16(a, b); }
+	static V subs(V a, V b)              { return vqsubq_s16(a, b); }
+	static V min(V a, V b)               { return vminq_s16(a, b); }
+};
+typedef NeonInt16Ops Int16Ops;
+#else
+struct ScalarInt16Ops {
+	typedef int16_t V;
+	static const int WIDTH = 1;
+	static V load(const int16_t * p)     { return *p; }
+	static void store(int16_t * p, V v)  { *p = v; }
+	static V set1(int16_t v)             { return v; }
+	static V adds(V a, V b)              { return (V)std::min(a + b, (int)INT16_MAX); }
+	static V subs(V a, V b)              { return (V)std::max(a - b, (int)INT16_MIN); }
+	static V min(V a, V b)               { return std::min(a, b); }
+};
+typedef ScalarInt16Ops Int16Ops;
+#endif
+
+void CpuCensusSgm::matchStripe(Stripe &stripe, int warm_row, int first_row, int last_row) {
+	const int width = imgL.cols;
+	const int num_disp = numDisparities;
+	const int slot = num_disp + 2;
+	// Predecessors of the three paths from the row above: straight down,
+	// down and to the right, and down and to the left
+	const int DX[3] = {0, 1, -1};
+	const int16_t * path_start = &stripe.pathStart[1];
+
+	for(int y = warm_row; y < last_row; ++y) {
+		computeCostRow(stripe, y);
+		fill(stripe.sum.begin(), stripe.sum.end(), 0);
+
+		for(int k = 0; k < 3; ++k) {
+			for(int x = 0; x < width; ++x) {
+				int x_prev = x - DX[k];
+				bool starts = (y == warm_row || x_prev < 0 || x_prev >= width);
+				const int16_t * prev = starts ? path_start : &stripe.pathPrev[k][x_prev * slot + 1];
+				int16_t min_prev = starts ? 0 : stripe.minPrev[k][x_prev];
+				stripe.minCur[k][x] = aggregateStep<Int16Ops>(&stripe.cost[x * num_disp], prev, min_prev,
+					&stripe.pathCur[k][x * slot + 1], &stripe.sum[x * num_disp], num_disp, p1, p2);
+			}
+			swap(stripe.pathPrev[k], stripe.pathCur[k]);
+			swap(stripe.minPrev[k], stripe.minCur[k]);
+		}
+
+		// Along the row, each way, alternating between two buffers
+		for(int dir = 0; dir < 2; ++dir) {
+			const int16_t * prev = path_start;
+			int16_t min_prev = 0;
+			for(int i = 0; i < width; ++i) {
+				int x = (dir == 0) ? i : width - 1 - i;
+				int16_t * cur = (i % 2 == 0) ? &stripe.horizCur[1] : &stripe.horizPrev[1];
+				min_prev = aggregateStep<Int16Ops>(&stripe.cost[x * num_disp], prev, min_prev,
+					cur, &stripe.sum[x * num_disp], num_disp, p1, p2);
+				prev = cur;
+			}
+		}
+
+		if(y >= first_row) {
+			chooseDisparities(stripe, y);
+		}
+	}
+}
+
+// Cheapest disparity, refined to a fraction of a pixel with a parabola
+// through its neighbours.  Left unmatched if another disparity, not next
+// to it, comes within uniquenessPct, or if it's at either end of the range.
+void CpuCensusSgm::chooseDisparities(const Stripe &stripe, int y) {
+	float * out = disparity.ptr<float>(y);
+	const int width = imgL.cols;
+	bool edge_row = (y < CENSUS_RADIUS || y >= imgL.rows - CENSUS_RADIUS);
+	for(int x = 0; x < width; ++x) {
+		out[x] = -1;
+		if(edge_row || x < CENSUS_RADIUS + minDisparityPx || x >= width - CENSUS_RADIUS) { continue; }
+		const int16_t * sum = &stripe.sum[x * numDisparities];
+		int best_d = min_element(sum, sum + numDisparities) - sum;
+		int best = sum[best_d];
+		if(best_d == 0 || best_d == numDisparities - 1) { continue; }
+		bool unique = true;
+		for(int d = 0; d < numDisparities && unique; ++d) {
+			if(abs(d - best_d) > 1 && sum[d] * 100 < best * (100 + uniquenessPct)) {
+				unique = false;
+			}
+		}
+		if(!unique) { continue; }
+		int below = sum[best_d - 1], above = sum[best_d + 1];
+		int curvature = below - 2 * best + above;
+		float offset = (curvature > 0) ? (float)(below - above) / (2 * curvature) : 0;
+		out[x] = minDisparityPx + best_d + offset;
+	}
+}
+
+void CpuCensusSgm::computeStereoPtCloud() {
+	bmComputingDepths.start();
+	// Every pointStridePx'th pixel each way, and then only every so many
+	// of those if there are still too many
+	unsigned int num_valid = 0;
+	for(int v = 0; v < disparity.rows; v += pointStridePx) {
+		const float * row = disparity.ptr<float>(v);
+		for(int u = 0; u < disparity.cols; u += pointStridePx) {
+			if(row[u] > 0) { num_valid++; }
+		}
+	}
+	if(num_valid == 0 || maxPoints == 0) {
+		clearPointCloud();
+		bmComputingDepths.end();
+		return;
+	}
+	unsigned int keep_every = max((num_valid + maxPoints - 1) / maxPoints, 1u);
+	unsigned int num_points = (num_valid + keep_every - 1) / keep_every;
+	if(allocatePointCloud(num_points) == NULL) {
+		logger->logWarning("No point cloud buffer free; skipping this frame's cloud.");
+		bmComputingDepths.end();
+		return;
+	}
+
+	// Back to full-resolution rectified pixels, which the projection
+	// matrix and triangulation constant are for
+	CloudPoint * points = msg->getPointCloud();
+	double tri_const = cal_data.getTriangulationConst();
+	unsigned int seen = 0, kept = 0;
+	for(int v = 0; v < disparity.rows && kept < num_points; v += pointStridePx) {
+		const float * row = disparity.ptr<float>(v);
+		for(int u = 0; u < disparity.cols && kept < num_points; u += pointStridePx) {
+			if(row[u] <= 0) { continue; }
+			if(seen++ % keep_every != 0) { continue; }
+			double u_full = (u + 0.5) * downsample - 0.5;
+			double v_full = (v + 0.5) * downsample - 0.5;
+			double depth_m = tri_const / (row[u] * downsample) / 100;
+			points[kept++].setPoint(
+				depth_m,
+				(u_full - cx) * depth_m / focalLenPx,
+				(v_full - cy) * depth_m / focalLenPx);
+		}
+	}
+	msg->setNumPointsThisMsg(kept);
+	pointCloudValid = true;
+	bmComputingDepths.end(kept);
+}
@@ -0,0 +1,69 @@
+/*
+	cpuFastPostUndistort.cpp
+
+	FAST keypoints, binned by row and described with ORB in the images as
+	they arrive, then rectified and matched.  Uses CPU.
+*/
+
+#include <ptCloudGenAlgs/cpuFastPostUndistort.h>
+
+using namespace std;
+using namespace std::chrono;
+
+void CpuFastPostUndistort::init(json options, Logger * lgr, StereoCal calData) {
+	PostUndistortAlg::init(options, lgr, calData);
+
+	// Load configuration options
+	string cur_key = "";
+	json alg_section;
+	try {
+		cur_key = "CpuFastPostUndistortOptions"; alg_section = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in processing section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	kps.init(alg_section, cur_key, logger, taskPool);
+
+	Mat P1 = cal_data.getCpuProjectionMatrixLeft();
+	focalLenPx = P1.at<double>(0, 0);
+	cx         = P1.at<double>(0, 2);
+	cy         = P1.at<double>(1, 2);
+}
+
+void CpuFastPostUndistort::processImages(ImageDataSet imgData) {
+	if(!imgData.imgVisibleLValid || !imgData.imgVisibleRValid) {
+		clearPointCloud();
+		return;
+	}
+
+	// Parent tasks: flip upright into imgL, imgR if need be
+	PostUndistortAlg::processImages(imgData);
+
+	computeStereoPtClouds();
+}
+
+void CpuFastPostUndistort::computeStereoPtClouds() {
+	size_t num_found = kps.findKps(imgL, imgR);
+
+	// Into rectified coordinates, before matching along epipolar lines
+	bmUndistortKps.start();
+	kps.moveKps([this](int side, Point2f &pt) { return rectifyPoint(side, pt); });
+	bmUndistortKps.end(num_found);
+
+	// A message holds at most this many points
+	kps.matchKps(maxPointsPerMsg());
+
+	bmComputingDepths.start();
+	size_t num_matches = kps.getNumMatches();
+	if(allocatePointCloud(num_matches) == NULL) {
+		logger->logWarning("No point cloud buffer free; skipping this frame's cloud.");
+		bmComputingDepths.end();
+		return;
+	}
+	kps.triangulate(msg->getPointCloud(), cal_data.getTriangulationConst(), focalLenPx, cx, cy);
+	msg->setNumPointsThisMsg(num_matches);
+	pointCloudValid = true;
+	bmComputingDepths.end(num_matches);
+}
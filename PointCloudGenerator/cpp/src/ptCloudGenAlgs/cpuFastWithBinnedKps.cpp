@@ -0,0 +1,63 @@
+/*
+	cpuFastWithBinnedKps.cpp
+
+	FAST keypoints, binned by row and described with ORB, matched between
+	the rectified left and right images.  Uses CPU.
+*/
+
+#include <ptCloudGenAlgs/cpuFastWithBinnedKps.h>
+
+using namespace std;
+using namespace std::chrono;
+
+void CpuFastWithBinnedKps::init(json options, Logger * lgr, StereoCal calData) {
+	CpuPreUndistortAlg::init(options, lgr, calData);
+
+	// Load configuration options
+	string cur_key = "";
+	json alg_section;
+	try {
+		cur_key = "CpuFastWithBinnedKpsOptions"; alg_section = options[cur_key];
+	} catch (domain_error e) {
+		cerr << "JSON field missing or corrupted.  Please see example file in config directory."
+			 << endl << "While reading key \"" << cur_key << "\" in processing section: "
+			 << e.what() << endl;
+		throw(e);
+	}
+	kps.init(alg_section, cur_key, logger, taskPool);
+
+	Mat P1 = cal_data.getCpuProjectionMatrixLeft();
+	focalLenPx = P1.at<double>(0, 0);
+	cx         = P1.at<double>(0, 2);
+	cy         = P1.at<double>(1, 2);
+}
+
+void CpuFastWithBinnedKps::processImages(ImageDataSet imgData) {
+	if(!imgData.imgVisibleLValid || !imgData.imgVisibleRValid) {
+		clearPointCloud();
+		return;
+	}
+
+	// Parent tasks: undistort into imgLRect, imgRRect
+	CpuPreUndistortAlg::processImages(imgData);
+
+	computeStereoPtClouds();
+}
+
+void CpuFastWithBinnedKps::computeStereoPtClouds() {
+	kps.findKps(imgLRect, imgRRect);
+	// A message holds at most this many points
+	kps.matchKps(maxPointsPerMsg());
+
+	bmComputingDepths.start();
+	size_t num_matches = kps.getNumMatches();
+	if(allocatePointCloud(num_matches) == NULL) {
+		logger->logWarning("No point cloud buffer free; skipping this frame's cloud.");
+		bmComputingDepths.end();
+		return;
+	}
+	kps.triangulate(msg->getPointCloud(), cal_data.getTriangulationConst(), focalLenPx, cx, cy);
+	msg->setNumPointsThisMsg(num_matches);
+	pointCloudValid = true;
+	bmComputingDepths.end(num_matches);
+}
@@ -12,13 +12,24 @@ using namespace std;
 using namespace std::chrono;
 
 void CpuPreUndistortAlg::cpuUndistort(ImageDataSet imgData) {
+	// Rendered images need no undistorting.  Copy them, since algorithms
+	// may work on these in place, and the originals are shared.
+	if(imgData.isRectified) {
+		imgData.imgVisibleL.copyTo(imgLRect);
+		imgData.imgVisibleR.copyTo(imgRRect);
+		return;
+	}
 
 	// Perform undistort
 	bmUndistortOnCpu.start();
 	auto undistortMapsLeft  = cal_data.getCpuUndistortMapsLeft ();
 	auto undistortMapsRight = cal_data.getCpuUndistortMapsRight();
-	cv::remap(imgData.imgVisibleL, imgLRect, undistortMapsLeft[0],  undistortMapsLeft[1],  INTER_LINEAR);
+	TaskPool::TaskGroup group;
+	taskPool->submit(group, [&]{
+		cv::remap(imgData.imgVisibleL, imgLRect, undistortMapsLeft[0],  undistortMapsLeft[1],  INTER_LINEAR);
+	});
 	cv::remap(imgData.imgVisibleR, imgRRect, undistortMapsRight[0], undistortMapsRight[1], INTER_LINEAR);
+	taskPool->wait(group);
 	bmUndistortOnCpu.end(2);
 }
 
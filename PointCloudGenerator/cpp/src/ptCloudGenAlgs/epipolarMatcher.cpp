@@ -0,0 +1,146 @@
+/*
+	epipolarMatcher.cpp
+
+	ORB descriptor matching restricted to the epipolar window.
+*/
+
+#include <ptCloudGenAlgs/epipolarMatcher.h>
+#include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+using namespace std;
+
+const int EpipolarMatcher::DESC_BYTES;
+
+void EpipolarMatcher::init(int max_row_diff_px, double min_disparity_px, double max_disparity_px,
+		double min_improvement_factor) {
+	if(max_row_diff_px < 0 || min_disparity_px < 0 ||
+	   (max_disparity_px > 0 && max_disparity_px < min_disparity_px)) {
+		throw invalid_argument("Epipolar matcher needs non-negative row difference and disparities, with max >= min.");
+	}
+	maxRowDiffPx = max_row_diff_px;
+	minDisparityPx = min_disparity_px;
+	maxDisparityPx = max_disparity_px;
+	minImprovementFactor = min_improvement_factor;
+	// A window of 2 * maxRowDiffPx + 1 rows then spans at most two bands
+	bandRows = 2 * maxRowDiffPx + 1;
+}
+
+void EpipolarMatcher::setTrain(const vector<cv::KeyPoint> &kps, const cv::Mat &desc) {
+	if(!kps.empty() && (desc.cols != DESC_BYTES || desc.rows != (int)kps.size() || desc.type() != CV_8UC1)) {
+		throw invalid_argument("Epipolar matcher needs one 32-byte descriptor per keypoint.");
+	}
+	int num_bands = 1;
+	for(auto &kp : kps) {
+		num_bands = max(num_bands, (int)kp.pt.y / bandRows + 1);
+	}
+
+	// Sort into bands, then by column within each, and count each band
+	vector<int> order(kps.size());
+	for(size_t i = 0; i < kps.size(); ++i) { order[i] = i; }
+	sort(order.begin(), order.end(), [&](int a, int b) {
+		int band_a = (int)kps[a].pt.y / bandRows, band_b = (int)kps[b].pt.y / bandRows;
+		if(band_a != band_b) { return band_a < band_b; }
+		return kps[a].pt.x < kps[b].pt.x;
+	});
+	bandStart.assign(num_bands + 1, 0);
+	for(auto &kp : kps) { bandStart[(int)kp.pt.y / bandRows + 1]++; }
+	for(int b = 0; b < num_bands; ++b) { bandStart[b + 1] += bandStart[b]; }
+
+	trainX.resize(kps.size());
+	trainY.resize(kps.size());
+	trainIdx.resize(kps.size());
+	trainDesc.resize(kps.size() * DESC_BYTES);
+	for(size_t i = 0; i < order.size(); ++i) {
+		trainX[i]   = kps[order[i]].pt.x;
+		trainY[i]   = kps[order[i]].pt.y;
+		trainIdx[i] = order[i];
+		memcpy(&trainDesc[i * DESC_BYTES], desc.ptr<uint8_t>(order[i]), DESC_BYTES);
+	}
+}
+
+void EpipolarMatcher::match(const vector<cv::KeyPoint> &kps, const cv::Mat &desc,
+		size_t begin, size_t end, vector<cv::DMatch> &matches) const {
+	int num_bands = (int)bandStart.size() - 1;
+	for(size_t q = begin; q < end; ++q) {
+		float x = kps[q].pt.x;
+		float y = kps[q].pt.y;
+		const uint8_t * query = desc.ptr<uint8_t>(q);
+		// Where the match may lie in the right image
+		float lo_x = (maxDisparityPx > 0) ? x - maxDisparityPx : -INFINITY;
+		float hi_x = x - minDisparityPx;
+		int first_band = max(0,             (int)floor((y - maxRowDiffPx) / bandRows));
+		int last_band  = min(num_bands - 1, (int)floor((y + maxRowDiffPx) / bandRows));
+
+		int best = INT_MAX, second = INT_MAX;
+		int best_idx = -1;
+		for(int b = first_band; b <= last_band; ++b) {
+			auto band_begin = trainX.begin() + bandStart[b];
+			auto band_end   = trainX.begin() + bandStart[b + 1];
+			for(auto it = lower_bound(band_begin, band_end, lo_x); it != band_end && *it <= hi_x; ++it) {
+				size_t t = it - trainX.begin();
+				if(fabs(trainY[t] - y) > maxRowDiffPx) { continue; }
+				int d = hamming(query, &trainDesc[t * DESC_BYTES]);
+				if(d < best) {
+					second = best;
+					best = d;
+					best_idx = t;
+				} else if(d < second) {
+					second = d;
+				}
+			}
+		}
+		// Keep it only if it's clearly better than the runner-up
+		if(best_idx >= 0 && (second == INT_MAX || best < minImprovementFactor * second)) {
+			matches.push_back(cv::DMatch(q, trainIdx[best_idx], best));
+		}
+	}
+}
+
+#if !defined(__ARM_NEON) && !defined(__ARM_NEON__)
+static inline int popcountWords(const uint64_t * wa, const uint64_t * wb) {
+	return __builtin_popcountll(wa[0] ^ wb[0]) + __builtin_popcountll(wa[1] ^ wb[1]) +
+	       __builtin_popcountll(wa[2] ^ wb[2]) + __builtin_popcountll(wa[3] ^ wb[3]);
+}
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__POPCNT__)
+// The build doesn't assume POPCNT, so this one copy is compiled for it
+// and used only if the CPU turns out to have it
+__attribute__((target("popcnt")))
+static int popcountWordsHw(const uint64_t * wa, const uint64_t * wb) {
+	return __builtin_popcountll(wa[0] ^ wb[0]) + __builtin_popcountll(wa[1] ^ wb[1]) +
+	       __builtin_popcountll(wa[2] ^ wb[2]) + __builtin_popcountll(wa[3] ^ wb[3]);
+}
+
+static bool cpuHasPopcnt() {
+	__builtin_cpu_init(); // Needed before constructors have run
+	return __builtin_cpu_supports("popcnt");
+}
+static const bool HAVE_POPCNT = cpuHasPopcnt();
+#endif
+
+int EpipolarMatcher::hamming(const uint8_t * a, const uint8_t * b) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	uint8x16_t diff_lo = veorq_u8(vld1q_u8(a),      vld1q_u8(b));
+	uint8x16_t diff_hi = veorq_u8(vld1q_u8(a + 16), vld1q_u8(b + 16));
+	// At most 16 per lane, so the byte sum can't overflow
+	uint8x16_t bits = vaddq_u8(vcntq_u8(diff_lo), vcntq_u8(diff_hi));
+	uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+	return (int)(vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#else
+	uint64_t wa[DESC_BYTES / 8], wb[DESC_BYTES / 8];
+	memcpy(wa, a, DESC_BYTES);
+	memcpy(wb, b, DESC_BYTES);
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__POPCNT__)
+	if(HAVE_POPCNT) { return popcountWordsHw(wa, wb); }
+#endif
+	// POPCNT if the build targets it, a bit-twiddling fallback otherwise
+	return popcountWords(wa, wb);
+#endif
+}
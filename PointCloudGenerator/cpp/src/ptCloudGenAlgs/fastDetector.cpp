@@ -0,0 +1,249 @@
+/*
+	fastDetector.cpp
+
+	FAST-9 corners, with SIMD kernels for the corner test.
+*/
+
+#include <ptCloudGenAlgs/fastDetector.h>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+using namespace std;
+
+const int FastDetector::CIRCLE_SIZE;
+const int FastDetector::ARC_LENGTH;
+const int FastDetector::RADIUS;
+
+void FastDetector::circleOffsets(int step, int (&offsets)[CIRCLE_SIZE]) {
+	static const int CIRCLE[CIRCLE_SIZE][2] = {
+		{ 0, -3}, { 1, -3}, { 2, -2}, { 3, -1}, { 3,  0}, { 3,  1}, { 2,  2}, { 1,  3},
+		{ 0,  3}, {-1,  3}, {-2,  2}, {-3,  1}, {-3,  0}, {-3, -1}, {-2, -2}, {-1, -3}
+	};
+	for(int k = 0; k < CIRCLE_SIZE; ++k) {
+		offsets[k] = CIRCLE[k][0] + CIRCLE[k][1] * step;
+	}
+}
+
+// Walks the circle once and then the first ARC_LENGTH - 1 pixels again,
+// so runs that wrap around are counted whole.  The SIMD kernels do the
+// same, lane by lane.
+bool FastDetector::isCorner(const uint8_t * p, const int (&offsets)[CIRCLE_SIZE], int threshold) {
+	int hi = min(p[0] + threshold, 255);
+	int lo = max(p[0] - threshold, 0);
+	int run_bright = 0, run_dark = 0;
+	for(int i = 0; i < CIRCLE_SIZE + ARC_LENGTH - 1; ++i) {
+		int v = p[offsets[i % CIRCLE_SIZE]];
+		run_bright = (v > hi) ? run_bright + 1 : 0;
+		run_dark   = (v < lo) ? run_dark   + 1 : 0;
+		if(run_bright >= ARC_LENGTH || run_dark >= ARC_LENGTH) { return true; }
+	}
+	return false;
+}
+
+// The most any arc's pixels all differ from the centre by, in the same
+// direction, less one: the largest threshold that still finds the corner
+int FastDetector::cornerScore(const uint8_t * p, const int (&offsets)[CIRCLE_SIZE]) {
+	int diff[CIRCLE_SIZE];
+	for(int k = 0; k < CIRCLE_SIZE; ++k) {
+		diff[k] = p[offsets[k]] - p[0];
+	}
+	int best = 0;
+	for(int start = 0; start < CIRCLE_SIZE; ++start) {
+		int min_bright = 255, min_dark = 255;
+		for(int j = 0; j < ARC_LENGTH; ++j) {
+			int d = diff[(start + j) % CIRCLE_SIZE];
+			min_bright = min(min_bright,  d);
+			min_dark   = min(min_dark,   -d);
+		}
+		best = max(best, max(min_bright, min_dark));
+	}
+	return best - 1;
+}
+
+// The corner test on a vector of pixels at once.  Ops wraps one
+// instruction set's unsigned byte operations.  Comparisons come out as
+// "not brighter" and "not darker" masks, since that's what an equality
+// test against zero gives without a NOT, and andnot takes them as is.
+template<class Ops>
+static int markCornersSimd(const uint8_t * row, int x, int x_end, int threshold,
+		const int (&offsets)[FastDetector::CIRCLE_SIZE], uint8_t * mask) {
+	typedef typename Ops::V V;
+	const int CIRCLE_SIZE = FastDetector::CIRCLE_SIZE;
+	const int ARC_LENGTH  = FastDetector::ARC_LENGTH;
+	const V t     = Ops::set1(threshold);
+	const V one   = Ops::set1(1);
+	const V shy   = Ops::set1(ARC_LENGTH - 1);
+	const V zero  = Ops::set1(0);
+	for(; x + Ops::WIDTH <= x_end; x += Ops::WIDTH) {
+		const uint8_t * p = row + x;
+		V centre = Ops::load(p);
+		V hi = Ops::adds(centre, t);
+		V lo = Ops::subs(centre, t);
+		auto not_bright = [&](int k) { return Ops::isZero(Ops::subs(Ops::load(p + offsets[k]), hi)); };
+		auto not_dark   = [&](int k) { return Ops::isZero(Ops::subs(lo, Ops::load(p + offsets[k]))); };
+
+		// Any 9-pixel arc covers two neighbouring pixels of the four at
+		// 0, 4, 8 and 12, so skip vectors where no lane has such a pair
+		V no_bright_pair = Ops::or_(Ops::and_(not_bright(0), not_bright(8)),
+		                            Ops::and_(not_bright(4), not_bright(12)));
+		V no_dark_pair   = Ops::or_(Ops::and_(not_dark(0),   not_dark(8)),
+		                            Ops::and_(not_dark(4),   not_dark(12)));
+		if(Ops::allSet(Ops::and_(no_bright_pair, no_dark_pair))) {
+			Ops::store(mask + x, zero);
+			continue;
+		}
+
+		V run_bright = zero, run_dark = zero;
+		V best_bright = zero, best_dark = zero;
+		for(int i = 0; i < CIRCLE_SIZE + ARC_LENGTH - 1; ++i) {
+			int k = i % CIRCLE_SIZE;
+			// One more than before if the pixel continues the run, else 0
+			run_bright  = Ops::andnot(not_bright(k), Ops::add(run_bright, one));
+			run_dark    = Ops::andnot(not_dark(k),   Ops::add(run_dark,   one));
+			best_bright = Ops::max(best_bright, run_bright);
+			best_dark   = Ops::max(best_dark,   run_dark);
+		}
+		Ops::store(mask + x, Ops::or_(Ops::gt(best_bright, shy), Ops::gt(best_dark, shy)));
+	}
+	return x;
+}
+
+#if defined(__AVX2__)
+struct Avx2Ops {
+	typedef __m256i V;
+	static const int WIDTH = 32;
+	static V load(const uint8_t * p)     { return _mm256_loadu_si256((const __m256i *)p); }
+	static void store(uint8_t * p, V v)  { _mm256_storeu_si256((__m256i *)p, v); }
+	static V set1(int v)                 { return _mm256_set1_epi8((char)v); }
+	static V adds(V a, V b)              { return _mm256_adds_epu8(a, b); }
+	static V subs(V a, V b)              { return _mm256_subs_epu8(a, b); }
+	static V add(V a, V b)               { return _mm256_add_epi8(a, b); }
+	static V max(V a, V b)               { return _mm256_max_epu8(a, b); }
+	static V and_(V a, V b)              { return _mm256_and_si256(a, b); }
+	static V or_(V a, V b)               { return _mm256_or_si256(a, b); }
+	static V andnot(V not_a, V b)        { return _mm256_andnot_si256(not_a, b); }
+	static V isZero(V a)                 { return _mm256_cmpeq_epi8(a, _mm256_setzero_si256()); }
+	static V gt(V a, V b)                { return _mm256_cmpgt_epi8(a, b); } // Small counts, so signed is fine
+	static bool allSet(V a)              { return _mm256_movemask_epi8(a) == -1; }
+};
+#endif
+
+#if defined(__SSE2__)
+struct Sse2Ops {
+	typedef __m128i V;
+	static const int WIDTH = 16;
+	static V load(const uint8_t * p)     { return _mm_loadu_si128((const __m128i *)p); }
+	static void store(uint8_t * p, V v)  { _mm_storeu_si128((__m128i *)p, v); }
+	static V set1(int v)                 { return _mm_set1_epi8((char)v); }
+	static V adds(V a, V b)              { return _mm_adds_epu8(a, b); }
+	static V subs(V a, V b)              { return _mm_subs_epu8(a, b); }
+	static V add(V a, V b)               { return _mm_add_epi8(a, b); }
+	static V max(V a, V b)               { return _mm_max_epu8(a, b); }
+	static V and_(V a, V b)              { return _mm_and_si128(a, b); }
+	static V or_(V a, V b)               { return _mm_or_si128(a, b); }
+	static V andnot(V not_a, V b)        { return _mm_andnot_si128(not_a, b); }
+	static V isZero(V a)                 { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+	static V gt(V a, V b)                { return _mm_cmpgt_epi8(a, b); } // Small counts, so signed is fine
+	static bool allSet(V a)              { return _mm_movemask_epi8(a) == 0xFFFF; }
+};
+#endif
+
+#if defined(__aarch64__)
+struct NeonOps {
+	typedef uint8x16_t V;
+	static const int WIDTH = 16;
+	static V load(const uint8_t * p)     { return vld1q_u8(p); }
+	static void store(uint8_t * p, V v)  { vst1q_u8(p, v); }
+	static V set1(int v)                 { return vdupq_n_u8((uint8_t)v); }
+	static V adds(V a, V b)              { return vqaddq_u8(a, b); }
+	static V subs(V a, V b)              { return vqsubq_u8(a, b); }
+	static V add(V a, V b)               { return vaddq_u8(a, b); }
+	static V max(V a, V b)               { return vmaxq_u8(a, b); }
+	static V and_(V a, V b)              { return vandq_u8(a, b); }
+	static V or_(V a, V b)               { return vorrq_u8(a, b); }
+	static V andnot(V not_a, V b)        { return vbicq_u8(b, not_a); }
+	static V isZero(V a)                 { return vceqq_u8(a, vdupq_n_u8(0)); }
+	static V gt(V a, V b)                { return vcgtq_u8(a, b); }
+	static bool allSet(V a)              { return vminvq_u8(a) == 0xFF; }
+};
+#endif
+
+void FastDetector::markCorners(const uint8_t * row, int step, int x_begin, int x_end,
+		int threshold, uint8_t * mask) {
+	int offsets[CIRCLE_SIZE];
+	circleOffsets(step, offsets);
+	threshold = max(0, min(threshold, 255));
+	int x = x_begin;
+#if defined(__AVX2__)
+	x = markCornersSimd<Avx2Ops>(row, x, x_end, threshold, offsets, mask);
+#endif
+#if defined(__SSE2__)
+	x = markCornersSimd<Sse2Ops>(row, x, x_end, threshold, offsets, mask);
+#elif defined(__aarch64__)
+	x = markCornersSimd<NeonOps>(row, x, x_end, threshold, offsets, mask);
+#endif
+	for(; x < x_end; ++x) {
+		mask[x] = isCorner(row + x, offsets, threshold) ? 0xFF : 0;
+	}
+}
+
+void FastDetector::detect(const cv::Mat &img, int first_row, int last_row, int threshold, int border,
+		vector<cv::KeyPoint> &kps) {
+	CV_Assert(img.type() == CV_8UC1);
+	border = max(border, RADIUS);
+	// Rows whose corners we report, and those that need scores to decide
+	int y_first = max(first_row, border);
+	int y_last  = min(last_row, img.rows - border);
+	if(y_first >= y_last || img.cols <= 2 * border) { return; }
+	int scored_first = max(y_first - 1, RADIUS);
+	int scored_last  = min(y_last  + 1, img.rows - RADIUS);
+	int x_begin = RADIUS, x_end = img.cols - RADIUS;
+
+	int offsets[CIRCLE_SIZE];
+	circleOffsets(img.step, offsets);
+	mask.resize(img.cols);
+	for(int i = 0; i < 3; ++i) {
+		scores[i].assign(img.cols, 0);
+		corners[i].clear();
+	}
+
+	// Keeps the corners in row y that beat all their neighbours.  Scores
+	// are stored one higher, so that 0 means no corner.
+	auto suppress = [&](int y) {
+		if(y < y_first || y >= y_last) { return; }
+		const vector<uint8_t> &prev = scores[(y + 2) % 3];
+		const vector<uint8_t> &cur  = scores[ y      % 3];
+		const vector<uint8_t> &next = scores[(y + 1) % 3];
+		bool has_prev = (y - 1 >= scored_first), has_next = (y + 1 < scored_last);
+		for(int x : corners[y % 3]) {
+			if(x < border || x >= img.cols - border) { continue; }
+			uint8_t s = cur[x];
+			if(s <= cur[x - 1] || s <= cur[x + 1]) { continue; }
+			if(has_prev && (s <= prev[x - 1] || s <= prev[x] || s <= prev[x + 1])) { continue; }
+			if(has_next && (s <= next[x - 1] || s <= next[x] || s <= next[x + 1])) { continue; }
+			kps.push_back(cv::KeyPoint((float)x, (float)y, 7.f, -1, (float)(s - 1)));
+		}
+	};
+
+	for(int y = scored_first; y < scored_last; ++y) {
+		vector<uint8_t> &row_scores  = scores [y % 3];
+		vector<int>     &row_corners = corners[y % 3];
+		for(int x : row_corners) { row_scores[x] = 0; }
+		row_corners.clear();
+
+		const uint8_t * row = img.ptr<uint8_t>(y);
+		markCorners(row, img.step, x_begin, x_end, threshold, mask.data());
+		for(int x = x_begin; x < x_end; ++x) {
+			if(mask[x]) {
+				row_scores[x] = (uint8_t)(cornerScore(row + x, offsets) + 1);
+				row_corners.push_back(x);
+			}
+		}
+		// Row y - 1 has both its neighbours now
+		suppress(y - 1);
+	}
+	suppress(scored_last - 1);
+}
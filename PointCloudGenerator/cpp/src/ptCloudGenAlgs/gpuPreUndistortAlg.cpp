@@ -19,6 +19,13 @@ void GpuPreUndistortAlg::gpuUndistort(ImageDataSet imgData) {
 	cuda::GpuMat imgRUnrect(imgData.imgVisibleR);
 	bmDataXferGpu.pause(2);
 
+	// Rendered images need no undistorting
+	if(imgData.isRectified) {
+		imgLRectGpu = imgLUnrect;
+		imgRRectGpu = imgRUnrect;
+		return;
+	}
+
 	// Perform undistort
 	bmUndistortOnGpu.start();
 	auto undistortMapsLeft  = cal_data.getGpuUndistortMapsLeft ();
@@ -0,0 +1,94 @@
+/*
+	postUndistortAlg.cpp
+
+	Abstract class for algorithms that undistort only the points they find
+*/
+
+#include <ptCloudGenAlgs/postUndistortAlg.h>
+
+using namespace std;
+using namespace std::chrono;
+
+const int PostUndistortAlg::LUT_STEP_PX;
+
+void PostUndistortAlg::init(json options, Logger * lgr, StereoCal calData) {
+	StereoPtCloudGenAlg::init(options, lgr, calData);
+
+	rectSize = cal_data.getImageSize();
+	buildRectifyLut(0);
+	buildRectifyLut(1);
+}
+
+void PostUndistortAlg::buildRectifyLut(int side) {
+	Size input_size = cal_data.getInputSize();
+	int lut_cols = (input_size.width  - 1) / LUT_STEP_PX + 2;
+	int lut_rows = (input_size.height - 1) / LUT_STEP_PX + 2;
+	vector<Point2f> input_pts, rect_pts;
+	input_pts.reserve(lut_rows * lut_cols);
+	for(int row = 0; row < lut_rows; ++row) {
+		for(int col = 0; col < lut_cols; ++col) {
+			input_pts.push_back(Point2f(col * LUT_STEP_PX, row * LUT_STEP_PX));
+		}
+	}
+	if(side == 0) {
+		cal_data.rectifyPointsLeft (input_pts, rect_pts);
+	} else {
+		cal_data.rectifyPointsRight(input_pts, rect_pts);
+	}
+
+	Mat &lut = rectifyLuts[side];
+	lut.create(lut_rows, lut_cols, CV_32FC2);
+	for(int row = 0; row < lut_rows; ++row) {
+		copy(rect_pts.begin() + row * lut_cols, rect_pts.begin() + (row + 1) * lut_cols,
+			lut.ptr<Point2f>(row));
+	}
+}
+
+bool PostUndistortAlg::rectifyPoint(int side, Point2f &pt) const {
+	if(!imgsRectified) {
+		const Mat &lut = rectifyLuts[side];
+		float lut_x = pt.x / LUT_STEP_PX;
+		float lut_y = pt.y / LUT_STEP_PX;
+		if(!(lut_x >= 0 && lut_y >= 0)) { return false; }
+		int col = (int)lut_x, row = (int)lut_y;
+		if(col >= lut.cols - 1 || row >= lut.rows - 1) { return false; }
+
+		// Bilinear, between the four entries around the point
+		float ax = lut_x - col, ay = lut_y - row;
+		const Point2f * above = lut.ptr<Point2f>(row    ) + col;
+		const Point2f * below = lut.ptr<Point2f>(row + 1) + col;
+		float x_above = above[0].x + ax * (above[1].x - above[0].x);
+		float y_above = above[0].y + ax * (above[1].y - above[0].y);
+		float x_below = below[0].x + ax * (below[1].x - below[0].x);
+		float y_below = below[0].y + ax * (below[1].y - below[0].y);
+		pt.x = x_above + ay * (x_below - x_above);
+		pt.y = y_above + ay * (y_below - y_above);
+	}
+	return pt.x >= 0 && pt.y >= 0 && pt.x < rectSize.width && pt.y < rectSize.height;
+}
+
+void PostUndistortAlg::processImages(ImageDataSet imgData) {
+	// Parent tasks
+	StereoPtCloudGenAlg::processImages(imgData);
+
+	// The lookup tables are for upright images.  Flipping is a fraction of
+	// the cost of remapping, and keeps descriptors comparable between
+	// cameras mounted differently.  Otherwise use the images in place.
+	imgsRectified = imgData.isRectified;
+	bool flip_l = !imgsRectified && cal_data.isFlipFoldedLeft ();
+	bool flip_r = !imgsRectified && cal_data.isFlipFoldedRight();
+	if(!flip_l) { imgL = imgData.imgVisibleL; }
+	if(!flip_r) { imgR = imgData.imgVisibleR; }
+	if(flip_l || flip_r) {
+		bmFlippingImages.start();
+		TaskPool::TaskGroup group;
+		if(flip_l) {
+			taskPool->submit(group, [&]{ cv::flip(imgData.imgVisibleL, imgL, cal_data.getFlipCodeLeft()); });
+		}
+		if(flip_r) {
+			cv::flip(imgData.imgVisibleR, imgR, cal_data.getFlipCodeRight());
+		}
+		taskPool->wait(group);
+		bmFlippingImages.end(flip_l + flip_r);
+	}
+}
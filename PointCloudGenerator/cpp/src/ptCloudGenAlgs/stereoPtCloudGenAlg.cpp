@@ -12,6 +12,9 @@
 using namespace std;
 using namespace std::chrono;
 
+TaskPool      * StereoPtCloudGenAlg::taskPool = NULL;
+MsgBufferPool * StereoPtCloudGenAlg::msgPool  = NULL;
+
 void StereoPtCloudGenAlg::init(json options, Logger * lgr, StereoCal calData) {
 	logger = lgr;
 	cal_data = calData;
@@ -94,10 +97,47 @@ void StereoPtCloudGenAlg::processImages(ImageDataSet imgData) {
 
 void StereoPtCloudGenAlg::clearPointCloud() {
 	bmClearingPtCloud.start();
-	if(msg != NULL) {
-		delete[] msg;
-		msg = NULL;
-	}
+	msgBuffer.reset();
+	msg = NULL;
 	pointCloudValid = false;
 	bmClearingPtCloud.end();
 }
+
+unsigned int StereoPtCloudGenAlg::maxPointsPerMsg() {
+	size_t msg_bytes = min(msgPool->getBufferBytes(), (size_t)UINT16_MAX);
+	if(msg_bytes < sizeof(PointCloudDataMessage)) { return 0; }
+	return (msg_bytes - sizeof(PointCloudDataMessage)) / sizeof(CloudPoint);
+}
+
+PointCloudDataMessage * StereoPtCloudGenAlg::allocatePointCloud(unsigned int max_points) {
+	// Every buffer is the same size, so this also covers reusing ours
+	if(max_points > maxPointsPerMsg()) {
+		stringstream ss;
+		ss << "Point cloud of " << max_points << " points won't fit in a message, which holds "
+		   << maxPointsPerMsg() << "; skipping this frame's cloud.";
+		logger->logWarning(ss.str());
+		clearPointCloud();
+		return NULL;
+	}
+	if(!msgPool->isDoubleBuffered() && msgBuffer) {
+		// Reuse the one we have; the last cloud was copied out of it
+		pointCloudValid = false;
+	} else {
+		clearPointCloud();
+		msgBuffer = msgPool->acquire(sizeof(PointCloudDataMessage) + max_points * sizeof(CloudPoint));
+	}
+	msg = msgBuffer ? new(msgBuffer.get()) PointCloudDataMessage() : NULL;
+	return msg;
+}
+
+MsgBufferPool::Buffer StereoPtCloudGenAlg::takePointCloud() {
+	if(!pointCloudValid) {
+		return MsgBufferPool::Buffer();
+	}
+	if(msgPool->isDoubleBuffered()) {
+		pointCloudValid = false;
+		msg = NULL;
+		return std::move(msgBuffer);
+	}
+	return msgPool->copyOf(msg);
+}
@@ -0,0 +1,105 @@
+/*
+	reactor.cpp
+
+	Minimal epoll-based event loop.
+*/
+
+#include <reactor.h>
+#include <stdexcept>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+using namespace std;
+using namespace std::chrono;
+
+Reactor::~Reactor() {
+	if(epollFd >= 0) {
+		close(epollFd);
+	}
+}
+
+void Reactor::init() {
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(epollFd < 0) {
+		throw runtime_error("epoll_create1(): Failed to create event loop.");
+	}
+}
+
+void Reactor::addSource(int fd, Handler handler) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		throw runtime_error("epoll_ctl(): Failed to add event source.");
+	}
+	handlers[fd] = handler;
+}
+
+void Reactor::removeSource(int fd) {
+	epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+	handlers.erase(fd);
+}
+
+int Reactor::runOnce(milliseconds timeout) {
+	struct epoll_event events[MAX_EVENTS_PER_WAIT];
+	int timeout_ms = (timeout.count() < 0) ? -1 : (int)timeout.count();
+	int num_ready = epoll_wait(epollFd, events, MAX_EVENTS_PER_WAIT, timeout_ms);
+	if(num_ready < 0) {
+		if(errno == EINTR) { return 0; }
+		throw runtime_error("epoll_wait(): Failed waiting for events.");
+	}
+	int num_handled = 0;
+	for(int i = 0; i < num_ready; ++i) {
+		// A handler may have removed a later source
+		auto it = handlers.find(events[i].data.fd);
+		if(it != handlers.end()) {
+			it->second();
+			num_handled++;
+		}
+	}
+	return num_handled;
+}
+
+int Reactor::makeEventFd() {
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(fd < 0) {
+		throw runtime_error("eventfd(): Failed to create event.");
+	}
+	return fd;
+}
+
+void Reactor::signalEventFd(int fd) {
+	uint64_t one = 1;
+	// Can only fail if the counter would overflow, in which case
+	// it's signalled already.
+	ssize_t ret_val = write(fd, &one, sizeof(one));
+	(void)ret_val;
+}
+
+int Reactor::makeTimerFd() {
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if(fd < 0) {
+		throw runtime_error("timerfd_create(): Failed to create timer.");
+	}
+	return fd;
+}
+
+void Reactor::setTimerPeriod(int fd, milliseconds period) {
+	struct itimerspec spec;
+	spec.it_interval.tv_sec  = period.count() / 1000;
+	spec.it_interval.tv_nsec = (period.count() % 1000) * 1000000;
+	spec.it_value = spec.it_interval; // All zeros disarms
+	if(timerfd_settime(fd, 0, &spec, NULL) < 0) {
+		throw runtime_error("timerfd_settime(): Failed to set timer.");
+	}
+}
+
+uint64_t Reactor::drain(int fd) {
+	uint64_t count = 0;
+	if(read(fd, &count, sizeof(count)) != sizeof(count)) {
+		return 0;
+	}
+	return count;
+}
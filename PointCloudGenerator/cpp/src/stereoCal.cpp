@@ -20,6 +20,11 @@ void StereoCal::init(json options) {
 	// Pull JSON matrices from main file
 	try {
 		cur_key = "enableGpu";        enable_gpu   = options   [cur_key];
+		cur_key = "flipImgL";         flipImgL     = options   [cur_key];
+		cur_key = "flipImgR";         flipImgR     = options   [cur_key];
+		cur_key = "imgFlipCodeL";     imgFlipCodeL = options   [cur_key];
+		cur_key = "imgFlipCodeR";     imgFlipCodeR = options   [cur_key];
+		cur_key = "ingest";           ingest.init(options[cur_key]);
 		
 		cur_key = "leftCamera";       subsection   = options   [cur_key];
 		cur_key = "rotationMatrix";   l_r_mat      = subsection[cur_key];
@@ -67,15 +72,31 @@ void StereoCal::init(json options) {
 	}
 	
 	// Compute derived parameters
-	Size size(imageWidth, imageHeight);
+	Size full_size(imageWidth, imageHeight);
 	// cv::stereoRectify(leftCamMatrix,  leftDistCoeffs, 
 	                  // rightCamMatrix, rightDistCoeffs, 
 	                  // size, R, T, R1, R2, P1, P2, Q);
+	if(!ingest.isFullFrame()) {
+		ingestProjection(P1);
+		ingestProjection(P2);
+	}
+	Size size = getImageSize();
 	cv::initUndistortRectifyMap(leftCamMatrix,  leftDistCoeffs, 
 		R1, P1, size, CV_32FC1, cpuUndistortMapsLeft[0],  cpuUndistortMapsLeft[1]);
 	cv::initUndistortRectifyMap(rightCamMatrix, rightDistCoeffs, 
 		R2, P2, size, CV_32FC1, cpuUndistortMapsRight[0], cpuUndistortMapsRight[1]);
-	triangulationConst = focalLen * baselineCm;
+	if(!ingest.isFullFrame()) {
+		// Crop the raw images to just what these maps sample
+		ingest.fitInputToMaps(full_size, cpuUndistortMapsLeft [0], cpuUndistortMapsLeft [1]);
+		ingest.fitInputToMaps(full_size, cpuUndistortMapsRight[0], cpuUndistortMapsRight[1]);
+	}
+	if(flipImgL) { foldFlipIntoMaps(cpuUndistortMapsLeft,  imgFlipCodeL); }
+	if(flipImgR) { foldFlipIntoMaps(cpuUndistortMapsRight, imgFlipCodeR); }
+	if(!ingest.isFullFrame()) {
+		ingestMaps(cpuUndistortMapsLeft,  ingest.getInputRect(full_size, flipImgL, imgFlipCodeL));
+		ingestMaps(cpuUndistortMapsRight, ingest.getInputRect(full_size, flipImgR, imgFlipCodeR));
+	}
+	triangulationConst = focalLen / ingest.getBinning() * baselineCm;
 
 	// Upload undistort maps to GPU
 	if(enable_gpu) {
@@ -95,3 +116,70 @@ void StereoCal::loadInto(Mat_<double> &cvMat, json jsonMat) {
 	}
 }
 
+
+// A map entry says where in the (flipped) source image to sample.  Mirror
+// that coordinate, and it points at the same pixel of the unflipped image.
+void StereoCal::foldFlipIntoMaps(Mat (&maps)[2], int flip_code) {
+	bool mirror_x = (flip_code != 0); // 1 or -1 flip around the y axis
+	bool mirror_y = (flip_code <= 0); // 0 or -1 flip around the x axis
+	float max_x = (float)imageWidth  - 1;
+	float max_y = (float)imageHeight - 1;
+	for(int row = 0; row < maps[0].rows; ++row) {
+		float * map_x = maps[0].ptr<float>(row);
+		float * map_y = maps[1].ptr<float>(row);
+		for(int col = 0; col < maps[0].cols; ++col) {
+			if(mirror_x) { map_x[col] = max_x - map_x[col]; }
+			if(mirror_y) { map_y[col] = max_y - map_y[col]; }
+		}
+	}
+}
+
+// Pixel u of the output is the average of full-resolution pixels
+// roi.x + b*u ... roi.x + b*u + b-1, so centred on roi.x + b*u + (b-1)/2.
+// Shift and scale the principal point to match, and the focal length
+// (including the baseline term fx*Tx) with it.
+void StereoCal::ingestProjection(Mat_<double> &P) {
+	Rect roi = ingest.getRoi(Size(imageWidth, imageHeight));
+	double b = ingest.getBinning();
+	double half_bin = (b - 1) / 2;
+	for(int col = 0; col < P_MAT_COLS; ++col) {
+		P[0][col] /= b;
+		P[1][col] /= b;
+	}
+	P[0][2] -= (roi.x + half_bin) / b;
+	P[1][2] -= (roi.y + half_bin) / b;
+}
+
+// The inverse of the mapping above, applied to where each map entry
+// samples.  Runs after foldFlipIntoMaps(), so input_rect is in the
+// image as it arrives, flipped or not.
+void StereoCal::ingestMaps(Mat (&maps)[2], Rect input_rect) {
+	float b = (float)ingest.getBinning();
+	float off_x = input_rect.x + (b - 1) / 2;
+	float off_y = input_rect.y + (b - 1) / 2;
+	for(int row = 0; row < maps[0].rows; ++row) {
+		float * map_x = maps[0].ptr<float>(row);
+		float * map_y = maps[1].ptr<float>(row);
+		for(int col = 0; col < maps[0].cols; ++col) {
+			map_x[col] = (map_x[col] - off_x) / b;
+			map_y[col] = (map_y[col] - off_y) / b;
+		}
+	}
+}
+
+// Undoes ingestMaps() for an upright image, so back to full-resolution
+// raw coordinates, then undistorts and rectifies.  proj already allows
+// for the ingest window.
+void StereoCal::rectifyPoints(const vector<Point2f> &in, vector<Point2f> &out,
+		const Mat_<double> &cam_matrix, const Mat_<double> &dist_coeffs,
+		const Mat_<double> &rect, const Mat_<double> &proj) {
+	Rect input_rect = ingest.getInputRect(Size(imageWidth, imageHeight));
+	float b = (float)ingest.getBinning();
+	float off_x = input_rect.x + (b - 1) / 2;
+	float off_y = input_rect.y + (b - 1) / 2;
+	vector<Point2f> full(in.size());
+	for(size_t i = 0; i < in.size(); ++i) {
+		full[i] = Point2f(in[i].x * b + off_x, in[i].y * b + off_y);
+	}
+	cv::undistortPoints(full, out, cam_matrix, dist_coeffs, rect, proj);
+}
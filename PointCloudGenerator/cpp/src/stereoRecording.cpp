@@ -0,0 +1,382 @@
+/*
+	stereoRecording.cpp
+
+	Single-file container for recorded stereo frames.
+*/
+
+#include <stereoRecording.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sstream>
+using namespace std;
+
+const char StereoRecording::FILE_MAGIC[8]   = {'P','C','G','S','T','R','E','C'};
+const char StereoRecording::FOOTER_MAGIC[8] = {'P','C','G','I','N','D','E','X'};
+const uint32_t StereoRecording::RECORD_MAGIC;
+const uint32_t StereoRecording::VERSION;
+const size_t   StereoRecording::FILE_HEADER_BYTES;
+const size_t   StereoRecording::RECORD_HEADER_BYTES;
+const size_t   StereoRecording::AGC_BYTES;
+const uint32_t StereoRecording::FLAG_VALID_L;
+const uint32_t StereoRecording::FLAG_VALID_R;
+
+static const uint64_t PAGE_BYTES = 4096;
+
+static uint64_t roundUpToPage(uint64_t bytes) {
+	return (bytes + PAGE_BYTES - 1) / PAGE_BYTES * PAGE_BYTES;
+}
+
+uint64_t StereoRecording::recordBytesFor(uint32_t width, uint32_t height) {
+	return RECORD_HEADER_BYTES + 2 * roundUpToPage((uint64_t)width * height);
+}
+
+int64_t StereoRecording::toTimeUs(chrono::time_point<chrono::system_clock> t) {
+	return chrono::duration_cast<chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+chrono::time_point<chrono::system_clock> StereoRecording::fromTimeUs(int64_t us) {
+	return chrono::time_point<chrono::system_clock>(
+		chrono::duration_cast<chrono::system_clock::duration>(chrono::microseconds(us)));
+}
+
+////////////////////////////////////////////////////////////
+// Writer
+////////////////////////////////////////////////////////////
+
+bool StereoRecordingWriter::open(string _path, uint32_t width, uint32_t height, Logger * lgr) {
+	close();
+	logger = lgr;
+	path = _path;
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(fd < 0) {
+		stringstream ss;
+		ss << "Couldn't create recording " << path << ".  Error #" << errno;
+		if(logger != NULL) { logger->logError(ss.str()); }
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, StereoRecording::FILE_MAGIC, sizeof(header.magic));
+	header.version           = StereoRecording::VERSION;
+	header.width             = width;
+	header.height            = height;
+	header.imageBytes        = width * height;
+	header.recordBytes       = StereoRecording::recordBytesFor(width, height);
+	header.recordHeaderBytes = StereoRecording::RECORD_HEADER_BYTES;
+	header.fileHeaderBytes   = StereoRecording::FILE_HEADER_BYTES;
+	index.clear();
+	zeros.assign(roundUpToPage(header.imageBytes), 0);
+
+	vector<char> page(StereoRecording::FILE_HEADER_BYTES, 0);
+	memcpy(page.data(), &header, sizeof(header));
+	if(!writeAll(page.data(), page.size())) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool StereoRecordingWriter::append(const StereoRecordingFrame &frame) {
+	if(fd < 0) { return false; }
+
+	// Only images that fit the record can go in it
+	const cv::Mat * imgs[2] = {&frame.imgL, &frame.imgR};
+	bool valid[2] = {frame.validL, frame.validR};
+	cv::Mat packed[2];
+	for(int i = 0; i < 2; ++i) {
+		if(!valid[i]) { continue; }
+		const cv::Mat &img = *imgs[i];
+		if(img.type() != CV_8UC1 || (uint32_t)img.cols != header.width || (uint32_t)img.rows != header.height) {
+			if(logger != NULL) {
+				stringstream ss;
+				ss << "Recording: " << (i == 0 ? "left" : "right") << " image is " << img.cols << "x" << img.rows
+				   << ", not 8-bit " << header.width << "x" << header.height << "; storing it as invalid.";
+				logger->logWarning(ss.str());
+			}
+			valid[i] = false;
+			continue;
+		}
+		packed[i] = img.isContinuous() ? img : img.clone();
+	}
+
+	StereoRecording::RecordHeader rh;
+	memset(&rh, 0, sizeof(rh));
+	rh.magic   = StereoRecording::RECORD_MAGIC;
+	rh.flags   = (valid[0] ? StereoRecording::FLAG_VALID_L : 0) | (valid[1] ? StereoRecording::FLAG_VALID_R : 0);
+	rh.timeUs  = StereoRecording::toTimeUs(frame.acquisitionTime);
+	rh.frameId = frame.frameId;
+	strncpy(rh.autoGainValues, frame.autoGainValues.c_str(), StereoRecording::AGC_BYTES - 1);
+
+	// Header page, then each image padded out to a page
+	vector<char> page(StereoRecording::RECORD_HEADER_BYTES, 0);
+	memcpy(page.data(), &rh, sizeof(rh));
+	bool ok = writeAll(page.data(), page.size());
+	size_t pad = roundUpToPage(header.imageBytes) - header.imageBytes;
+	for(int i = 0; i < 2 && ok; ++i) {
+		const char * pixels = valid[i] ? (const char *)packed[i].data : zeros.data();
+		ok = writeAll(pixels, header.imageBytes) && writeAll(zeros.data(), pad);
+	}
+	if(!ok) {
+		// Leave the file ending on a record boundary, so it stays readable
+		if(ftruncate(fd, header.fileHeaderBytes + index.size() * header.recordBytes) != 0) { ; }
+		lseek(fd, 0, SEEK_END);
+		return false;
+	}
+
+	StereoRecording::IndexEntry entry = {rh.timeUs, rh.flags, 0};
+	index.push_back(entry);
+	return true;
+}
+
+void StereoRecordingWriter::close() {
+	if(fd < 0) { return; }
+	StereoRecording::Footer footer;
+	memset(&footer, 0, sizeof(footer));
+	memcpy(footer.magic, StereoRecording::FOOTER_MAGIC, sizeof(footer.magic));
+	footer.numRecords  = index.size();
+	footer.indexOffset = header.fileHeaderBytes + index.size() * header.recordBytes;
+	if(!writeAll((const char *)index.data(), index.size() * sizeof(StereoRecording::IndexEntry)) ||
+	   !writeAll((const char *)&footer, sizeof(footer))) {
+		if(logger != NULL) { logger->logWarning("Couldn't write the index of " + path + "; it will be rebuilt on playback."); }
+	}
+	::close(fd);
+	fd = -1;
+}
+
+bool StereoRecordingWriter::writeAll(const char * buf, size_t bytes) {
+	while(bytes > 0) {
+		ssize_t n = write(fd, buf, bytes);
+		if(n < 0) {
+			if(errno == EINTR) { continue; }
+			if(logger != NULL) {
+				stringstream ss;
+				ss << "Couldn't write to recording " << path << ".  Error #" << errno;
+				logger->logError(ss.str());
+			}
+			return false;
+		}
+		buf   += n;
+		bytes -= n;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////
+// Reader
+////////////////////////////////////////////////////////////
+
+bool StereoRecordingReader::isRecording(string path) {
+	char magic[sizeof(StereoRecording::FILE_MAGIC)];
+	int f = ::open(path.c_str(), O_RDONLY);
+	if(f < 0) { return false; }
+	bool is_rec = (read(f, magic, sizeof(magic)) == (ssize_t)sizeof(magic)) &&
+	              memcmp(magic, StereoRecording::FILE_MAGIC, sizeof(magic)) == 0;
+	::close(f);
+	return is_rec;
+}
+
+bool StereoRecordingReader::open(string _path, Logger * lgr) {
+	close();
+	logger = lgr;
+	path = _path;
+	fd = ::open(path.c_str(), O_RDONLY);
+	if(fd < 0) {
+		stringstream ss;
+		ss << "Couldn't open recording " << path << ".  Error #" << errno;
+		if(logger != NULL) { logger->logError(ss.str()); }
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !readAt((char *)&header, sizeof(header), 0) ||
+	   memcmp(header.magic, StereoRecording::FILE_MAGIC, sizeof(header.magic)) != 0) {
+		if(logger != NULL) { logger->logError(path + " isn't a stereo recording."); }
+		close();
+		return false;
+	}
+	if(header.version != StereoRecording::VERSION ||
+	   header.recordBytes != StereoRecording::recordBytesFor(header.width, header.height)) {
+		stringstream ss;
+		ss << path << " is a version " << header.version << " recording, which we can't read.";
+		if(logger != NULL) { logger->logError(ss.str()); }
+		close();
+		return false;
+	}
+
+	if(!readFooterIndex(st.st_size)) {
+		if(logger != NULL) { logger->logWarning(path + " was never closed; rebuilding its index."); }
+		rebuildIndex(st.st_size);
+	}
+	buildBuckets();
+	mapFile(st.st_size);
+	return true;
+}
+
+void StereoRecordingReader::close() {
+	if(mapping != NULL) {
+		munmap((void *)mapping, mappingBytes);
+	}
+	mapping = NULL;
+	mappingBytes = 0;
+	if(fd >= 0) {
+		::close(fd);
+	}
+	fd = -1;
+	index.clear();
+	buckets.clear();
+}
+
+void StereoRecordingReader::mapFile(uint64_t file_bytes) {
+	void * m = mmap(NULL, file_bytes, PROT_READ, MAP_SHARED, fd, 0);
+	if(m == MAP_FAILED) {
+		stringstream ss;
+		ss << "Couldn't map " << path << ".  Error #" << errno << ".  Reading it instead.";
+		if(logger != NULL) { logger->logWarning(ss.str()); }
+		return;
+	}
+	mapping = (const char *)m;
+	mappingBytes = file_bytes;
+	// Frames are played in order, so let the kernel read well ahead
+	madvise(m, mappingBytes, MADV_SEQUENTIAL);
+}
+
+void StereoRecordingReader::buildBuckets() {
+	buckets.clear();
+	if(index.empty()) { return; }
+	int64_t first_us = index.front().timeUs;
+	int64_t span_us  = index.back().timeUs - first_us;
+	bucketUs = max<int64_t>(1, span_us / (int64_t)index.size());
+	size_t num_buckets = (span_us > 0 ? span_us / bucketUs : 0) + 1;
+	buckets.assign(num_buckets, index.size());
+	// Walk backwards, so each bucket ends up holding its earliest frame
+	for(size_t i = index.size(); i-- > 0; ) {
+		int64_t rel_us = index[i].timeUs - first_us;
+		if(rel_us < 0) { rel_us = 0; }
+		size_t k = min<size_t>(rel_us / bucketUs, num_buckets - 1);
+		buckets[k] = i;
+	}
+	// Empty buckets start at the next bucket's first frame
+	for(size_t k = num_buckets - 1; k-- > 0; ) {
+		if(buckets[k] == index.size()) { buckets[k] = buckets[k + 1]; }
+	}
+}
+
+size_t StereoRecordingReader::findFrame(chrono::time_point<chrono::system_clock> t) const {
+	if(index.empty()) { return 0; }
+	int64_t rel_us = StereoRecording::toTimeUs(t) - index.front().timeUs;
+	if(rel_us <= 0) { return 0; }
+	size_t k = rel_us / bucketUs;
+	if(k >= buckets.size()) { return index.size() - 1; }
+	// buckets[k] is the first frame at or after the bucket's start.
+	// Step back to the last one at or before t, or forward within the bucket.
+	size_t i = buckets[k];
+	int64_t t_us = StereoRecording::toTimeUs(t);
+	while(i > 0 && (i >= index.size() || index[i].timeUs > t_us)) { --i; }
+	while(i + 1 < index.size() && index[i + 1].timeUs <= t_us) { ++i; }
+	return i;
+}
+
+bool StereoRecordingReader::readFooterIndex(uint64_t file_bytes) {
+	StereoRecording::Footer footer;
+	if(file_bytes < header.fileHeaderBytes + sizeof(footer) ||
+	   !readAt((char *)&footer, sizeof(footer), file_bytes - sizeof(footer)) ||
+	   memcmp(footer.magic, StereoRecording::FOOTER_MAGIC, sizeof(footer.magic)) != 0) {
+		return false;
+	}
+	uint64_t index_bytes = footer.numRecords * sizeof(StereoRecording::IndexEntry);
+	if(footer.indexOffset != header.fileHeaderBytes + footer.numRecords * header.recordBytes ||
+	   footer.indexOffset + index_bytes + sizeof(footer) != file_bytes) {
+		return false;
+	}
+	index.resize(footer.numRecords);
+	return readAt((char *)index.data(), index_bytes, footer.indexOffset);
+}
+
+void StereoRecordingReader::rebuildIndex(uint64_t file_bytes) {
+	index.clear();
+	// Only whole records count; the last one may have been cut short
+	if(file_bytes < header.fileHeaderBytes) { return; }
+	uint64_t num_records = (file_bytes - header.fileHeaderBytes) / header.recordBytes;
+	for(uint64_t i = 0; i < num_records; ++i) {
+		StereoRecording::RecordHeader rh;
+		if(!readAt((char *)&rh, sizeof(rh), header.fileHeaderBytes + i * header.recordBytes) ||
+		   rh.magic != StereoRecording::RECORD_MAGIC) {
+			break;
+		}
+		StereoRecording::IndexEntry entry = {rh.timeUs, rh.flags, 0};
+		index.push_back(entry);
+	}
+}
+
+chrono::time_point<chrono::system_clock> StereoRecordingReader::getFrameTime(size_t i) const {
+	return StereoRecording::fromTimeUs(index[i].timeUs);
+}
+
+bool StereoRecordingReader::readFrame(size_t i, StereoRecordingFrame &frame) {
+	if(fd < 0 || i >= index.size()) { return false; }
+	uint64_t offset = header.fileHeaderBytes + i * header.recordBytes;
+	StereoRecording::RecordHeader rh;
+	if(mapping != NULL) {
+		memcpy(&rh, mapping + offset, sizeof(rh));
+		// Ask for the frames after this one, so they're in memory by the
+		// time we get to them.  Records are whole pages, so this is aligned.
+		uint64_t ahead_offset = offset + header.recordBytes;
+		uint64_t ahead_bytes  = min<uint64_t>(readAheadFrames * header.recordBytes,
+		                                      header.fileHeaderBytes + index.size() * header.recordBytes - ahead_offset);
+		if(ahead_bytes > 0) {
+			madvise((void *)(mapping + ahead_offset), ahead_bytes, MADV_WILLNEED);
+		}
+	} else if(!readAt((char *)&rh, sizeof(rh), offset)) {
+		return false;
+	}
+	rh.autoGainValues[StereoRecording::AGC_BYTES - 1] = '\0';
+
+	frame.acquisitionTime = StereoRecording::fromTimeUs(rh.timeUs);
+	frame.frameId         = rh.frameId;
+	frame.validL          = (rh.flags & StereoRecording::FLAG_VALID_L) != 0;
+	frame.validR          = (rh.flags & StereoRecording::FLAG_VALID_R) != 0;
+	frame.autoGainValues  = rh.autoGainValues;
+
+	offset += header.recordHeaderBytes;
+	uint64_t padded = roundUpToPage(header.imageBytes);
+	cv::Mat * imgs[2] = {&frame.imgL, &frame.imgR};
+	bool * valid[2] = {&frame.validL, &frame.validR};
+	for(int s = 0; s < 2; ++s) {
+		imgs[s]->release();
+		if(!*valid[s]) { continue; }
+		if(mapping != NULL) {
+			// No copy, no decode
+			*imgs[s] = cv::Mat(header.height, header.width, CV_8UC1, (void *)(mapping + offset + s * padded));
+			continue;
+		}
+		imgs[s]->create(header.height, header.width, CV_8UC1);
+		if(!readAt((char *)imgs[s]->data, header.imageBytes, offset + s * padded)) {
+			*valid[s] = false;
+			imgs[s]->release();
+		}
+	}
+	return true;
+}
+
+bool StereoRecordingReader::readAt(char * buf, size_t bytes, uint64_t offset) {
+	while(bytes > 0) {
+		ssize_t n = pread(fd, buf, bytes, offset);
+		if(n < 0 && errno == EINTR) { continue; }
+		if(n <= 0) {
+			if(logger != NULL) {
+				stringstream ss;
+				ss << "Couldn't read " << path << " at byte " << offset << ".  Error #" << (n < 0 ? errno : 0);
+				logger->logWarning(ss.str());
+			}
+			return false;
+		}
+		buf    += n;
+		bytes  -= n;
+		offset += n;
+	}
+	return true;
+}
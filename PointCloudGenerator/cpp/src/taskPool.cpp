@@ -0,0 +1,176 @@
+/*
+	taskPool.cpp
+
+	Work-stealing pool of worker threads.
+*/
+
+#include <taskPool.h>
+using namespace std;
+using namespace std::chrono;
+
+// Which pool, and which worker in it, this thread is.  Lets tasks that
+// submit more tasks push onto their own deque.
+static thread_local const TaskPool * currentPool = NULL;
+static thread_local int currentWorker = -1;
+
+void TaskPool::init(unsigned int num_threads) {
+	stop();
+	stopping = false;
+	for(unsigned int i = 0; i < num_threads; ++i) {
+		workers.push_back(unique_ptr<Worker>(new Worker()));
+	}
+	// Only start them once the vector won't change anymore
+	for(unsigned int i = 0; i < num_threads; ++i) {
+		workers[i]->th = thread(&TaskPool::workerLoop, this, i);
+	}
+}
+
+void TaskPool::stop() {
+	{
+		lock_guard<mutex> lk(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(auto &w : workers) {
+		if(w->th.joinable()) { w->th.join(); }
+	}
+	workers.clear();
+}
+
+int TaskPool::getSelfIndex() {
+	return (currentPool == this) ? currentWorker : -1;
+}
+
+void TaskPool::submit(TaskGroup &group, Task task) {
+	group.pending++;
+	Job job = {task, &group, FrameTracer::getCurrentFrame()};
+	if(workers.empty()) {
+		runJob(job);
+		return;
+	}
+	int self = getSelfIndex();
+	Worker &w = (self >= 0) ? *workers[self] : *workers[nextWorker++ % workers.size()];
+	{
+		lock_guard<mutex> lk(w.lock);
+		w.jobs.push_back(std::move(job));
+	}
+	queuedJobs++;
+	{
+		// Taking the lock closes the gap between a worker checking for
+		// jobs and going to sleep
+		lock_guard<mutex> lk(sleepLock);
+	}
+	wake.notify_one();
+}
+
+void TaskPool::runJob(Job &job) {
+	unsigned long prev_frame = FrameTracer::getCurrentFrame();
+	FrameTracer::setCurrentFrame(job.frameId);
+	try {
+		job.task();
+	} catch (...) {
+		lock_guard<mutex> lk(job.group->errorLock);
+		if(!job.group->error) { job.group->error = current_exception(); }
+	}
+	FrameTracer::setCurrentFrame(prev_frame);
+	// Under the lock, so a waiter can't see zero and destroy the group
+	// before we've signalled it
+	lock_guard<mutex> lk(job.group->doneLock);
+	if(--job.group->pending == 0) { job.group->done.notify_all(); }
+}
+
+bool TaskPool::runOne(int self) {
+	Job job;
+	bool have_job = false;
+	int n = workers.size();
+	if(self >= 0) {
+		// Newest first from our own deque; it's most likely still in cache
+		Worker &w = *workers[self];
+		lock_guard<mutex> lk(w.lock);
+		if(!w.jobs.empty()) {
+			job = std::move(w.jobs.back());
+			w.jobs.pop_back();
+			have_job = true;
+		}
+	}
+	for(int i = 1; i <= n && !have_job; ++i) {
+		// Oldest first from everyone else's
+		Worker &victim = *workers[(self + i + n) % n];
+		lock_guard<mutex> lk(victim.lock);
+		if(!victim.jobs.empty()) {
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			have_job = true;
+		}
+	}
+	if(!have_job) { return false; }
+
+	queuedJobs--;
+	runJob(job);
+	return true;
+}
+
+void TaskPool::workerLoop(int self) {
+	currentPool = this;
+	currentWorker = self;
+	Worker &me = *workers[self];
+	while(true) {
+		steady_clock::time_point start = steady_clock::now();
+		if(runOne(self)) {
+			me.busyNs += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+			me.tasksRun++;
+			continue;
+		}
+		{
+			unique_lock<mutex> lk(sleepLock);
+			wake.wait(lk, [this]{ return stopping || queuedJobs > 0; });
+			if(stopping) { break; }
+		}
+		me.idleNs += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+	}
+}
+
+void TaskPool::wait(TaskGroup &group) {
+	int self = getSelfIndex();
+	while(group.pending > 0) {
+		// Help out while there's anything queued
+		if(runOne(self)) { continue; }
+		// The rest are running elsewhere; sleep until the last one's done
+		unique_lock<mutex> lk(group.doneLock);
+		group.done.wait(lk, [&group]{ return group.pending == 0; });
+	}
+	{
+		// The last task may still be signalling
+		lock_guard<mutex> lk(group.doneLock);
+	}
+	lock_guard<mutex> lk(group.errorLock);
+	if(group.error) {
+		exception_ptr error = group.error;
+		group.error = exception_ptr();
+		rethrow_exception(error);
+	}
+}
+
+void TaskPool::parallelFor(int begin, int end, function<void(int)> fn) {
+	TaskGroup group;
+	for(int i = begin; i < end; ++i) {
+		submit(group, [&fn, i]{ fn(i); });
+	}
+	wait(group);
+}
+
+void TaskPool::publishStats() {
+	lock_guard<mutex> lk(statsLock);
+	long long busy_ns = 0, idle_ns = 0;
+	int tasks_run = 0;
+	for(auto const &w : workers) {
+		busy_ns   += w->busyNs;
+		idle_ns   += w->idleNs;
+		tasks_run += w->tasksRun;
+	}
+	bmBusy.add(nanoseconds(busy_ns - publishedBusyNs), tasks_run - publishedTasksRun);
+	bmIdle.add(nanoseconds(idle_ns - publishedIdleNs));
+	publishedBusyNs   = busy_ns;
+	publishedIdleNs   = idle_ns;
+	publishedTasksRun = tasks_run;
+}
@@ -17,6 +17,7 @@ typedef enum MsgIdTag {
 	EN_POINT_CLOUD_GEN   = 0x0200,
 	DIS_POINT_CLOUD_GEN  = 0x0201,
 	SHUTDOWN_PCG         = 0x0202,
+	SELECT_STEREO_ALG    = 0x0203,
 } MsgId;
 
 // NOTE: if you add virtual functions to this class, a hidden member void *__vptr will be added
@@ -179,6 +180,25 @@ public:
 	{;}
 };
 
+// Switches stereo processing to one of the algorithm profiles listed in the
+// PCG configuration file.  Profile 0 is the configured default algorithm.
+// Every profile is loaded at startup, so the switch takes effect on the next frame.
+class SelectStereoAlgorithmMsg : public Msg {
+private:
+	uint16_t profileIdx;
+	uint16_t reserved0;
+	
+public:
+	SelectStereoAlgorithmMsg(uint16_t profile = 0) :
+		Msg(MsgId::SELECT_STEREO_ALG, sizeof(SelectStereoAlgorithmMsg)),
+		profileIdx(profile),
+		reserved0(0)
+	{;}
+	
+	uint16_t getProfileIdx() const { return profileIdx; }
+	void     setProfileIdx(uint16_t value) { profileIdx = value; }
+};
+
 #pragma pack(pop)
 #endif // __MESSAGE_FORMATS_H__
 